@@ -34,6 +34,8 @@ public:
     {
         SerialConfig serial_config; // serial port to perform the update on
         bool force_full = false;    // if true update all modules and blocks regardless of crc checks
+        long baud_rate = 115200;    // serial baud rate of the modules download (sent to the device with dlspd). 115200 is used
+                                    // if the host serial port can't switch to it
     };
 
     /**
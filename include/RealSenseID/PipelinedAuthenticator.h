@@ -0,0 +1,122 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/RealSenseIDExports.h"
+#include "RealSenseID/AuthenticateStatus.h"
+#include "RealSenseID/FaceAuthenticator.h"
+#include "RealSenseID/Faceprints.h"
+#include "RealSenseID/MatcherDefines.h"
+#include "RealSenseID/Status.h"
+#include <cstddef>
+
+namespace RealSenseID
+{
+// Forward declaration of the implementation class
+namespace Impl
+{
+class PipelinedAuthenticatorImpl;
+}
+
+/**
+ * Match decision of one faceprints extraction of a PipelinedAuthenticator.
+ */
+struct MatchDecision
+{
+    // Success or Forbidden for a matched probe, else the failed extraction status (no match was made).
+    AuthenticateStatus status = AuthenticateStatus::Failure;
+    ExtendedMatchResult result;
+    // id of the best matched user (empty if none).
+    char user_id[RSID_MAX_USER_ID_LENGTH_IN_DB + 1] = {};
+    // the adaptive update applied to the users, valid if result.should_update (e.g. to persist it).
+    Faceprints updated_faceprints;
+};
+
+/**
+ * User defined callback for the match decisions of a PipelinedAuthenticator.
+ */
+class MatchDecisionCallback
+{
+public:
+    virtual ~MatchDecisionCallback() = default;
+
+    /**
+     * Called on the match thread, once per extraction and in extraction order.
+     *
+     * @param[in] decision Match decision of the extraction.
+     */
+    virtual void OnDecision(const MatchDecision& decision) = 0;
+};
+
+/**
+ * Host mode authentication loop that overlaps the device faceprints extraction with the host 1:N match.
+ *
+ * FaceAuthenticator::ExtractFaceprintsForAuthLoop() extracts, matches in the result callback and then sleeps, so the
+ * device is idle while the host matches and the other way around. Here each extracted probe is queued and the next
+ * extraction starts right away, while a match thread matches the queued probes against the users (see AddUsers())
+ * and delivers the decisions, in order, through MatchDecisionCallback. Matched users get the adaptive update.
+ *
+ * If the match thread falls behind and the queue is full, new probes are dropped (see Dropped()).
+ */
+class RSID_API PipelinedAuthenticator
+{
+public:
+    /**
+     * @param[in] callback Receives the match decisions.
+     * @param[in] confidence_level Matcher confidence level.
+     * @param[in] queue_capacity Max extracted probes waiting to be matched.
+     * @param[in] match_threads Threads of each 1:N match.
+     * @param[in] no_face_interval_ms Wait after an extraction that found no face, like ExtractFaceprintsForAuthLoop().
+     */
+    explicit PipelinedAuthenticator(MatchDecisionCallback& callback,
+                                    ThresholdsConfidenceEnum confidence_level = ThresholdsConfidenceEnum::ThresholdsConfidenceLevel_High,
+                                    size_t queue_capacity = 4, unsigned int match_threads = 1, unsigned int no_face_interval_ms = 2100);
+    ~PipelinedAuthenticator();
+
+    PipelinedAuthenticator(const PipelinedAuthenticator&) = delete;
+    PipelinedAuthenticator& operator=(const PipelinedAuthenticator&) = delete;
+
+    /**
+     * Add users to match against. Can be called while RunLoop() runs.
+     *
+     * @param[in] user_features Array of user IDs and faceprints.
+     * @param[in] num_of_users Number of users in the array.
+     * @return Number of users added (users with invalid faceprints are skipped).
+     */
+    size_t AddUsers(const UserFaceprints* user_features, size_t num_of_users);
+
+    /**
+     * Remove all the users. Can be called while RunLoop() runs.
+     */
+    void RemoveAllUsers();
+
+    /**
+     * @return Number of users to match against.
+     */
+    size_t QueryNumberOfUsers() const;
+
+    /**
+     * Extract faceprints back to back with authenticator.ExtractFaceprintsForAuth() until Stop() or the first error,
+     * then wait for the queued probes to be matched.
+     *
+     * @param[in] authenticator Authenticator connected to the device.
+     * @return Status of the last extraction.
+     */
+    Status RunLoop(FaceAuthenticator& authenticator);
+
+    /**
+     * Stop RunLoop() after the current extraction (also call FaceAuthenticator::Cancel() to stop sooner).
+     * Thread safe.
+     */
+    void Stop();
+
+    /**
+     * @return Number of extracted probes dropped because the queue was full.
+     */
+    size_t Dropped() const;
+
+private:
+    Impl::PipelinedAuthenticatorImpl* _impl = nullptr;
+};
+} // namespace RealSenseID
@@ -0,0 +1,129 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "RealSenseID/FaceAuthenticator.h"
+#include "RealSenseID/PipelinedAuthenticator.h"
+#include <iostream>
+#include <memory>
+#include <string.h>
+
+// Create FaceAuthenticator (after successfully connecting it to the device).
+// If failed to connect, exit(1)
+std::unique_ptr<RealSenseID::FaceAuthenticator> CreateAuthenticator(const RealSenseID::SerialConfig& serial_config)
+{
+    auto authenticator = std::make_unique<RealSenseID::FaceAuthenticator>();
+    auto connect_status = authenticator->Connect(serial_config);
+    if (connect_status != RealSenseID::Status::Ok)
+    {
+        std::cout << "Failed connecting to port " << serial_config.port << " status:" << connect_status << std::endl;
+        std::exit(1);
+    }
+    std::cout << "Connected to device" << std::endl;
+    return authenticator;
+}
+
+// extract faceprints for new enrolled user
+class EnrollClbk : public RealSenseID::EnrollFaceprintsExtractionCallback
+{
+    RealSenseID::UserFaceprints& _user;
+
+public:
+    EnrollClbk(RealSenseID::UserFaceprints& user) : _user(user)
+    {
+    }
+
+    void OnResult(const RealSenseID::EnrollStatus status, const RealSenseID::ExtractedFaceprints* faceprints) override
+    {
+        std::cout << "on_result: status: " << status << std::endl;
+        if (status != RealSenseID::EnrollStatus::Success)
+        {
+            return;
+        }
+
+        auto& data = _user.faceprints.data;
+        data.version = faceprints->data.version;
+        data.flags = faceprints->data.flags;
+        data.featuresType = faceprints->data.featuresType;
+        ::memcpy(data.adaptiveDescriptorWithoutMask, faceprints->data.featuresVector, sizeof(faceprints->data.featuresVector));
+        ::memcpy(data.enrollmentDescriptor, faceprints->data.featuresVector, sizeof(faceprints->data.featuresVector));
+        // the withMask vector is not set yet.
+        data.adaptiveDescriptorWithMask[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS] = RealSenseID::FaVectorFlagsEnum::VecFlagNotSet;
+    }
+
+    void OnProgress(const RealSenseID::FacePose pose) override
+    {
+        std::cout << "on_progress: pose: " << pose << std::endl;
+    }
+
+    void OnHint(const RealSenseID::EnrollStatus hint) override
+    {
+        std::cout << "on_hint: hint: " << hint << std::endl;
+    }
+};
+
+// called on the match thread, in extraction order. stops the loop after a few decisions.
+class DecisionClbk : public RealSenseID::MatchDecisionCallback
+{
+    RealSenseID::PipelinedAuthenticator* _pipeline = nullptr;
+    RealSenseID::FaceAuthenticator* _authenticator = nullptr;
+    int _decisions_left;
+
+public:
+    explicit DecisionClbk(int max_decisions) : _decisions_left(max_decisions)
+    {
+    }
+
+    void Attach(RealSenseID::PipelinedAuthenticator* pipeline, RealSenseID::FaceAuthenticator* authenticator)
+    {
+        _pipeline = pipeline;
+        _authenticator = authenticator;
+    }
+
+    void OnDecision(const RealSenseID::MatchDecision& decision) override
+    {
+        if (decision.status == RealSenseID::AuthenticateStatus::Success)
+        {
+            std::cout << "******* Match success. user_id: " << decision.user_id << " score: " << decision.result.maxScore
+                      << (decision.result.should_update ? " (adaptive update applied)" : "") << " *******" << std::endl;
+        }
+        else
+        {
+            std::cout << "******* " << decision.status << " *******" << std::endl;
+        }
+
+        if (--_decisions_left == 0)
+        {
+            _pipeline->Stop();
+            _authenticator->Cancel();
+        }
+    }
+};
+
+int main()
+{
+#ifdef _WIN32
+    RealSenseID::SerialConfig config {"COM9"};
+#elif LINUX
+    RealSenseID::SerialConfig config {"/dev/ttyACM0"};
+#endif
+    auto authenticator = CreateAuthenticator(config);
+
+    RealSenseID::UserFaceprints user = {};
+    ::strncpy(user.user_id, "my-username", sizeof(user.user_id) - 1);
+    EnrollClbk enroll_clbk {user};
+    auto status = authenticator->ExtractFaceprintsForEnroll(enroll_clbk);
+    if (status != RealSenseID::Status::Ok)
+    {
+        std::cout << "Status: " << status << std::endl;
+        return 1;
+    }
+
+    // the next extraction starts while the previous faceprints are matched.
+    DecisionClbk decision_clbk {10};
+    RealSenseID::PipelinedAuthenticator pipeline {decision_clbk};
+    decision_clbk.Attach(&pipeline, authenticator.get());
+    pipeline.AddUsers(&user, 1);
+
+    status = pipeline.RunLoop(*authenticator);
+    std::cout << "Status: " << status << ", dropped: " << pipeline.Dropped() << std::endl;
+}
@@ -0,0 +1,109 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "CpuFeatures.h"
+
+#if RSID_ARCH_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif RSID_ARCH_ARM64
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/auxv.h>
+#endif
+#endif
+
+#include <cstdint>
+
+namespace RealSenseID
+{
+#if RSID_ARCH_X86
+static void Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; i++)
+        regs[i] = static_cast<uint32_t>(info[i]);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t Xgetbv()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+static CpuFeatures DetectCpuFeatures()
+{
+    CpuFeatures features;
+    uint32_t regs[4] = {};
+
+    Cpuid(0, 0, regs);
+    const uint32_t max_leaf = regs[0];
+    if (max_leaf < 1)
+        return features;
+
+    Cpuid(1, 0, regs);
+    const uint32_t ecx1 = regs[2];
+    features.sse41 = (ecx1 & (1u << 19)) != 0;
+    features.pclmul = (ecx1 & (1u << 1)) != 0;
+
+    // ymm/zmm usage requires the os to save the extended state (osxsave + xcr0 bits).
+    const bool osxsave = (ecx1 & (1u << 27)) != 0;
+    const bool avx = (ecx1 & (1u << 28)) != 0;
+    if (!osxsave || !avx || max_leaf < 7)
+        return features;
+
+    const uint64_t xcr0 = Xgetbv();
+    const bool os_ymm = (xcr0 & 0x6) == 0x6;
+    const bool os_zmm = (xcr0 & 0xE6) == 0xE6;
+
+    Cpuid(7, 0, regs);
+    const uint32_t ebx7 = regs[1];
+    const uint32_t ecx7 = regs[2];
+    features.avx2 = os_ymm && (ebx7 & (1u << 5)) != 0;
+    const bool avx512f = (ebx7 & (1u << 16)) != 0;
+    const bool avx512bw = (ebx7 & (1u << 30)) != 0;
+    features.avx512bw = os_zmm && avx512f && avx512bw;
+    features.avx512vnni = features.avx512bw && (ecx7 & (1u << 11)) != 0;
+    return features;
+}
+#elif RSID_ARCH_ARM64
+static CpuFeatures DetectCpuFeatures()
+{
+    CpuFeatures features;
+#if defined(__APPLE__)
+    features.armcrc32 = true; // all apple arm64 cpus have it
+#elif defined(_WIN32)
+    features.armcrc32 = IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE) != 0;
+#elif defined(__linux__)
+    constexpr unsigned long hwcap_crc32 = 1ul << 7; // HWCAP_CRC32 of asm/hwcap.h
+    features.armcrc32 = (getauxval(AT_HWCAP) & hwcap_crc32) != 0;
+#endif
+    return features;
+}
+#else
+static CpuFeatures DetectCpuFeatures()
+{
+    return CpuFeatures {};
+}
+#endif // RSID_ARCH_X86
+
+const CpuFeatures& GetCpuFeatures()
+{
+    static const CpuFeatures features = DetectCpuFeatures();
+    return features;
+}
+} // namespace RealSenseID
@@ -0,0 +1,35 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+// Runtime cpu features detection.
+// Used to pick the best available implementation of hot kernels (matcher, crc) once per process.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RSID_ARCH_X86 1
+#else
+#define RSID_ARCH_X86 0
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define RSID_ARCH_ARM64 1
+#else
+#define RSID_ARCH_ARM64 0
+#endif
+
+namespace RealSenseID
+{
+struct CpuFeatures
+{
+    bool sse41 = false;
+    bool pclmul = false;
+    bool avx2 = false;
+    bool avx512bw = false;   // avx512f + avx512bw, and the os saves the zmm state
+    bool avx512vnni = false; // avx512bw + avx512_vnni
+    bool armcrc32 = false;   // armv8 crc32 instructions
+};
+
+// Detected once on first call. All false on platforms other than x86 and arm64.
+const CpuFeatures& GetCpuFeatures();
+} // namespace RealSenseID
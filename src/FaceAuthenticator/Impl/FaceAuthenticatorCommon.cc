@@ -42,6 +42,14 @@ namespace Impl
 static constexpr unsigned int MAX_FACES = 10;
 static constexpr unsigned int QUERY_CHUNK_SIZE = 50;
 static constexpr unsigned int MAX_UPLOAD_IMG_SIZE = 900 * 1024;
+// packets in flight of bulk transfers (see Session::SendPacketsWindowed()). 1 unless the build sets a higher
+// RSID_SEND_WINDOW for firmware that queues the host packets.
+#ifdef RSID_SEND_WINDOW
+static constexpr size_t SEND_WINDOW = RSID_SEND_WINDOW;
+#else
+static constexpr size_t SEND_WINDOW = 1;
+#endif
+static_assert(SEND_WINDOW >= 1 && SEND_WINDOW <= PacketManager::MaxSendWindow, "RSID_SEND_WINDOW must be in 1..20");
 static constexpr std::chrono::milliseconds ENROLL_MAX_TIMEOUT {12000};
 static constexpr std::chrono::milliseconds AUTH_MAX_TIMEOUT {10000};
 
@@ -1649,44 +1657,60 @@ bool FaceAuthenticatorCommon::ValidateUserId(const char* user_id)
     return is_valid;
 }
 
-Status FaceAuthenticatorCommon::SendUserFaceprints(UserFaceprints& features)
+// send the users with up to SEND_WINDOW SetUserFeatures packets in flight. on the first user that fails (an invalid
+// user id, or an error reply), no more users are sent - the users before it are still sent, as one at a time did.
+Status FaceAuthenticatorCommon::SendUsersFaceprints(UserFaceprints* user_features, unsigned int num_of_users)
 {
     try
     {
-        const char* user_id = features.user_id;
-        if (!ValidateUserId(user_id))
+        unsigned int num_valid_users = 0;
+        while (num_valid_users < num_of_users && ValidateUserId(user_features[num_valid_users].user_id))
         {
-            return Status::Error;
-        }
-        char buffer[sizeof(DBFaceprintsElement) + PacketManager::MaxUserIdSize + 1] = {0};
-        strncpy(buffer, user_id, PacketManager::MaxUserIdSize + 1);
-        size_t offset = PacketManager::MaxUserIdSize + 1;
-        const DBFaceprintsElement* desc = &(features.faceprints.data);
-        memcpy(buffer + offset, (char*)desc, sizeof(DBFaceprintsElement));
-        offset += sizeof(*desc);
-        PacketManager::DataPacket data_packet {PacketManager::MsgId::SetUserFeatures, buffer, offset};
-
-        auto status = _session.SendPacket(data_packet);
-        if (status != PacketManager::SerialStatus::Ok)
-        {
-            LOG_ERROR(LOG_TAG, "Failed sending data packet (status %d)", static_cast<int>(status));
-            return ToStatus(status);
+            num_valid_users++;
         }
 
-        status = _session.RecvPacket(data_packet);
+        auto make_packet = [user_features](size_t index) {
+            char buffer[sizeof(DBFaceprintsElement) + PacketManager::MaxUserIdSize + 1] = {0};
+            strncpy(buffer, user_features[index].user_id, PacketManager::MaxUserIdSize + 1);
+            size_t offset = PacketManager::MaxUserIdSize + 1;
+            const DBFaceprintsElement* desc = &(user_features[index].faceprints.data);
+            memcpy(buffer + offset, (char*)desc, sizeof(DBFaceprintsElement));
+            offset += sizeof(*desc);
+            return PacketManager::DataPacket {PacketManager::MsgId::SetUserFeatures, buffer, offset};
+        };
+
+        Status send_status = Status::Ok;
+        auto on_reply = [user_features, &send_status](size_t index, const PacketManager::SerialPacket& reply) {
+            if (reply.header.id != PacketManager::MsgId::Reply)
+            {
+                LOG_ERROR(LOG_TAG, "Got unexpected message id %d instead of MsgId::Reply", static_cast<int>(reply.header.id));
+                send_status = Status::Error;
+            }
+            else
+            {
+                auto statusCode = static_cast<char>(reply.payload.message.fa_msg.fa_status - '0');
+                send_status = static_cast<Status>(statusCode);
+            }
+
+            if (send_status != Status::Ok)
+            {
+                LOG_ERROR(LOG_TAG, "SendUserFaceprints for user \"%s\": %s)", user_features[index].user_id, Description(send_status));
+                return false;
+            }
+            return true;
+        };
+
+        auto status = _session.SendPacketsWindowed(num_valid_users, SEND_WINDOW, make_packet, on_reply);
         if (status != PacketManager::SerialStatus::Ok)
         {
-            LOG_ERROR(LOG_TAG, "Failed receiving packet (status %d)", static_cast<int>(status));
+            LOG_ERROR(LOG_TAG, "Failed sending users faceprints (status %d)", static_cast<int>(status));
             return ToStatus(status);
         }
-        if (data_packet.header.id != PacketManager::MsgId::Reply)
+        if (send_status == Status::Ok && num_valid_users < num_of_users)
         {
-            // LOG_ERROR(LOG_TAG, "Error updating/adding user to DB: %d", static_cast<int>(status));
-            LOG_ERROR(LOG_TAG, "Got unexpected message id %d instead of MsgId::Reply", static_cast<int>(data_packet.header.id));
             return Status::Error;
         }
-        auto statusCode = static_cast<char>(data_packet.payload.message.fa_msg.fa_status - '0');
-        return static_cast<Status>(statusCode);
+        return send_status;
     }
     catch (std::exception& ex)
     {
@@ -1720,16 +1744,7 @@ Status FaceAuthenticatorCommon::SetUsersFaceprints(UserFaceprints* user_features
             return ToStatus(status);
         }
 
-        RealSenseID::Status send_status = Status::Ok;
-        for (unsigned int index = start_index; index < end_index; index++)
-        {
-            send_status = SendUserFaceprints(user_features[index]);
-            if (send_status != Status::Ok)
-            {
-                LOG_ERROR(LOG_TAG, "SendUserFaceprints for user \"%s\": %s)", user_features[index].user_id, Description(send_status));
-                break;
-            }
-        }
+        RealSenseID::Status send_status = SendUsersFaceprints(&user_features[start_index], end_index - start_index);
 
         // ask the device to save to its storage before proceeding
         auto save_db_packet = std::make_unique<PacketManager::FaPacket>(PacketManager::MsgId::SaveDatabase);
@@ -99,7 +99,7 @@ protected:
     // wait for cancel flag while sleeping upto timeout
     void AuthLoopSleep(std::chrono::milliseconds timeout) const;
     static bool ValidateUserId(const char* user_id);
-    Status SendUserFaceprints(UserFaceprints& features);
+    Status SendUsersFaceprints(UserFaceprints* user_features, unsigned int num_of_users);
 };
 } // namespace Impl
 } // namespace RealSenseID
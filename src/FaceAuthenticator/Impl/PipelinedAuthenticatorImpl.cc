@@ -0,0 +1,155 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "PipelinedAuthenticatorImpl.h"
+#include "Logger.h"
+
+namespace RealSenseID
+{
+namespace Impl
+{
+static const char* LOG_TAG = "PipelinedAuthenticator";
+
+PipelinedAuthenticatorImpl::PipelinedAuthenticatorImpl(const Thresholds& thresholds, MatchDecisionCallback& callback, size_t queue_capacity,
+                                                       unsigned int match_threads, std::chrono::milliseconds no_face_interval) :
+    _thresholds(thresholds), _callback(callback), _matchThreads(match_threads), _noFaceInterval(no_face_interval),
+    _ring(queue_capacity)
+{
+    _matchThread = std::thread(&PipelinedAuthenticatorImpl::MatchLoop, this);
+}
+
+PipelinedAuthenticatorImpl::~PipelinedAuthenticatorImpl()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _exit = true;
+    }
+    _cv.notify_all();
+    _matchThread.join();
+}
+
+Status PipelinedAuthenticatorImpl::RunLoop(FaceAuthenticator& authenticator)
+{
+    Status status = Status::Ok;
+    _stopLoop = false;
+
+    while (!_stopLoop && status == Status::Ok)
+    {
+        _faceFound = false;
+        status = authenticator.ExtractFaceprintsForAuth(*this);
+
+        if (status == Status::Ok && !_faceFound)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait_for(lock, _noFaceInterval, [this] { return _stopLoop.load(); });
+        }
+    }
+
+    Drain();
+    return status;
+}
+
+void PipelinedAuthenticatorImpl::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopLoop = true;
+    }
+    _cv.notify_all();
+}
+
+void PipelinedAuthenticatorImpl::OnResult(const AuthenticateStatus status, const ExtractedFaceprints* faceprints)
+{
+    // same as the extraction loop (see FaceprintsLoopCallback).
+    if (status == AuthenticateStatus::NoFaceDetected || status == AuthenticateStatus::DeviceError ||
+        status == AuthenticateStatus::SerialError || status == AuthenticateStatus::Failure)
+    {
+        _faceFound = false;
+    }
+
+    QueuedProbe queued;
+    queued.status = (status == AuthenticateStatus::Success && faceprints == nullptr) ? AuthenticateStatus::Failure : status;
+    if (queued.status == AuthenticateStatus::Success)
+    {
+        queued.probe.data = faceprints->data;
+    }
+
+    if (!_ring.TryPush(queued))
+    {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        LOG_DEBUG(LOG_TAG, "Match queue is full, dropping the extracted faceprints");
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pushed++;
+    }
+    _cv.notify_all();
+}
+
+void PipelinedAuthenticatorImpl::OnHint(const AuthenticateStatus hint)
+{
+    LOG_DEBUG(LOG_TAG, "Extraction hint %d", static_cast<int>(hint));
+}
+
+void PipelinedAuthenticatorImpl::OnFaceDetected(const std::vector<FaceRect>& faces, const unsigned int)
+{
+    _faceFound = !faces.empty();
+}
+
+// the ring is checked under the mutex, and the producer takes the mutex after each push, so a push can't be missed
+// between the check and the wait.
+void PipelinedAuthenticatorImpl::MatchLoop()
+{
+    QueuedProbe queued;
+    MatchDecision decision;
+
+    for (;;)
+    {
+        if (_ring.TryPop(queued))
+        {
+            Match(queued, decision);
+            _callback.OnDecision(decision);
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _matched++;
+            }
+            _cv.notify_all();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_exit && _ring.Empty())
+        {
+            return;
+        }
+        _cv.wait(lock, [this] { return _exit || !_ring.Empty(); });
+    }
+}
+
+static_assert(sizeof(MatchDecision::user_id) == FaceprintsGallery::UserIdStride, "the match copies a gallery user id");
+
+void PipelinedAuthenticatorImpl::Match(const QueuedProbe& queued, MatchDecision& decision)
+{
+    decision = MatchDecision();
+    decision.status = queued.status;
+    if (queued.status != AuthenticateStatus::Success)
+    {
+        return;
+    }
+
+    // the user id is copied by the match from the gallery it scanned, so it's the matched user's even if the users
+    // were replaced meanwhile.
+    decision.result = _gallery.Match(queued.probe, decision.updated_faceprints, decision.user_id, _thresholds, _cache, _matchThreads);
+    decision.status = decision.result.isSame ? AuthenticateStatus::Success : AuthenticateStatus::Forbidden;
+}
+
+void PipelinedAuthenticatorImpl::Drain()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this] { return _matched == _pushed; });
+}
+} // namespace Impl
+} // namespace RealSenseID
@@ -0,0 +1,110 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/AuthFaceprintsExtractionCallback.h"
+#include "RealSenseID/FaceAuthenticator.h"
+#include "RealSenseID/MatcherDefines.h"
+#include "RealSenseID/PipelinedAuthenticator.h"
+#include "Matcher/ConcurrentFaceprintsGallery.h"
+#include "SpscRing.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace RealSenseID
+{
+namespace Impl
+{
+// Implementation of PipelinedAuthenticator.
+//
+// OnResult() only queues the extracted probe to a bounded single producer / single consumer ring and returns, so the
+// next extraction starts right away. A match thread pops the probes and matches them against the users gallery
+// (ConcurrentFaceprintsGallery::Match(), its scan sharded over match_threads threads), and delivers the decisions
+// through MatchDecisionCallback, in order. The probes of a loop are usually of the same person, so the match thread
+// keeps a MatchResultCache: a probe that the last accepted user accepts by a margin skips the 1:N scan.
+//
+// Like ExtractFaceprintsForAuthLoop(), the loop still waits no_face_interval after an extraction that found no face.
+//
+// If the match thread falls behind and the ring is full, the new probe is dropped (see Dropped()): the probes
+// already queued are older, but dropping from the producer side keeps the ring lock free.
+class PipelinedAuthenticatorImpl : public AuthFaceprintsExtractionCallback
+{
+public:
+    PipelinedAuthenticatorImpl(const Thresholds& thresholds, MatchDecisionCallback& callback, size_t queue_capacity,
+                               unsigned int match_threads, std::chrono::milliseconds no_face_interval);
+    ~PipelinedAuthenticatorImpl() override;
+
+    PipelinedAuthenticatorImpl(const PipelinedAuthenticatorImpl&) = delete;
+    PipelinedAuthenticatorImpl& operator=(const PipelinedAuthenticatorImpl&) = delete;
+
+    // the users matched against. thread safe.
+    ConcurrentFaceprintsGallery& Gallery()
+    {
+        return _gallery;
+    }
+
+    const ConcurrentFaceprintsGallery& Gallery() const
+    {
+        return _gallery;
+    }
+
+    // extract back to back with authenticator.ExtractFaceprintsForAuth(*this) until Stop() or the first error, then
+    // wait for the queued probes to be matched. returns the status of the last extraction.
+    Status RunLoop(FaceAuthenticator& authenticator);
+
+    // stop RunLoop() after the current extraction (also cancel it with FaceAuthenticator::Cancel() to stop sooner).
+    // thread safe.
+    void Stop();
+
+    // number of probes dropped because the ring was full.
+    size_t Dropped() const
+    {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+    // AuthFaceprintsExtractionCallback - called by the extraction thread (the producer).
+    void OnResult(const AuthenticateStatus status, const ExtractedFaceprints* faceprints) override;
+    void OnHint(const AuthenticateStatus hint) override;
+    void OnFaceDetected(const std::vector<FaceRect>& faces, const unsigned int ts) override;
+
+private:
+    struct QueuedProbe
+    {
+        AuthenticateStatus status;
+        MatchElement probe;
+    };
+
+    void MatchLoop();
+    void Match(const QueuedProbe& queued, MatchDecision& decision);
+
+    // wait until all the queued probes were matched.
+    void Drain();
+
+    ConcurrentFaceprintsGallery _gallery;
+    const Thresholds _thresholds;
+    MatchDecisionCallback& _callback;
+    const unsigned int _matchThreads;
+    const std::chrono::milliseconds _noFaceInterval;
+
+    MatchResultCache _cache; // match thread only
+
+    SpscRing<QueuedProbe> _ring;
+    std::atomic<size_t> _dropped {0};
+    std::atomic<bool> _stopLoop {false};
+    bool _faceFound = false; // extraction thread only
+
+    // wakes the match thread up when the ring was empty, and the producer up when it's drained.
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    size_t _pushed = 0;
+    size_t _matched = 0;
+    bool _exit = false;
+
+    std::thread _matchThread;
+};
+} // namespace Impl
+} // namespace RealSenseID
@@ -0,0 +1,74 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+
+namespace RealSenseID
+{
+// Bounded lock free single producer / single consumer ring.
+// TryPush() must only be called by one thread and TryPop() by one (other) thread. Each side only writes its own index,
+// and publishes it with release, so an element is fully written before the consumer sees it and fully read before the
+// producer reuses its slot.
+template <typename T>
+class SpscRing
+{
+public:
+    // holds up to capacity elements (at least one).
+    explicit SpscRing(size_t capacity) : _slots((capacity > 0 ? capacity : 1) + 1), _head(0), _tail(0)
+    {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // returns false (and doesn't push) if the ring is full.
+    bool TryPush(const T& value)
+    {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        const size_t next = Next(tail);
+        if (next == _head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        _slots[tail] = value;
+        _tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // returns false if the ring is empty.
+    bool TryPop(T& value)
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        value = _slots[head];
+        _head.store(Next(head), std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    size_t Next(size_t index) const
+    {
+        return (index + 1 == _slots.size()) ? 0 : index + 1;
+    }
+
+    // one slot is kept free to tell a full ring from an empty one.
+    std::vector<T> _slots;
+    // on separate cache lines, so each side only writes its own line.
+    alignas(64) std::atomic<size_t> _head; // next slot to pop (consumer)
+    alignas(64) std::atomic<size_t> _tail; // next slot to push (producer)
+};
+} // namespace RealSenseID
@@ -0,0 +1,65 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "RealSenseID/PipelinedAuthenticator.h"
+#include "Impl/PipelinedAuthenticatorImpl.h"
+#include "Matcher/Matcher.h"
+#include <vector>
+
+namespace RealSenseID
+{
+PipelinedAuthenticator::PipelinedAuthenticator(MatchDecisionCallback& callback, ThresholdsConfidenceEnum confidence_level,
+                                               size_t queue_capacity, unsigned int match_threads, unsigned int no_face_interval_ms)
+{
+    Thresholds thresholds;
+    Matcher::SetToDefaultThresholds(thresholds, confidence_level);
+    _impl = new Impl::PipelinedAuthenticatorImpl(thresholds, callback, queue_capacity, match_threads,
+                                                 std::chrono::milliseconds {no_face_interval_ms});
+}
+
+PipelinedAuthenticator::~PipelinedAuthenticator()
+{
+    try
+    {
+        delete _impl;
+    }
+    catch (...)
+    {
+    }
+    _impl = nullptr;
+}
+
+size_t PipelinedAuthenticator::AddUsers(const UserFaceprints* user_features, size_t num_of_users)
+{
+    if (user_features == nullptr || num_of_users == 0)
+    {
+        return 0;
+    }
+    return _impl->Gallery().Add(std::vector<UserFaceprints_t>(user_features, user_features + num_of_users));
+}
+
+void PipelinedAuthenticator::RemoveAllUsers()
+{
+    _impl->Gallery().Assign(FaceprintsGallery());
+}
+
+size_t PipelinedAuthenticator::QueryNumberOfUsers() const
+{
+    return _impl->Gallery().Size();
+}
+
+Status PipelinedAuthenticator::RunLoop(FaceAuthenticator& authenticator)
+{
+    return _impl->RunLoop(authenticator);
+}
+
+void PipelinedAuthenticator::Stop()
+{
+    _impl->Stop();
+}
+
+size_t PipelinedAuthenticator::Dropped() const
+{
+    return _impl->Dropped();
+}
+} // namespace RealSenseID
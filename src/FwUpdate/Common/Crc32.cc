@@ -0,0 +1,311 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#include "Crc32.h"
+#include "CpuFeatures.h"
+#include <cstring>
+
+// the armv8 crc32 kernel is only built with RSID_CRC32_ARM defined: it was never run against the byte-wise loop on
+// arm64 (rsid-matcher-bench --verify), so arm64 uses slicing by 8 until it is.
+#if RSID_ARCH_X86
+#include <immintrin.h>
+#endif
+
+#if RSID_ARCH_ARM64 && defined(RSID_CRC32_ARM) && defined(_MSC_VER)
+#include <intrin.h>
+#elif RSID_ARCH_ARM64 && defined(RSID_CRC32_ARM) && defined(__ARM_ACLE)
+#include <arm_acle.h>
+#else
+#undef RSID_CRC32_ARM
+#endif
+
+// gcc/clang need the target attribute to allow intrinsics of instruction sets that are not enabled globally.
+// msvc allows them anywhere.
+#if defined(__clang__)
+#define RSID_TARGET(isa) __attribute__((target(isa)))
+#define RSID_TARGET_ARMCRC __attribute__((target("crc")))
+#elif defined(__GNUC__)
+#define RSID_TARGET(isa) __attribute__((target(isa)))
+#define RSID_TARGET_ARMCRC __attribute__((target("+crc")))
+#else
+#define RSID_TARGET(isa)
+#define RSID_TARGET_ARMCRC
+#endif
+
+namespace RealSenseID
+{
+namespace FwUpdateCommon
+{
+static constexpr uint32_t CRC_LUT[256] = {
+    0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e,
+    0x97d2d988, 0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2, 0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb,
+    0xf4d4b551, 0x83d385c7, 0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5, 0x3b6e20c8,
+    0x4c69105e, 0xd56041e4, 0xa2677172, 0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b, 0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940,
+    0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59, 0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423, 0xcfba9599,
+    0xb8bda50f, 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924, 0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d, 0x76dc4190, 0x01db7106,
+    0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433, 0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb,
+    0x086d3d2d, 0x91646c97, 0xe6635c01, 0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e, 0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457,
+    0x65b0d9c6, 0x12b7e950, 0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65, 0x4db26158, 0x3ab551ce, 0xa3bc0074,
+    0xd4bb30e2, 0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb, 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0, 0x44042d73, 0x33031de5,
+    0xaa0a4c5f, 0xdd0d7cc9, 0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f, 0x5edef90e,
+    0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81, 0xb7bd5c3b, 0xc0ba6cad, 0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
+    0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683, 0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27,
+    0x7d079eb1, 0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7, 0xfed41b76, 0x89d32be0,
+    0x10da7a5a, 0x67dd4acc, 0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5, 0xd6d6a3e8, 0xa1d1937e, 0x38d8c2c4, 0x4fdff252, 0xd1bb67f1,
+    0xa6bc5767, 0x3fb506dd, 0x48b2364b, 0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79,
+    0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236, 0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f, 0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92,
+    0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d, 0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f,
+    0x72076785, 0x05005713, 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38, 0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21, 0x86d3d2d4,
+    0xf1d4e242, 0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777, 0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c,
+    0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45, 0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2, 0xa7672661, 0xd06016f7, 0x4969474d,
+    0x3e6e77db, 0xaed16a4a, 0xd9d65adc, 0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9, 0xbdbdf21c, 0xcabac28a,
+    0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37,
+    0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
+};
+
+// slicing by 8: slice k holds the crc of a byte followed by k zero bytes, so 8 bytes are folded with 8 independent
+// lookups instead of 8 dependent ones.
+struct Crc32Slices
+{
+    uint32_t slice[8][256];
+};
+
+static constexpr Crc32Slices MakeCrc32Slices()
+{
+    Crc32Slices slices {};
+    for (unsigned int i = 0; i < 256; i++)
+    {
+        slices.slice[0][i] = CRC_LUT[i];
+    }
+    for (unsigned int k = 1; k < 8; k++)
+    {
+        for (unsigned int i = 0; i < 256; i++)
+        {
+            uint32_t prev = slices.slice[k - 1][i];
+            slices.slice[k][i] = (prev >> 8) ^ CRC_LUT[prev & 0xff];
+        }
+    }
+    return slices;
+}
+
+static constexpr Crc32Slices CRC_SLICES = MakeCrc32Slices();
+
+// the words are loaded as values (not bytes), so the bytes order is the same as the word-wise table loop on any
+// endianness.
+uint32_t Crc32UpdateSlicing8(uint32_t crc, const void* words, size_t n_words)
+{
+    auto current = static_cast<const unsigned char*>(words);
+    const auto& slice = CRC_SLICES.slice;
+
+    for (; n_words >= 2; n_words -= 2)
+    {
+        uint32_t value0, value1;
+        ::memcpy(&value0, current, sizeof(value0));
+        ::memcpy(&value1, current + sizeof(value0), sizeof(value1));
+        current += 2 * sizeof(uint32_t);
+
+        crc ^= value0;
+        crc = slice[7][crc & 0xff] ^ slice[6][(crc >> 8) & 0xff] ^ slice[5][(crc >> 16) & 0xff] ^ slice[4][crc >> 24] ^
+              slice[3][value1 & 0xff] ^ slice[2][(value1 >> 8) & 0xff] ^ slice[1][(value1 >> 16) & 0xff] ^ slice[0][value1 >> 24];
+    }
+
+    if (n_words > 0)
+    {
+        uint32_t value;
+        ::memcpy(&value, current, sizeof(value));
+        crc ^= value;
+        crc = slice[3][crc & 0xff] ^ slice[2][(crc >> 8) & 0xff] ^ slice[1][(crc >> 16) & 0xff] ^ slice[0][crc >> 24];
+    }
+    return crc;
+}
+
+#if RSID_ARCH_X86
+// Carry-less multiplication folding ("Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction",
+// Intel): 4 x 128 bit lanes are folded 64 bytes ahead while there are more, then folded into one lane, which is
+// reduced to 64 and then 32 bits (Barrett reduction). The constants are x^n mod P(x) of the bit-reflected
+// polynom, for the fold distances (k1/k2: 4x128 bits, k3/k4: 128 bits, k5: 64 bits) and P(x) / mu for the reduction.
+// Little endian (x86), so the bytes order is the same as of the words values.
+alignas(16) static const uint64_t CRC_PCLMUL_K1K2[2] = {0x0154442bd4, 0x01c6e41596};
+alignas(16) static const uint64_t CRC_PCLMUL_K3K4[2] = {0x01751997d0, 0x00ccaa009e};
+alignas(16) static const uint64_t CRC_PCLMUL_K5K0[2] = {0x0163cd6124, 0x0000000000};
+alignas(16) static const uint64_t CRC_PCLMUL_POLY[2] = {0x01db710641, 0x01f7011641};
+
+// n_bytes must be at least 64 and a multiple of 16.
+RSID_TARGET("pclmul,sse4.1")
+static uint32_t Crc32FoldPclmul(uint32_t crc, const unsigned char* buffer, size_t n_bytes)
+{
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x00));
+    x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x10));
+    x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x20));
+    x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(CRC_PCLMUL_K1K2));
+    buffer += 64;
+    n_bytes -= 64;
+
+    // fold 4 lanes by 64 bytes
+    while (n_bytes >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x00));
+        y6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x10));
+        y7 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x20));
+        y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        buffer += 64;
+        n_bytes -= 64;
+    }
+
+    // fold the 4 lanes into one
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(CRC_PCLMUL_K3K4));
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // fold the remaining 16 bytes blocks
+    while (n_bytes >= 16)
+    {
+        x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer));
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        buffer += 16;
+        n_bytes -= 16;
+    }
+
+    // fold 128 to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(CRC_PCLMUL_K5K0));
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // barrett reduction to 32 bits
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(CRC_PCLMUL_POLY));
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+// the 64 bytes multiple head with pclmulqdq, the rest with slicing by 8.
+static uint32_t Crc32UpdatePclmul(uint32_t crc, const void* words, size_t n_words)
+{
+    auto current = static_cast<const unsigned char*>(words);
+    const size_t n_bytes = n_words * sizeof(uint32_t);
+    const size_t n_fold_bytes = n_bytes & ~static_cast<size_t>(63);
+    if (n_fold_bytes > 0)
+    {
+        crc = Crc32FoldPclmul(crc, current, n_fold_bytes);
+    }
+    return Crc32UpdateSlicing8(crc, current + n_fold_bytes, (n_bytes - n_fold_bytes) / sizeof(uint32_t));
+}
+#endif // RSID_ARCH_X86
+
+#ifdef RSID_CRC32_ARM
+// the armv8 crc32 instructions implement this polynom (crc32, not crc32c). little endian, so the bytes order is the
+// same as of the words values.
+RSID_TARGET_ARMCRC
+static uint32_t Crc32UpdateArm(uint32_t crc, const void* words, size_t n_words)
+{
+    auto current = static_cast<const unsigned char*>(words);
+    for (; n_words >= 2; n_words -= 2)
+    {
+        uint64_t value;
+        ::memcpy(&value, current, sizeof(value));
+        crc = __crc32d(crc, value);
+        current += sizeof(value);
+    }
+    if (n_words > 0)
+    {
+        uint32_t value;
+        ::memcpy(&value, current, sizeof(value));
+        crc = __crc32w(crc, value);
+    }
+    return crc;
+}
+#endif // RSID_CRC32_ARM
+
+struct Crc32Kernel
+{
+    Crc32UpdateFn update;
+    const char* name;
+};
+
+static Crc32Kernel SelectCrc32Kernel()
+{
+    const CpuFeatures& cpu = GetCpuFeatures();
+    (void)cpu;
+#if RSID_ARCH_X86
+    if (cpu.pclmul && cpu.sse41)
+    {
+        return {Crc32UpdatePclmul, "pclmul"};
+    }
+#endif
+#ifdef RSID_CRC32_ARM
+    if (cpu.armcrc32)
+    {
+        return {Crc32UpdateArm, "armv8-crc32"};
+    }
+#endif
+    return {Crc32UpdateSlicing8, "slicing-by-8"};
+}
+
+static const Crc32Kernel& ActiveCrc32Kernel()
+{
+    static const Crc32Kernel kernel = SelectCrc32Kernel();
+    return kernel;
+}
+
+uint32_t Crc32Update(uint32_t crc, const void* words, size_t n_words)
+{
+    return ActiveCrc32Kernel().update(crc, words, n_words);
+}
+
+Crc32UpdateFn ActiveCrc32Update(const char** name)
+{
+    const Crc32Kernel& kernel = ActiveCrc32Kernel();
+    if (name != nullptr)
+    {
+        *name = kernel.name;
+    }
+    return kernel.update;
+}
+} // namespace FwUpdateCommon
+} // namespace RealSenseID
@@ -0,0 +1,27 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// crc-32 (reflected polynom 0xedb88320) kernels of CalculateCRC().
+// Each kernel updates the crc register (without the initial / final inversion) over n_words 32 bit words, each word
+// from its least significant byte, and gives bit identical results.
+namespace RealSenseID
+{
+namespace FwUpdateCommon
+{
+using Crc32UpdateFn = uint32_t (*)(uint32_t crc, const void* words, size_t n_words);
+
+// table driven, 8 bytes per step (slicing by 8). any platform.
+uint32_t Crc32UpdateSlicing8(uint32_t crc, const void* words, size_t n_words);
+
+// the best kernel of the running cpu: pclmulqdq folding on x86, else slicing by 8 (or the armv8 crc32 instructions
+// on arm64 if built with RSID_CRC32_ARM, see Crc32.cc). selected once on first call.
+uint32_t Crc32Update(uint32_t crc, const void* words, size_t n_words);
+
+// the kernel Crc32Update() uses and its name.
+Crc32UpdateFn ActiveCrc32Update(const char** name = nullptr);
+} // namespace FwUpdateCommon
+} // namespace RealSenseID
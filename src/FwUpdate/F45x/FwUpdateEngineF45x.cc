@@ -532,7 +532,20 @@ void FwUpdateEngineF45x::BurnModules(const Settings& settings, const ModuleVecto
     try
     {
         _comm->WaitForIdle();
-        _comm->WriteCmd(F45xCmds::dlspd(settings.baud_rate), true);
+        // the device downloads at the dlspd rate once it acked it, the connection was opened at the default rate.
+        // so ask for a rate the host can't switch to and the device would be left at a rate nobody talks.
+        long baud_rate = settings.baud_rate;
+        if (baud_rate != Settings::DefaultBaudRate && !_comm->SupportsBaudRate(baud_rate))
+        {
+            LOG_WARNING(LOG_TAG, "Baud rate %ld not supported by the host, using %ld", baud_rate, Settings::DefaultBaudRate);
+            baud_rate = Settings::DefaultBaudRate;
+        }
+        _comm->WriteCmd(F45xCmds::dlspd(baud_rate), true);
+        if (baud_rate != Settings::DefaultBaudRate)
+        {
+            _comm->SetBaudRate(baud_rate);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
         auto device_modules = ModulesFromDevice();
         on_progress(0.0f);
         CleanObsoleteModules(modules, device_modules);
@@ -146,11 +146,34 @@ void FwUpdaterCommF45x::WriteBinary(const char* buf, size_t n_bytes)
         {
             throw std::runtime_error("FwUpdaterComm::WriteBinary failed");
         }
-        // Give the device time to process the chunk
+        // Give the device time to process the chunk, once it was transmitted
+        status = _serial->Drain();
+        if (status != PacketManager::SerialStatus::Ok)
+        {
+            throw std::runtime_error("FwUpdaterComm::WriteBinary failed");
+        }
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
 }
 
+void FwUpdaterCommF45x::SetBaudRate(long baud_rate)
+{
+    if (baud_rate <= 0)
+    {
+        throw std::runtime_error("FwUpdaterComm::SetBaudRate invalid baud rate");
+    }
+    auto status = _serial->SetBaudRate(static_cast<unsigned int>(baud_rate));
+    if (status != PacketManager::SerialStatus::Ok)
+    {
+        throw std::runtime_error("FwUpdaterComm::SetBaudRate failed");
+    }
+}
+
+bool FwUpdaterCommF45x::SupportsBaudRate(long baud_rate) const
+{
+    return baud_rate > 0 && _serial->SupportsBaudRate(static_cast<unsigned int>(baud_rate));
+}
+
 // 1. Wait until input drained
 // 2. Send the command
 // 3. Wait for cmd "ack" upto 1 second, if wait_response is true
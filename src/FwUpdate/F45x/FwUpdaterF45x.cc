@@ -24,7 +24,6 @@ namespace FwUpdateF45x
 
 static const char* LOG_TAG = "FwUpdateF45x";
 
-static constexpr long NORMAL_BAUD_RATE = 115200;
 static constexpr long FAST_BAUD_RATE = 230400;
 static constexpr long FASTER_BAUD_RATE = 460800;
 
@@ -158,7 +157,7 @@ Status FwUpdaterF45x::UpdateModules(FwUpdater::EventHandler* handler, FwUpdater:
 
         FwUpdateEngineF45x::Settings internal_settings;
         internal_settings.fw_filename = binPath;
-        internal_settings.baud_rate = NORMAL_BAUD_RATE;
+        internal_settings.baud_rate = settings.baud_rate;
         internal_settings.serial_config = settings.serial_config;
         internal_settings.force_full = settings.force_full;
 
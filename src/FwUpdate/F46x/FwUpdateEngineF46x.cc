@@ -361,7 +361,19 @@ void FwUpdateEngineF46x::BurnModules(const Settings& settings, const ModuleVecto
     {
         on_progress(0.0f);
         _comm->WaitForIdle();
-        _comm->WriteCmd(F46xCmds::dlspd(settings.baud_rate), true);
+        // the device downloads at the dlspd rate once it acked it, the connection was opened at the default rate.
+        // so ask for a rate the host can't switch to and the device would be left at a rate nobody talks.
+        long baud_rate = settings.baud_rate;
+        if (baud_rate != Settings::DefaultBaudRate && !_comm->SupportsBaudRate(baud_rate))
+        {
+            LOG_WARNING(LOG_TAG, "Baud rate %ld not supported by the host, using %ld", baud_rate, Settings::DefaultBaudRate);
+            baud_rate = Settings::DefaultBaudRate;
+        }
+        _comm->WriteCmd(F46xCmds::dlspd(baud_rate), true);
+        if (baud_rate != Settings::DefaultBaudRate)
+        {
+            _comm->SetBaudRate(baud_rate);
+        }
         std::this_thread::sleep_for(50ms);
         // clean to make sure we have enough space
         _comm->WriteCmd(F46xCmds::dlclean());
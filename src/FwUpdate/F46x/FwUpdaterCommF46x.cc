@@ -146,11 +146,34 @@ void FwUpdaterCommF46x::WriteBinary(const char* buf, size_t n_bytes)
         {
             throw std::runtime_error("FwUpdaterComm::WriteBinary failed");
         }
-        // Give the device time to process the chunk
+        // Give the device time to process the chunk, once it was transmitted
+        status = _serial->Drain();
+        if (status != PacketManager::SerialStatus::Ok)
+        {
+            throw std::runtime_error("FwUpdaterComm::WriteBinary failed");
+        }
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
 }
 
+void FwUpdaterCommF46x::SetBaudRate(long baud_rate)
+{
+    if (baud_rate <= 0)
+    {
+        throw std::runtime_error("FwUpdaterComm::SetBaudRate invalid baud rate");
+    }
+    auto status = _serial->SetBaudRate(static_cast<unsigned int>(baud_rate));
+    if (status != PacketManager::SerialStatus::Ok)
+    {
+        throw std::runtime_error("FwUpdaterComm::SetBaudRate failed");
+    }
+}
+
+bool FwUpdaterCommF46x::SupportsBaudRate(long baud_rate) const
+{
+    return baud_rate > 0 && _serial->SupportsBaudRate(static_cast<unsigned int>(baud_rate));
+}
+
 // Remove newlines from string for debug print
 static std::string StripNewlines(const std::string& str)
 {
@@ -40,6 +40,13 @@ public:
     // throw std::runtime_error if failed
     void WriteBinary(const char* buf, size_t n_bytes);
 
+    // switch the host side of the connection to the baud rate (once the device acked the dlspd command)
+    // throw std::runtime_error if failed
+    void SetBaudRate(long baud_rate);
+
+    // whether SetBaudRate(baud_rate) can succeed on the host side of the connection
+    bool SupportsBaudRate(long baud_rate) const;
+
     // 1. Wait until input drained
     // 2. Send the command
     // 3 Waif for cmd "ack" upto 1 second, if wait_response is true
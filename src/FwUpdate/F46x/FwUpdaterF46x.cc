@@ -21,7 +21,6 @@ namespace FwUpdateF46x
 {
 
 static const char* LOG_TAG = "FwUpdaterF46x";
-static constexpr long NORMAL_BAUD_RATE = 115200;
 static const char* MODULE_OPFW = "OPFW";
 static const char* MODULE_RECOG = "RECOG";
 
@@ -96,7 +95,7 @@ Status FwUpdaterF46x::UpdateModules(FwUpdater::EventHandler* handler, FwUpdater:
 
         FwUpdateEngineF46x::Settings internal_settings;
         internal_settings.fw_filename = binPath;
-        internal_settings.baud_rate = NORMAL_BAUD_RATE;
+        internal_settings.baud_rate = settings.baud_rate;
         internal_settings.serial_config = settings.serial_config;
         internal_settings.force_full = settings.force_full;
 
@@ -0,0 +1,74 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+// std allocator returning memory aligned to a given boundary (e.g. cache line), usable with std::vector.
+// implemented on top of malloc so it doesn't require c++17 aligned new (android builds use c++14).
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace RealSenseID
+{
+template <typename T, std::size_t Alignment = 64>
+class AlignedAllocator
+{
+    static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of 2");
+
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() noexcept = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        if (n > (SIZE_MAX - Alignment - sizeof(void*)) / sizeof(T))
+        {
+            throw std::bad_alloc();
+        }
+        void* raw = std::malloc(n * sizeof(T) + Alignment - 1 + sizeof(void*));
+        if (raw == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        // keep the original pointer right before the aligned block.
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + Alignment - 1) & ~(uintptr_t)(Alignment - 1);
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    void deallocate(T* p, std::size_t) noexcept
+    {
+        if (p != nullptr)
+        {
+            std::free(reinterpret_cast<void**>(p)[-1]);
+        }
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept
+    {
+        return false;
+    }
+};
+} // namespace RealSenseID
@@ -0,0 +1,221 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "ConcurrentFaceprintsGallery.h"
+#include "Logger.h"
+#include <cstring>
+#include <thread>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "ConcurrentFaceprintsGallery";
+
+// A reader increments the counter of the current epoch parity, and then re-checks the epoch: if a writer flipped the
+// epoch meanwhile, the writer may not have seen the increment, so the reader backs off and retries in the new epoch.
+// Otherwise the writer will wait for it before freeing the gallery the reader loads. All operations are sequentially
+// consistent, so a reader that entered the new epoch loads the newly published gallery.
+ConcurrentFaceprintsGallery::ReadGuard::ReadGuard(const ConcurrentFaceprintsGallery& owner) : owner(owner)
+{
+    for (;;)
+    {
+        uint32_t epoch = owner._epoch.load();
+        parity = epoch & 1;
+        owner._readers[parity].fetch_add(1);
+        if (owner._epoch.load() == epoch)
+        {
+            break;
+        }
+        owner._readers[parity].fetch_sub(1);
+    }
+
+    gallery = owner._current.load();
+}
+
+ConcurrentFaceprintsGallery::ReadGuard::~ReadGuard()
+{
+    owner._readers[parity].fetch_sub(1);
+}
+
+ConcurrentFaceprintsGallery::ConcurrentFaceprintsGallery() : _current(new FaceprintsGallery()), _epoch(0), _lineage(0)
+{
+    _readers[0] = 0;
+    _readers[1] = 0;
+}
+
+ConcurrentFaceprintsGallery::~ConcurrentFaceprintsGallery()
+{
+    delete _current.load();
+}
+
+bool ConcurrentFaceprintsGallery::Add(const char* user_id, const Faceprints& faceprints)
+{
+    std::lock_guard<std::mutex> lock(_writeMutex);
+
+    FaceprintsGallery* gallery = new FaceprintsGallery(*_current.load());
+    if (!gallery->Add(user_id, faceprints))
+    {
+        delete gallery;
+        return false;
+    }
+
+    Publish(gallery);
+    return true;
+}
+
+size_t ConcurrentFaceprintsGallery::Add(const std::vector<UserFaceprints_t>& users)
+{
+    std::lock_guard<std::mutex> lock(_writeMutex);
+
+    FaceprintsGallery* gallery = new FaceprintsGallery(*_current.load());
+    gallery->Reserve(gallery->Size() - gallery->MappedSize() + users.size());
+
+    size_t added = 0;
+    for (const auto& user : users)
+    {
+        added += gallery->Add(user) ? 1 : 0;
+    }
+
+    Publish(gallery);
+    return added;
+}
+
+void ConcurrentFaceprintsGallery::Assign(const FaceprintsGallery& gallery)
+{
+    std::lock_guard<std::mutex> lock(_writeMutex);
+    Publish(new FaceprintsGallery(gallery));
+    _lineage.fetch_add(1);
+}
+
+ExtendedMatchResult ConcurrentFaceprintsGallery::Match(const MatchElement& probe_faceprints, Faceprints& updated_faceprints,
+                                                       char* user_id, const Thresholds& thresholds, const unsigned int num_threads)
+{
+    return MatchImpl(probe_faceprints, updated_faceprints, user_id, thresholds, nullptr, num_threads);
+}
+
+ExtendedMatchResult ConcurrentFaceprintsGallery::Match(const MatchElement& probe_faceprints, Faceprints& updated_faceprints,
+                                                       char* user_id, const Thresholds& thresholds, MatchResultCache& cache,
+                                                       const unsigned int num_threads)
+{
+    return MatchImpl(probe_faceprints, updated_faceprints, user_id, thresholds, &cache, num_threads);
+}
+
+ExtendedMatchResult ConcurrentFaceprintsGallery::MatchImpl(const MatchElement& probe_faceprints, Faceprints& updated_faceprints,
+                                                           char* user_id, const Thresholds& thresholds, MatchResultCache* cache,
+                                                           const unsigned int num_threads)
+{
+    ExtendedMatchResult result;
+    uint32_t sequence = 0;
+    ::memset(user_id, 0, FaceprintsGallery::UserIdStride);
+
+    // read before the gallery: Assign() publishes before incrementing it, so if the gallery read below is replaced
+    // later, the lineage differs at PublishUpdate().
+    const uint64_t lineage = _lineage.load();
+
+    result.userId = -1;
+    result.maxScore = 0;
+
+    {
+        ReadGuard guard(*this);
+        const FaceprintsGallery& gallery = *guard.gallery;
+
+        if (!Matcher::CheckGalleryMatch(probe_faceprints, gallery))
+        {
+            return result;
+        }
+
+        feature_t probeFaceFlags = probe_faceprints.data.featuresVector[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS];
+        bool probe_has_mask = (probeFaceFlags == FaVectorFlagsEnum::VecFlagValidWithMask) ? true : false;
+
+        // the update is computed from this copy, and published only if the user is still at its sequence.
+        Faceprints matched_faceprints;
+        size_t cached_index = 0;
+        const bool scan = (cache == nullptr || !cache->Lookup(gallery, thresholds, cached_index) ||
+                           !Matcher::ScoreCachedUser(probe_faceprints, gallery, cached_index, probe_has_mask, thresholds,
+                                                     cache->ScoreMargin(), result, matched_faceprints, sequence));
+        if (scan)
+        {
+            result = ExtendedMatchResult();
+
+            TagResult scoresResult;
+            if (!Matcher::GetScores(probe_faceprints, gallery, scoresResult, probe_has_mask, num_threads))
+            {
+                LOG_ERROR(LOG_TAG, "Failed during GetScores() - please check.");
+                return result;
+            }
+
+            result.maxScore = scoresResult.score;
+            result.userId = scoresResult.idx;
+
+            if (static_cast<size_t>(result.userId) >= gallery.Size())
+            {
+                LOG_ERROR(LOG_TAG, "Invalid user_index : Skipping function.");
+                return result;
+            }
+
+            sequence = gallery.ReadFaceprints(static_cast<size_t>(result.userId), matched_faceprints);
+        }
+
+        size_t user_index = (size_t)result.userId;
+        ::strncpy(user_id, gallery.UserId(user_index), FaceprintsGallery::UserIdStride - 1);
+
+        Matcher::ApplyMatchDecision(probe_faceprints, matched_faceprints, probe_has_mask, thresholds, result, updated_faceprints);
+
+        // like Matcher::MatchFaceprintsToGallery() with a cache: a user accepted by a scan is cached (from its
+        // generation before this match's update, which the cache allows).
+        if (cache != nullptr && scan && result.isSame)
+        {
+            cache->Store(gallery, thresholds, user_index);
+        }
+        else if (cache != nullptr && !result.isSame)
+        {
+            cache->Invalidate();
+        }
+    }
+
+    if (result.should_update && !PublishUpdate(lineage, static_cast<size_t>(result.userId), user_id, sequence, updated_faceprints))
+    {
+        LOG_DEBUG(LOG_TAG, "User %d was updated concurrently, dropping this update.", result.userId);
+        result.should_update = false;
+    }
+
+    return result;
+}
+
+size_t ConcurrentFaceprintsGallery::Size() const
+{
+    ReadGuard guard(*this);
+    return guard.gallery->Size();
+}
+
+void ConcurrentFaceprintsGallery::Publish(FaceprintsGallery* gallery)
+{
+    FaceprintsGallery* previous = _current.exchange(gallery);
+
+    // readers entering from now on see the new epoch and the new gallery. wait for the readers of the previous
+    // epoch, which may still use the previous gallery.
+    uint32_t epoch = _epoch.fetch_add(1);
+    while (_readers[epoch & 1].load() != 0)
+    {
+        std::this_thread::yield();
+    }
+
+    delete previous;
+}
+
+bool ConcurrentFaceprintsGallery::PublishUpdate(uint64_t lineage, size_t index, const char* user_id, uint32_t sequence,
+                                                const Faceprints& faceprints)
+{
+    std::lock_guard<std::mutex> lock(_writeMutex);
+
+    // Add() copies keep the users at their indices and sequences, but after an Assign() the index (and sequence) may
+    // belong to another user - so the update is dropped, and the user id is checked too.
+    FaceprintsGallery* gallery = _current.load();
+    if (_lineage.load() != lineage || index >= gallery->Size() || gallery->Sequence(index) != sequence ||
+        ::strncmp(gallery->UserId(index), user_id, FaceprintsGallery::UserIdStride) != 0)
+    {
+        return false;
+    }
+
+    return gallery->Update(index, faceprints);
+}
+} // namespace RealSenseID
@@ -0,0 +1,105 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include "MatchResultCache.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace RealSenseID
+{
+// FaceprintsGallery shared by several matching threads (e.g. one per camera), with lock free reads.
+//
+// Match() doesn't take any lock: it enters the current read epoch (two atomic counters), scans the current gallery
+// and leaves the epoch. The adaptive update of the matched user (should_update) is published in place under the
+// user's seqlock (FaceprintsGallery::Update()), so scans running at the same time either see the old or the new
+// faceprints of the user, never a mix. Updates are serialized by a writer mutex, which readers never take.
+//
+// Structural changes (Add, Assign) are read-copy-update: the gallery is copied, changed and published, and the
+// previous copy is freed after the readers of its epoch are done. They cost a copy of the gallery (mapped users
+// included: the copies keep their users in memory, so updates never write rows another copy's readers scan), so add
+// users in batches where possible.
+class ConcurrentFaceprintsGallery
+{
+public:
+    ConcurrentFaceprintsGallery();
+    ~ConcurrentFaceprintsGallery();
+
+    ConcurrentFaceprintsGallery(const ConcurrentFaceprintsGallery&) = delete;
+    ConcurrentFaceprintsGallery& operator=(const ConcurrentFaceprintsGallery&) = delete;
+
+    // returns false if faceprints failed validation.
+    bool Add(const char* user_id, const Faceprints& faceprints);
+
+    // add users in a single copy of the gallery. returns the number of users added (users that failed validation are
+    // skipped).
+    size_t Add(const std::vector<UserFaceprints_t>& users);
+
+    // replace all users with a copy of gallery (e.g. a gallery opened by FaceprintsGalleryFile). later changes of
+    // either gallery are not seen by the other.
+    void Assign(const FaceprintsGallery& gallery);
+
+    // lock free 1:N match, same result as Matcher::MatchFaceprintsToGallery(). if should_update, the updated faceprints
+    // are also published to the gallery and returned in updated_faceprints (e.g. to persist them). if the user was
+    // updated by another thread since this match read it, the update is dropped and should_update is set to false.
+    // user_id (FaceprintsGallery::UserIdStride chars) receives the id of the matched user, read from the gallery the
+    // match scanned (empty if there's no matched user).
+    ExtendedMatchResult Match(const MatchElement& probe_faceprints, Faceprints& updated_faceprints, char* user_id,
+                              const Thresholds& thresholds, const unsigned int num_threads = 1);
+
+    // same, for a stream of probes of (usually) the same person: the probe is first scored against the user last
+    // accepted through the cache, and the gallery is only scanned if it isn't accepted by a margin (see
+    // Matcher::MatchFaceprintsToGallery() with a cache). the cache is not thread safe: one per probes stream.
+    ExtendedMatchResult Match(const MatchElement& probe_faceprints, Faceprints& updated_faceprints, char* user_id,
+                              const Thresholds& thresholds, MatchResultCache& cache, const unsigned int num_threads = 1);
+
+    // call fn(const FaceprintsGallery&) with the current gallery, lock free (e.g. to get the user id of a match). the
+    // gallery may be updated by a concurrent Match(), so fn should only read it through the seqlock readers (see
+    // FaceprintsGallery), not run batch scans like Matcher::MatchBatch().
+    template <typename Fn>
+    void Read(Fn fn) const
+    {
+        ReadGuard guard(*this);
+        fn(*guard.gallery);
+    }
+
+    size_t Size() const;
+
+private:
+    // read side critical section: readers count themselves in the counter of the epoch they entered.
+    struct ReadGuard
+    {
+        explicit ReadGuard(const ConcurrentFaceprintsGallery& owner);
+        ~ReadGuard();
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        const ConcurrentFaceprintsGallery& owner;
+        uint32_t parity;
+        const FaceprintsGallery* gallery;
+    };
+
+    // both Match(), cache may be null.
+    ExtendedMatchResult MatchImpl(const MatchElement& probe_faceprints, Faceprints& updated_faceprints, char* user_id,
+                                  const Thresholds& thresholds, MatchResultCache* cache, const unsigned int num_threads);
+
+    // publish a new gallery and free the previous one once no reader can use it. called with _writeMutex held.
+    void Publish(FaceprintsGallery* gallery);
+
+    // in place seqlock update of a user, if the gallery wasn't replaced since lineage and the user is still at the
+    // given sequence.
+    bool PublishUpdate(uint64_t lineage, size_t index, const char* user_id, uint32_t sequence, const Faceprints& faceprints);
+
+    std::atomic<FaceprintsGallery*> _current;
+    std::atomic<uint32_t> _epoch;
+    // incremented by Assign() after it published the other gallery: Add() copies keep the users indices and
+    // sequences, Assign() doesn't.
+    std::atomic<uint64_t> _lineage;
+    mutable std::atomic<uint32_t> _readers[2];
+    std::mutex _writeMutex;
+};
+} // namespace RealSenseID
@@ -0,0 +1,464 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FaceprintsGallery.h"
+#include "MatcherKernels.h"
+#include "Logger.h"
+#include <cmath>
+#include <cstring>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "FaceprintsGallery";
+
+// source of the gallery generations (0 is the generation of a gallery that was never changed).
+static std::atomic<uint64_t> s_lastGeneration {0};
+
+static_assert((FaceprintsGallery::VectorLength * sizeof(feature_t)) % FaceprintsGallery::Alignment == 0,
+              "gallery rows must keep the cache line alignment");
+
+// the mapped elements followed by the in memory ones.
+template <typename Owned, typename T>
+static Owned Concat(const T* mapped, size_t mapped_count, const Owned& owned)
+{
+    Owned all;
+    all.reserve(mapped_count + owned.size());
+    all.insert(all.end(), mapped, mapped + mapped_count);
+    all.insert(all.end(), owned.begin(), owned.end());
+    return all;
+}
+
+FaceprintsGallery::FaceprintsGallery(const FaceprintsGallery& other) :
+    _noMaskVectors(Concat(other._mapped.noMaskVectors, other._mapped.count * VectorLength, other._noMaskVectors)),
+    _maskVectors(Concat(other._mapped.maskVectors, other._mapped.count * VectorLength, other._maskVectors)),
+    _noMaskNorms(Concat(other._mapped.noMaskNorms, other._mapped.count, other._noMaskNorms)),
+    _maskNorms(Concat(other._mapped.maskNorms, other._mapped.count, other._maskNorms)),
+    _maskFlags(Concat(other._mapped.maskFlags, other._mapped.count, other._maskFlags)),
+    _versions(Concat(other._mapped.versions, other._mapped.count, other._versions)),
+    _userIds(Concat(other._mapped.userIds, other._mapped.count * UserIdStride, other._userIds)),
+    _faceprints(Concat(other._mapped.faceprints, other._mapped.count, other._faceprints)), _sequences(other._sequences),
+    _versionCounts(other._versionCounts), _commonVersion(other._commonVersion), _generation(other._generation),
+    _updateRunIndex(other._updateRunIndex), _updateRunBase(other._updateRunBase), _updateRunGeneration(other._updateRunGeneration),
+    _quantizedTier(other._quantizedTier), _noMaskQuantized(other._noMaskQuantized), _maskQuantized(other._maskQuantized),
+    _noMaskQuantizedInvNorms(other._noMaskQuantizedInvNorms), _maskQuantizedInvNorms(other._maskQuantizedInvNorms)
+{
+}
+
+FaceprintsGallery& FaceprintsGallery::operator=(const FaceprintsGallery& other)
+{
+    if (this != &other)
+    {
+        *this = FaceprintsGallery(other);
+    }
+    return *this;
+}
+
+void FaceprintsGallery::SetQuantizedTier(bool enable)
+{
+    if (enable == _quantizedTier)
+    {
+        return;
+    }
+
+    _quantizedTier = enable;
+    _noMaskQuantized.clear();
+    _maskQuantized.clear();
+    _noMaskQuantizedInvNorms.clear();
+    _maskQuantizedInvNorms.clear();
+
+    if (!enable)
+    {
+        _noMaskQuantized.shrink_to_fit();
+        _maskQuantized.shrink_to_fit();
+        _noMaskQuantizedInvNorms.shrink_to_fit();
+        _maskQuantizedInvNorms.shrink_to_fit();
+        return;
+    }
+
+    _noMaskQuantized.resize(Size() * VectorLength);
+    _maskQuantized.resize(Size() * VectorLength);
+    _noMaskQuantizedInvNorms.resize(Size());
+    _maskQuantizedInvNorms.resize(Size());
+    for (size_t i = 0; i < Size(); i++)
+    {
+        SetQuantizedRow(i);
+    }
+}
+
+void FaceprintsGallery::Reserve(size_t num_users)
+{
+    _noMaskVectors.reserve(num_users * VectorLength);
+    _maskVectors.reserve(num_users * VectorLength);
+    _noMaskNorms.reserve(num_users);
+    _maskNorms.reserve(num_users);
+    _maskFlags.reserve(num_users);
+    _versions.reserve(num_users);
+    _userIds.reserve(num_users * UserIdStride);
+    _faceprints.reserve(num_users);
+    _sequences.reserve(num_users);
+
+    if (_quantizedTier)
+    {
+        _noMaskQuantized.reserve(num_users * VectorLength);
+        _maskQuantized.reserve(num_users * VectorLength);
+        _noMaskQuantizedInvNorms.reserve(num_users);
+        _maskQuantizedInvNorms.reserve(num_users);
+    }
+}
+
+bool FaceprintsGallery::Add(const UserFaceprints_t& user_faceprints)
+{
+    return Add(user_faceprints.user_id, user_faceprints.faceprints);
+}
+
+bool FaceprintsGallery::Add(const char* user_id, const Faceprints& faceprints)
+{
+    if (user_id == nullptr)
+    {
+        LOG_ERROR(LOG_TAG, "Null user id");
+        return false;
+    }
+
+    if (!Matcher::ValidateFaceprints(faceprints))
+    {
+        LOG_ERROR(LOG_TAG, "Invalid faceprints vector range");
+        return false;
+    }
+
+    // index in the in memory arrays, after the mapped users.
+    size_t local_index = _faceprints.size();
+    size_t index = Size();
+    _noMaskVectors.resize((local_index + 1) * VectorLength);
+    _maskVectors.resize((local_index + 1) * VectorLength);
+    _noMaskNorms.emplace_back();
+    _maskNorms.emplace_back();
+    _maskFlags.push_back(0);
+    _versions.push_back(0);
+    _faceprints.push_back(faceprints);
+    _sequences.emplace_back();
+
+    if (_quantizedTier)
+    {
+        _noMaskQuantized.resize((index + 1) * VectorLength);
+        _maskQuantized.resize((index + 1) * VectorLength);
+        _noMaskQuantizedInvNorms.emplace_back();
+        _maskQuantizedInvNorms.emplace_back();
+    }
+
+    _userIds.resize((local_index + 1) * UserIdStride, '\0');
+    char* dst_id = &_userIds[local_index * UserIdStride];
+    ::strncpy(dst_id, user_id, RSID_MAX_USER_ID_LENGTH_IN_DB);
+    dst_id[RSID_MAX_USER_ID_LENGTH_IN_DB] = '\0';
+
+    SetRow(index, faceprints);
+    CountVersion(faceprints.data.version, true);
+    Touch();
+    return true;
+}
+
+bool FaceprintsGallery::Update(size_t index, const Faceprints& faceprints)
+{
+    if (index >= Size())
+    {
+        LOG_ERROR(LOG_TAG, "Invalid user index %zu", index);
+        return false;
+    }
+
+    if (!Matcher::ValidateFaceprints(faceprints))
+    {
+        LOG_ERROR(LOG_TAG, "Invalid faceprints vector range");
+        return false;
+    }
+
+    const int previous_version = Version(index);
+
+    // seqlock write: readers that overlap it see an odd or changed sequence and retry.
+    std::atomic<uint32_t>& sequence = _sequences[index].value;
+    const uint32_t value = sequence.load(std::memory_order_relaxed);
+    sequence.store(value + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    *At(_mapped.faceprints, _faceprints, index) = faceprints;
+    SetRow(index, faceprints);
+
+    sequence.store(value + 2, std::memory_order_release);
+
+    if (faceprints.data.version != previous_version)
+    {
+        CountVersion(previous_version, false);
+        CountVersion(faceprints.data.version, true);
+    }
+
+    // a new run of updates, unless the last change of the gallery was an update of the same user.
+    const uint64_t previous_generation = Generation();
+    if (_updateRunIndex.value.load(std::memory_order_relaxed) != index ||
+        _updateRunGeneration.value.load(std::memory_order_relaxed) != previous_generation)
+    {
+        _updateRunIndex.value.store(index, std::memory_order_relaxed);
+        _updateRunBase.value.store(previous_generation, std::memory_order_relaxed);
+    }
+    Touch();
+    _updateRunGeneration.value.store(Generation(), std::memory_order_release);
+    return true;
+}
+
+uint64_t FaceprintsGallery::UserBaseGeneration(size_t index) const
+{
+    // the run fields are consistent with the generation if it didn't change while they were read.
+    for (;;)
+    {
+        const uint64_t current = Generation();
+        const uint64_t run_generation = _updateRunGeneration.value.load(std::memory_order_acquire);
+        const uint64_t run_index = _updateRunIndex.value.load(std::memory_order_relaxed);
+        const uint64_t run_base = _updateRunBase.value.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (Generation() == current)
+        {
+            return (run_generation == current && run_index == static_cast<uint64_t>(index)) ? run_base : current;
+        }
+    }
+}
+
+bool FaceprintsGallery::OnlyUserUpdatedSince(uint64_t generation, size_t index) const
+{
+    // the run fields are consistent with the generation if it didn't change while they were read.
+    const uint64_t current = Generation();
+    const uint64_t run_generation = _updateRunGeneration.value.load(std::memory_order_acquire);
+    const uint64_t run_index = _updateRunIndex.value.load(std::memory_order_relaxed);
+    const uint64_t run_base = _updateRunBase.value.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (Generation() != current)
+    {
+        return false;
+    }
+
+    return generation == current ||
+           (run_generation == current && run_index == static_cast<uint64_t>(index) && generation == run_base);
+}
+
+bool FaceprintsGallery::Remove(size_t index)
+{
+    if (index >= Size())
+    {
+        LOG_ERROR(LOG_TAG, "Invalid user index %zu", index);
+        return false;
+    }
+
+    CountVersion(Version(index), false);
+
+    const size_t last = Size() - 1;
+    if (index != last)
+    {
+        MoveUser(last, index);
+    }
+
+    // drop the last user: the last in memory user, or the last mapped one if there are no in memory users.
+    if (_faceprints.empty())
+    {
+        _mapped.count--;
+    }
+    else
+    {
+        const size_t local_last = _faceprints.size() - 1;
+        _noMaskVectors.resize(local_last * VectorLength);
+        _maskVectors.resize(local_last * VectorLength);
+        _noMaskNorms.pop_back();
+        _maskNorms.pop_back();
+        _maskFlags.pop_back();
+        _versions.pop_back();
+        _userIds.resize(local_last * UserIdStride);
+        _faceprints.pop_back();
+    }
+    _sequences.pop_back();
+
+    if (_quantizedTier)
+    {
+        _noMaskQuantized.resize(last * VectorLength);
+        _maskQuantized.resize(last * VectorLength);
+        _noMaskQuantizedInvNorms.pop_back();
+        _maskQuantizedInvNorms.pop_back();
+    }
+    Touch();
+    return true;
+}
+
+uint32_t FaceprintsGallery::ReadFaceprints(size_t index, Faceprints& faceprints) const
+{
+    uint32_t sequence;
+    do
+    {
+        sequence = BeginRead(index);
+        ::memcpy(&faceprints, &GetFaceprints(index), sizeof(Faceprints));
+    } while (!EndRead(index, sequence));
+
+    return sequence;
+}
+
+void FaceprintsGallery::Clear()
+{
+    _mapped = MappedUsers();
+    _noMaskVectors.clear();
+    _maskVectors.clear();
+    _noMaskNorms.clear();
+    _maskNorms.clear();
+    _maskFlags.clear();
+    _versions.clear();
+    _userIds.clear();
+    _faceprints.clear();
+    _sequences.clear();
+    _noMaskQuantized.clear();
+    _maskQuantized.clear();
+    _noMaskQuantizedInvNorms.clear();
+    _maskQuantizedInvNorms.clear();
+    _versionCounts.clear();
+    _commonVersion.value.store(NoCommonVersion, std::memory_order_release);
+    Touch();
+}
+
+bool FaceprintsGallery::ValidateUser(size_t index, int version) const
+{
+    if (Version(index) != version)
+    {
+        LOG_ERROR(LOG_TAG, "Mismatch in faceprints versions");
+        return false;
+    }
+
+    if (!Matcher::ValidateFaceprints(GetFaceprints(index)))
+    {
+        LOG_ERROR(LOG_TAG, "Invalid faceprints vector range");
+        return false;
+    }
+
+    return true;
+}
+
+void FaceprintsGallery::AttachMapped(const MappedUsers& mapped)
+{
+    const bool quantized_tier = _quantizedTier;
+
+    Clear();
+    _mapped = mapped;
+    _sequences.resize(mapped.count);
+
+    // the mapped users were validated before they were written to the file. count their versions by runs (usually
+    // a single run).
+    size_t run_begin = 0;
+    while (run_begin < mapped.count)
+    {
+        size_t run_end = run_begin + 1;
+        while (run_end < mapped.count && mapped.versions[run_end] == mapped.versions[run_begin])
+        {
+            run_end++;
+        }
+        _versionCounts[mapped.versions[run_begin]] += run_end - run_begin;
+        run_begin = run_end;
+    }
+    PublishCommonVersion();
+    Touch();
+
+    // rebuild the quantized tier (kept in memory only) for the mapped users.
+    _quantizedTier = false;
+    SetQuantizedTier(quantized_tier);
+}
+
+void FaceprintsGallery::Touch()
+{
+    _generation.value.store(s_lastGeneration.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void FaceprintsGallery::CountVersion(int version, bool add)
+{
+    if (add)
+    {
+        _versionCounts[version]++;
+    }
+    else
+    {
+        auto it = _versionCounts.find(version);
+        if (it != _versionCounts.end() && --it->second == 0)
+        {
+            _versionCounts.erase(it);
+        }
+    }
+
+    PublishCommonVersion();
+}
+
+void FaceprintsGallery::PublishCommonVersion()
+{
+    int64_t common = (_versionCounts.size() == 1) ? _versionCounts.begin()->first : NoCommonVersion;
+    _commonVersion.value.store(common, std::memory_order_release);
+}
+
+void FaceprintsGallery::SetRow(size_t index, const Faceprints& faceprints)
+{
+    const auto& data = faceprints.data;
+    const size_t row_bytes = VectorLength * sizeof(feature_t);
+
+    // same vector selection as the 1:N scan over UserFaceprints_t array (see Matcher::GetScores()).
+    bool mask_valid = (data.adaptiveDescriptorWithMask[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS] == FaVectorFlagsEnum::VecFlagValidWithMask);
+    const feature_t* mask_vector = mask_valid ? &data.adaptiveDescriptorWithMask[0] : &data.adaptiveDescriptorWithoutMask[0];
+
+    feature_t* no_mask_row = At(_mapped.noMaskVectors, _noMaskVectors, index, VectorLength);
+    feature_t* mask_row = At(_mapped.maskVectors, _maskVectors, index, VectorLength);
+    ::memcpy(no_mask_row, &data.adaptiveDescriptorWithoutMask[0], row_bytes);
+    ::memcpy(mask_row, mask_vector, row_bytes);
+    *At(_mapped.noMaskNorms, _noMaskNorms, index) = Matcher::ComputeNccNorm(no_mask_row, VectorLength);
+    *At(_mapped.maskNorms, _maskNorms, index) = Matcher::ComputeNccNorm(mask_row, VectorLength);
+    *At(_mapped.maskFlags, _maskFlags, index) = mask_valid ? 1 : 0;
+    *At(_mapped.versions, _versions, index) = data.version;
+
+    if (_quantizedTier)
+    {
+        SetQuantizedRow(index);
+    }
+}
+
+void FaceprintsGallery::MoveUser(size_t from, size_t to)
+{
+    const size_t row_bytes = VectorLength * sizeof(feature_t);
+
+    // the user at index to is replaced, so its sequence changes (e.g. ConcurrentFaceprintsGallery drops an update of
+    // the removed user that was read at the old sequence).
+    std::atomic<uint32_t>& sequence = _sequences[to].value;
+    const uint32_t value = sequence.load(std::memory_order_relaxed);
+    sequence.store(value + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    ::memcpy(At(_mapped.noMaskVectors, _noMaskVectors, to, VectorLength), ActiveVector(from, false), row_bytes);
+    ::memcpy(At(_mapped.maskVectors, _maskVectors, to, VectorLength), ActiveVector(from, true), row_bytes);
+    *At(_mapped.noMaskNorms, _noMaskNorms, to) = ActiveNorm(from, false);
+    *At(_mapped.maskNorms, _maskNorms, to) = ActiveNorm(from, true);
+    *At(_mapped.maskFlags, _maskFlags, to) = HasValidMaskVector(from) ? 1 : 0;
+    *At(_mapped.versions, _versions, to) = Version(from);
+    ::memcpy(At(_mapped.userIds, _userIds, to, UserIdStride), UserId(from), UserIdStride);
+    *At(_mapped.faceprints, _faceprints, to) = GetFaceprints(from);
+
+    if (_quantizedTier)
+    {
+        ::memcpy(&_noMaskQuantized[to * VectorLength], ActiveQuantizedVector(from, false), VectorLength);
+        ::memcpy(&_maskQuantized[to * VectorLength], ActiveQuantizedVector(from, true), VectorLength);
+        _noMaskQuantizedInvNorms[to] = _noMaskQuantizedInvNorms[from];
+        _maskQuantizedInvNorms[to] = _maskQuantizedInvNorms[from];
+    }
+
+    sequence.store(value + 2, std::memory_order_release);
+}
+
+void FaceprintsGallery::SetQuantizedRow(size_t index)
+{
+    const uint32_t vec_length = static_cast<uint32_t>(VectorLength);
+    const MatcherKernels::DotI8Fn dot_i8 = MatcherKernels::Active(vec_length).dot_i8;
+
+    int8_t* no_mask_row = &_noMaskQuantized[index * VectorLength];
+    int8_t* mask_row = &_maskQuantized[index * VectorLength];
+    MatcherKernels::QuantizeToInt8(ActiveVector(index, false), no_mask_row, vec_length);
+    MatcherKernels::QuantizeToInt8(ActiveVector(index, true), mask_row, vec_length);
+
+    // an all zero row gets inverse norm 0, so it is ranked with coarse score 0.
+    int32_t no_mask_norm = dot_i8(no_mask_row, no_mask_row, vec_length);
+    int32_t mask_norm = dot_i8(mask_row, mask_row, vec_length);
+    _noMaskQuantizedInvNorms[index] = no_mask_norm > 0 ? 1.0f / std::sqrt(static_cast<float>(no_mask_norm)) : 0.0f;
+    _maskQuantizedInvNorms[index] = mask_norm > 0 ? 1.0f / std::sqrt(static_cast<float>(mask_norm)) : 0.0f;
+}
+} // namespace RealSenseID
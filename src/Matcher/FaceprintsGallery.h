@@ -0,0 +1,317 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "AlignedAllocator.h"
+#include "Matcher.h"
+#include "RealSenseID/Faceprints.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+namespace RealSenseID
+{
+class FaceprintsGalleryFile;
+
+// Host side gallery of users, laid out for fast 1:N matching (structure-of-arrays).
+//
+// The 1:N scan only reads one 512 features vector per user, so the vectors it reads are kept in packed,
+// cache line aligned matrices (one row per user):
+//   * no-mask matrix - the adaptive without-mask vector, scanned for probes without mask.
+//   * mask matrix    - the adaptive with-mask vector if valid, else the without-mask one. scanned for probes with mask.
+// User ids, mask flags and versions are kept in separate arrays, and the full faceprints (enrollment vector etc.),
+// only needed for the matched user during adaptive update, are kept in a separate "cold" array.
+//
+// The ncc norm (squared norm + msb) of each row is cached when the row is written (Add/Update), so matching a probe
+// only needs the probe norm once plus one dot product per user.
+//
+// Optionally (SetQuantizedTier()), an int8 quantized copy of both matrices is kept for the coarse search of
+// Matcher::MatchFaceprintsToGalleryCoarseToFine(): half the bytes per row, so the coarse scan streams half the memory
+// of the exact one. Each quantized row caches its inverse l2 norm.
+//
+// A gallery opened from a file (FaceprintsGalleryFile) reads its first users directly from the memory mapped file
+// (no copy, no parsing). Users added later are kept in memory after them, and updates of mapped users are copy on
+// write (private mapping), so the file itself is never modified through the gallery. A copy of the gallery keeps all
+// its users in memory, so it never shares (and updates) the mapped rows of the gallery it was copied from.
+//
+// Each user has a sequence number (seqlock), so Update() can run concurrently with the seqlock readers: the sequence
+// is odd while the user is being written, and readers that saw it odd or changed retry (see BeginRead()/EndRead()).
+// The seqlock readers are the single probe matches (Matcher::MatchFaceprintsToGallery() with or without a cache,
+// MatchFaceprintsToGalleryCoarseToFine(), MatchFaceprintsToIndex()) and ReadFaceprints(). The batch scans
+// (Matcher::MatchBatch(), FindNearDuplicates(), ThresholdSweep, FaceprintsIvfIndex::Train()) read the rows without it,
+// so like Add(), Clear() etc. they are not safe with a concurrent Update() (see ConcurrentFaceprintsGallery), and
+// writers must be serialized.
+//
+// Users are validated (vector range) when added to the gallery, and the gallery tracks whether all its users share the
+// same faceprints version (CommonVersion()). So a scan only validates the probe and checks its version once, instead
+// of checking every user (unless RSID_MATCHER_SCAN_CHECKS is enabled, see ValidateUser()).
+class FaceprintsGallery
+{
+public:
+    static constexpr size_t Alignment = 64;
+    static constexpr size_t VectorLength = RSID_NUM_OF_RECOGNITION_FEATURES;
+    static constexpr size_t UserIdStride = RSID_MAX_USER_ID_LENGTH_IN_DB + 1;
+
+    FaceprintsGallery() = default;
+
+    // the mapped users are copied into the in memory arrays of the copy.
+    FaceprintsGallery(const FaceprintsGallery& other);
+    FaceprintsGallery& operator=(const FaceprintsGallery& other);
+    FaceprintsGallery(FaceprintsGallery&& other) = default;
+    FaceprintsGallery& operator=(FaceprintsGallery&& other) = default;
+
+    // keep (or drop) the int8 quantized copy of the matrices. enabling builds it for the users already in the gallery.
+    void SetQuantizedTier(bool enable);
+
+    bool HasQuantizedTier() const
+    {
+        return _quantizedTier;
+    }
+
+    // reserve room for the given number of users.
+    void Reserve(size_t num_users);
+
+    // add user at the end of the gallery. returns false (and doesn't add) if faceprints failed validation.
+    bool Add(const UserFaceprints_t& user_faceprints);
+    bool Add(const char* user_id, const Faceprints& faceprints);
+
+    // replace the faceprints of the user at given index, e.g. with the updated faceprints after a match
+    // with should_update=true. returns false if index is out of range or faceprints failed validation.
+    // the seqlock readers of the user may run concurrently (seqlock writer), the batch scans may not.
+    bool Update(size_t index, const Faceprints& faceprints);
+
+    // remove the user at given index in O(1): the last user of the gallery is moved to index (swap remove), with its
+    // cached norms and quantized rows, and the sequence of index changes. returns false if index is out of range.
+    // like Add(), not safe with concurrent readers.
+    bool Remove(size_t index);
+
+    void Clear();
+
+    size_t Size() const
+    {
+        return _mapped.count + _faceprints.size();
+    }
+
+    bool Empty() const
+    {
+        return Size() == 0;
+    }
+
+    // number of users read from a memory mapped gallery file (the first users of the gallery).
+    size_t MappedSize() const
+    {
+        return _mapped.count;
+    }
+
+    const char* UserId(size_t index) const
+    {
+        return At(_mapped.userIds, _userIds, index, UserIdStride);
+    }
+
+    const Faceprints& GetFaceprints(size_t index) const
+    {
+        return *At(_mapped.faceprints, _faceprints, index);
+    }
+
+    int Version(size_t index) const
+    {
+        return *At(_mapped.versions, _versions, index);
+    }
+
+    bool HasValidMaskVector(size_t index) const
+    {
+        return *At(_mapped.maskFlags, _maskFlags, index) != 0;
+    }
+
+    // row of the packed matrix scanned for probes with/without mask.
+    const feature_t* ActiveVector(size_t index, bool probe_has_mask) const
+    {
+        return probe_has_mask ? At(_mapped.maskVectors, _maskVectors, index, VectorLength)
+                              : At(_mapped.noMaskVectors, _noMaskVectors, index, VectorLength);
+    }
+
+    // cached ncc norm of ActiveVector(index, probe_has_mask).
+    const NccNorm& ActiveNorm(size_t index, bool probe_has_mask) const
+    {
+        return probe_has_mask ? *At(_mapped.maskNorms, _maskNorms, index) : *At(_mapped.noMaskNorms, _noMaskNorms, index);
+    }
+
+    // the faceprints version of all the users: returns false if the gallery is empty or mixes versions.
+    bool CommonVersion(int& version) const
+    {
+        int64_t common = _commonVersion.value.load(std::memory_order_acquire);
+        version = static_cast<int>(common);
+        return common != NoCommonVersion;
+    }
+
+    // changes on every change of the gallery users (Add, Update, Remove, Clear, opening a file), e.g. to invalidate
+    // results cached for the gallery (MatchResultCache). generations are unique across galleries, and a copy of a
+    // gallery has the generation of the gallery it was copied from.
+    uint64_t Generation() const
+    {
+        return _generation.value.load(std::memory_order_acquire);
+    }
+
+    // whether the only changes of the gallery since the given generation are Update()s of the user at index (e.g. the
+    // adaptive updates of a cached match result's user, see MatchResultCache).
+    bool OnlyUserUpdatedSince(uint64_t generation, size_t index) const;
+
+    // the generation to remember for the user at index with OnlyUserUpdatedSince(): the generation before the last run
+    // of Update()s of the user if the gallery didn't change since, else the current generation.
+    uint64_t UserBaseGeneration(size_t index) const;
+
+    // per user validation (vector range and version), as done by every scan before the gallery kept the users
+    // validated. only used by the scans when RSID_MATCHER_SCAN_CHECKS is enabled.
+    bool ValidateUser(size_t index, int version) const;
+
+    // seqlock read of a user concurrent with Update(): BeginRead() waits until the user isn't being written and returns
+    // its sequence. whatever was read between BeginRead() and EndRead() is consistent only if EndRead() returns true.
+    uint32_t BeginRead(size_t index) const
+    {
+        const std::atomic<uint32_t>& sequence = _sequences[index].value;
+        uint32_t value = sequence.load(std::memory_order_acquire);
+        while (value & 1)
+        {
+            value = sequence.load(std::memory_order_acquire);
+        }
+        return value;
+    }
+
+    bool EndRead(size_t index, uint32_t sequence) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return _sequences[index].value.load(std::memory_order_relaxed) == sequence;
+    }
+
+    // consistent copy of the user faceprints. returns the sequence it was copied at.
+    uint32_t ReadFaceprints(size_t index, Faceprints& faceprints) const;
+
+    // current sequence of the user, changes on every Update().
+    uint32_t Sequence(size_t index) const
+    {
+        return _sequences[index].value.load(std::memory_order_acquire);
+    }
+
+    // int8 quantized ActiveVector(index, probe_has_mask). only valid if HasQuantizedTier().
+    const int8_t* ActiveQuantizedVector(size_t index, bool probe_has_mask) const
+    {
+        return (probe_has_mask ? _maskQuantized.data() : _noMaskQuantized.data()) + index * VectorLength;
+    }
+
+    // 1/||ActiveQuantizedVector(index, probe_has_mask)||. only valid if HasQuantizedTier().
+    float ActiveQuantizedInvNorm(size_t index, bool probe_has_mask) const
+    {
+        return probe_has_mask ? _maskQuantizedInvNorms[index] : _noMaskQuantizedInvNorms[index];
+    }
+
+private:
+    friend class FaceprintsGalleryFile;
+
+    using AlignedFeatures = std::vector<feature_t, AlignedAllocator<feature_t, Alignment>>;
+    using AlignedQuantized = std::vector<int8_t, AlignedAllocator<int8_t, Alignment>>;
+
+    // arrays of the users read from a memory mapped gallery file. the mapping is private (copy on write), so mapped
+    // users can be updated in place.
+    struct MappedUsers
+    {
+        std::shared_ptr<void> mapping; // keeps the file mapped
+        size_t count = 0;
+        feature_t* noMaskVectors = nullptr;
+        feature_t* maskVectors = nullptr;
+        NccNorm* noMaskNorms = nullptr;
+        NccNorm* maskNorms = nullptr;
+        uint8_t* maskFlags = nullptr;
+        int* versions = nullptr;
+        char* userIds = nullptr;
+        Faceprints* faceprints = nullptr;
+    };
+
+    // copyable atomic, so the gallery (and its sequences) can be copied.
+    template <typename T>
+    struct CopyableAtomic
+    {
+        std::atomic<T> value;
+
+        explicit CopyableAtomic(T initial = T()) : value(initial)
+        {
+        }
+        CopyableAtomic(const CopyableAtomic& other) : value(other.value.load(std::memory_order_relaxed))
+        {
+        }
+        CopyableAtomic& operator=(const CopyableAtomic& other)
+        {
+            value.store(other.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            return *this;
+        }
+    };
+
+    using UserSequence = CopyableAtomic<uint32_t>;
+
+    static constexpr int64_t NoCommonVersion = INT64_MIN;
+
+    // element of the user at given index: in the mapped arrays for the first _mapped.count users, else in the
+    // in memory arrays.
+    template <typename T, typename Owned>
+    const T* At(const T* mapped, const Owned& owned, size_t index, size_t stride = 1) const
+    {
+        return index < _mapped.count ? mapped + index * stride : owned.data() + (index - _mapped.count) * stride;
+    }
+
+    template <typename T, typename Owned>
+    T* At(T* mapped, Owned& owned, size_t index, size_t stride = 1)
+    {
+        return index < _mapped.count ? mapped + index * stride : owned.data() + (index - _mapped.count) * stride;
+    }
+
+    // replace all users with the given mapped users (see FaceprintsGalleryFile::Open()).
+    void AttachMapped(const MappedUsers& mapped);
+
+    void SetRow(size_t index, const Faceprints& faceprints);
+    void SetQuantizedRow(size_t index);
+
+    // copy all the data of user from (row, norms, quantized row etc.) over user to.
+    void MoveUser(size_t from, size_t to);
+
+    // give the gallery a new generation.
+    void Touch();
+
+    // count a user in (or out of) its version, and publish the common version.
+    void CountVersion(int version, bool add);
+    void PublishCommonVersion();
+
+    MappedUsers _mapped;
+
+    AlignedFeatures _noMaskVectors;
+    AlignedFeatures _maskVectors;
+    std::vector<NccNorm> _noMaskNorms;
+    std::vector<NccNorm> _maskNorms;
+    std::vector<uint8_t> _maskFlags;
+    std::vector<int> _versions;
+    std::vector<char> _userIds;
+    std::vector<Faceprints> _faceprints;
+
+    // per user (mapped users included).
+    std::vector<UserSequence> _sequences;
+
+    // number of users of each faceprints version (writers only), and the version of all users if there's one
+    // (read by the scans, concurrently with Update()).
+    std::map<int, size_t> _versionCounts;
+    CopyableAtomic<int64_t> _commonVersion {NoCommonVersion};
+    CopyableAtomic<uint64_t> _generation {0};
+
+    // the last run of Update()s of a single user, with nothing else changed in between: the user index, the
+    // generation before the run and the generation after its last update (see OnlyUserUpdatedSince()).
+    CopyableAtomic<uint64_t> _updateRunIndex {UINT64_MAX};
+    CopyableAtomic<uint64_t> _updateRunBase {0};
+    CopyableAtomic<uint64_t> _updateRunGeneration {0};
+
+    bool _quantizedTier = false;
+    AlignedQuantized _noMaskQuantized;
+    AlignedQuantized _maskQuantized;
+    std::vector<float> _noMaskQuantizedInvNorms;
+    std::vector<float> _maskQuantizedInvNorms;
+};
+} // namespace RealSenseID
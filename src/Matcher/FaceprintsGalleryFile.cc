@@ -0,0 +1,674 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FaceprintsGalleryFile.h"
+#include "PacketManager/Crc16.h"
+#include "Logger.h"
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "FaceprintsGalleryFile";
+
+namespace
+{
+const char GalleryFileMagic[8] = {'R', 'S', 'I', 'D', 'G', 'A', 'L', 'Y'};
+const uint32_t GalleryFileFormatVersion = 3; // 2: ncc norms with reciprocals, 3: wal sequence numbers
+const uint32_t GalleryFileByteOrder = 0x01020304;
+
+const uint32_t WalRecordMagic = 0x4C415752; // "RWAL"
+const uint32_t WalRecordAdd = 1;
+const uint32_t WalRecordUpdate = 2;
+const uint32_t WalRecordRemove = 3;
+
+enum GallerySection
+{
+    SectionNoMaskVectors = 0,
+    SectionMaskVectors,
+    SectionNoMaskNorms,
+    SectionMaskNorms,
+    SectionMaskFlags,
+    SectionVersions,
+    SectionUserIds,
+    SectionFaceprints,
+    NumGallerySections
+};
+
+struct GalleryFileHeader
+{
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t byteOrder;
+    uint64_t numUsers;
+    uint32_t vectorLength;
+    uint32_t userIdStride;
+    uint32_t nccNormSize;
+    uint32_t faceprintsSize;
+    uint64_t offsets[NumGallerySections];
+    uint64_t fileSize;
+    uint64_t walSequence; // sequence of the last WAL record included in the snapshot
+};
+
+struct WalRecord
+{
+    uint32_t magic;
+    uint32_t type;
+    uint64_t sequence;
+    uint64_t index;
+    char userId[FaceprintsGallery::UserIdStride];
+    Faceprints faceprints;
+    uint16_t crc;
+};
+
+static_assert(std::is_trivially_copyable<Faceprints>::value, "faceprints are stored as raw bytes");
+static_assert(std::is_trivially_copyable<NccNorm>::value, "ncc norms are stored as raw bytes");
+
+size_t AlignUp(size_t offset)
+{
+    const size_t alignment = FaceprintsGallery::Alignment;
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// size in bytes of each section for the given number of users.
+void SectionSizes(size_t num_users, size_t sizes[NumGallerySections])
+{
+    sizes[SectionNoMaskVectors] = num_users * FaceprintsGallery::VectorLength * sizeof(feature_t);
+    sizes[SectionMaskVectors] = num_users * FaceprintsGallery::VectorLength * sizeof(feature_t);
+    sizes[SectionNoMaskNorms] = num_users * sizeof(NccNorm);
+    sizes[SectionMaskNorms] = num_users * sizeof(NccNorm);
+    sizes[SectionMaskFlags] = num_users * sizeof(uint8_t);
+    sizes[SectionVersions] = num_users * sizeof(int);
+    sizes[SectionUserIds] = num_users * FaceprintsGallery::UserIdStride;
+    sizes[SectionFaceprints] = num_users * sizeof(Faceprints);
+}
+
+// bytes per user of all the sections together.
+size_t UserBytes()
+{
+    size_t sizes[NumGallerySections];
+    SectionSizes(1, sizes);
+    size_t total = 0;
+    for (size_t size : sizes)
+    {
+        total += size;
+    }
+    return total;
+}
+
+bool SameNorm(const NccNorm& a, const NccNorm& b)
+{
+    return a.norm == b.norm && a.magic == b.magic && a.msb == b.msb && a.shift1 == b.shift1 && a.shift2 == b.shift2;
+}
+
+// a mapped user is what FaceprintsGallery::SetRow() writes for its faceprints: valid faceprints, the rows selected
+// from them and their norms.
+bool ValidateMappedUser(const FaceprintsGallery& gallery, size_t index)
+{
+    const auto& data = gallery.GetFaceprints(index).data;
+    if (!Matcher::ValidateFaceprints(gallery.GetFaceprints(index)) || gallery.Version(index) != data.version)
+    {
+        return false;
+    }
+
+    bool mask_valid = (data.adaptiveDescriptorWithMask[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS] == FaVectorFlagsEnum::VecFlagValidWithMask);
+    const feature_t* mask_vector = mask_valid ? &data.adaptiveDescriptorWithMask[0] : &data.adaptiveDescriptorWithoutMask[0];
+    const feature_t* no_mask_row = gallery.ActiveVector(index, false);
+    const feature_t* mask_row = gallery.ActiveVector(index, true);
+    const size_t row_bytes = FaceprintsGallery::VectorLength * sizeof(feature_t);
+    return gallery.HasValidMaskVector(index) == mask_valid && ::memcmp(no_mask_row, &data.adaptiveDescriptorWithoutMask[0], row_bytes) == 0 &&
+           ::memcmp(mask_row, mask_vector, row_bytes) == 0 && SameNorm(gallery.ActiveNorm(index, false), Matcher::ComputeNccNorm(no_mask_row)) &&
+           SameNorm(gallery.ActiveNorm(index, true), Matcher::ComputeNccNorm(mask_row));
+}
+
+// crc of the record bytes before the crc field (the records are zeroed before filled, so padding is deterministic).
+uint16_t WalRecordCrc(const WalRecord& record)
+{
+    return PacketManager::Crc16(reinterpret_cast<const char*>(&record), offsetof(WalRecord, crc));
+}
+
+bool SyncFile(std::FILE* file)
+{
+    if (std::fflush(file) != 0)
+    {
+        return false;
+    }
+#ifdef _WIN32
+    return ::_commit(::_fileno(file)) == 0;
+#else
+    return ::fsync(::fileno(file)) == 0;
+#endif
+}
+
+bool RenameOverFile(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+    return ::MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+bool TruncateFile(const std::string& path, size_t size)
+{
+#ifdef _WIN32
+    std::FILE* file = std::fopen(path.c_str(), "r+b");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    bool ok = ::_chsize_s(::_fileno(file), static_cast<__int64>(size)) == 0;
+    std::fclose(file);
+    return ok;
+#else
+    return ::truncate(path.c_str(), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+// map the whole file, private (copy on write) so the mapped memory can be modified without modifying the file.
+std::shared_ptr<void> MapFile(const std::string& path, size_t& size)
+{
+    size = 0;
+#ifdef _WIN32
+    HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return nullptr;
+    }
+
+    LARGE_INTEGER file_size;
+    HANDLE mapping = nullptr;
+    void* view = nullptr;
+    if (::GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+    {
+        mapping = ::CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    }
+    if (mapping != nullptr)
+    {
+        view = ::MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        ::CloseHandle(mapping);
+    }
+    ::CloseHandle(file);
+
+    if (view == nullptr)
+    {
+        return nullptr;
+    }
+
+    size = static_cast<size_t>(file_size.QuadPart);
+    return std::shared_ptr<void>(view, [](void* p) { ::UnmapViewOfFile(p); });
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+
+    struct stat file_stat;
+    void* view = MAP_FAILED;
+    if (::fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+        view = ::mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+
+    if (view == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    size_t mapped_size = static_cast<size_t>(file_stat.st_size);
+    size = mapped_size;
+    return std::shared_ptr<void>(view, [mapped_size](void* p) { ::munmap(p, mapped_size); });
+#endif
+}
+
+bool FileExists(const std::string& path)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    std::fclose(file);
+    return true;
+}
+
+bool WritePadding(std::FILE* file, size_t from, size_t to)
+{
+    static const char zeros[FaceprintsGallery::Alignment] = {};
+    return to == from || std::fwrite(zeros, 1, to - from, file) == to - from;
+}
+} // namespace
+
+FaceprintsGalleryFile::FaceprintsGalleryFile(const std::string& path) : _path(path), _walPath(path + ".wal")
+{
+}
+
+FaceprintsGalleryFile::~FaceprintsGalleryFile()
+{
+    CloseWal();
+}
+
+bool FaceprintsGalleryFile::Open(FaceprintsGallery& gallery, bool validate_users)
+{
+    CloseWal();
+    gallery.Clear();
+    _walSequence = 0;
+
+    if (FileExists(_path))
+    {
+        size_t file_size = 0;
+        std::shared_ptr<void> mapping = MapFile(_path, file_size);
+        if (!mapping)
+        {
+            LOG_ERROR(LOG_TAG, "Failed to map gallery file %s", _path.c_str());
+            return false;
+        }
+
+        if (file_size < sizeof(GalleryFileHeader))
+        {
+            LOG_ERROR(LOG_TAG, "Gallery file %s is too small", _path.c_str());
+            return false;
+        }
+
+        GalleryFileHeader header;
+        ::memcpy(&header, mapping.get(), sizeof(header));
+        if (::memcmp(header.magic, GalleryFileMagic, sizeof(GalleryFileMagic)) != 0 || header.formatVersion != GalleryFileFormatVersion ||
+            header.byteOrder != GalleryFileByteOrder)
+        {
+            LOG_ERROR(LOG_TAG, "Gallery file %s: unsupported format", _path.c_str());
+            return false;
+        }
+
+        if (header.vectorLength != FaceprintsGallery::VectorLength || header.userIdStride != FaceprintsGallery::UserIdStride ||
+            header.nccNormSize != sizeof(NccNorm) || header.faceprintsSize != sizeof(Faceprints) || header.fileSize != file_size)
+        {
+            LOG_ERROR(LOG_TAG, "Gallery file %s: layout mismatch", _path.c_str());
+            return false;
+        }
+
+        // bound the number of users by the file size before the section sizes are computed from it, so they can't
+        // overflow.
+        if (header.numUsers > file_size / UserBytes())
+        {
+            LOG_ERROR(LOG_TAG, "Gallery file %s: invalid number of users", _path.c_str());
+            return false;
+        }
+
+        size_t sizes[NumGallerySections];
+        SectionSizes(static_cast<size_t>(header.numUsers), sizes);
+        for (int section = 0; section < NumGallerySections; section++)
+        {
+            uint64_t offset = header.offsets[section];
+            if (offset % FaceprintsGallery::Alignment != 0 || offset > file_size || sizes[section] > file_size - offset)
+            {
+                LOG_ERROR(LOG_TAG, "Gallery file %s: invalid section %d", _path.c_str(), section);
+                return false;
+            }
+        }
+
+        char* base = static_cast<char*>(mapping.get());
+        FaceprintsGallery::MappedUsers mapped;
+        mapped.mapping = mapping;
+        mapped.count = static_cast<size_t>(header.numUsers);
+        mapped.noMaskVectors = reinterpret_cast<feature_t*>(base + header.offsets[SectionNoMaskVectors]);
+        mapped.maskVectors = reinterpret_cast<feature_t*>(base + header.offsets[SectionMaskVectors]);
+        mapped.noMaskNorms = reinterpret_cast<NccNorm*>(base + header.offsets[SectionNoMaskNorms]);
+        mapped.maskNorms = reinterpret_cast<NccNorm*>(base + header.offsets[SectionMaskNorms]);
+        mapped.maskFlags = reinterpret_cast<uint8_t*>(base + header.offsets[SectionMaskFlags]);
+        mapped.versions = reinterpret_cast<int*>(base + header.offsets[SectionVersions]);
+        mapped.userIds = base + header.offsets[SectionUserIds];
+        mapped.faceprints = reinterpret_cast<Faceprints*>(base + header.offsets[SectionFaceprints]);
+
+        // always (no vector pass): the user ids are NUL terminated, and the cached norms are ones MakeNccNorm() makes,
+        // as the scans divide by them. only read, so the pages stay shared with the other processes.
+        for (size_t i = 0; i < mapped.count; i++)
+        {
+            if (::memchr(mapped.userIds + i * FaceprintsGallery::UserIdStride, '\0', FaceprintsGallery::UserIdStride) == nullptr)
+            {
+                LOG_ERROR(LOG_TAG, "Gallery file %s: user %zu has an invalid user id", _path.c_str(), i);
+                return false;
+            }
+
+            const NccNorm& no_mask_norm = mapped.noMaskNorms[i];
+            const NccNorm& mask_norm = mapped.maskNorms[i];
+            if (!SameNorm(no_mask_norm, Matcher::MakeNccNorm(no_mask_norm.norm)) || !SameNorm(mask_norm, Matcher::MakeNccNorm(mask_norm.norm)))
+            {
+                LOG_ERROR(LOG_TAG, "Gallery file %s: user %zu has invalid norms", _path.c_str(), i);
+                return false;
+            }
+        }
+
+        gallery.AttachMapped(mapped);
+
+        if (validate_users)
+        {
+            for (size_t i = 0; i < gallery.Size(); i++)
+            {
+                if (!ValidateMappedUser(gallery, i))
+                {
+                    LOG_ERROR(LOG_TAG, "Gallery file %s: user %zu failed validation", _path.c_str(), i);
+                    gallery.Clear();
+                    return false;
+                }
+            }
+        }
+
+        _walSequence = header.walSequence;
+    }
+
+    if (!ReplayWal(gallery))
+    {
+        gallery.Clear();
+        return false;
+    }
+
+    LOG_DEBUG(LOG_TAG, "Opened %s: %zu mapped users, %zu users in total", _path.c_str(), gallery.MappedSize(), gallery.Size());
+    return OpenWal("ab");
+}
+
+bool FaceprintsGalleryFile::Add(FaceprintsGallery& gallery, const char* user_id, const Faceprints& faceprints)
+{
+    if (user_id == nullptr || !Matcher::ValidateFaceprints(faceprints))
+    {
+        LOG_ERROR(LOG_TAG, "Invalid user");
+        return false;
+    }
+
+    if (!AppendWal(WalRecordAdd, gallery.Size(), user_id, faceprints))
+    {
+        return false;
+    }
+
+    return gallery.Add(user_id, faceprints);
+}
+
+bool FaceprintsGalleryFile::Update(FaceprintsGallery& gallery, size_t index, const Faceprints& faceprints)
+{
+    if (index >= gallery.Size() || !Matcher::ValidateFaceprints(faceprints))
+    {
+        LOG_ERROR(LOG_TAG, "Invalid user index %zu or faceprints", index);
+        return false;
+    }
+
+    if (!AppendWal(WalRecordUpdate, index, gallery.UserId(index), faceprints))
+    {
+        return false;
+    }
+
+    return gallery.Update(index, faceprints);
+}
+
+bool FaceprintsGalleryFile::Remove(FaceprintsGallery& gallery, size_t index)
+{
+    if (index >= gallery.Size())
+    {
+        LOG_ERROR(LOG_TAG, "Invalid user index %zu", index);
+        return false;
+    }
+
+    if (!AppendWal(WalRecordRemove, index, gallery.UserId(index), Faceprints()))
+    {
+        return false;
+    }
+
+    return gallery.Remove(index);
+}
+
+bool FaceprintsGalleryFile::Checkpoint(const FaceprintsGallery& gallery)
+{
+    const std::string tmp_path = _path + ".tmp";
+    const size_t num_users = gallery.Size();
+
+    GalleryFileHeader header;
+    ::memset(&header, 0, sizeof(header));
+    ::memcpy(header.magic, GalleryFileMagic, sizeof(GalleryFileMagic));
+    header.formatVersion = GalleryFileFormatVersion;
+    header.byteOrder = GalleryFileByteOrder;
+    header.numUsers = num_users;
+    header.vectorLength = static_cast<uint32_t>(FaceprintsGallery::VectorLength);
+    header.userIdStride = static_cast<uint32_t>(FaceprintsGallery::UserIdStride);
+    header.nccNormSize = sizeof(NccNorm);
+    header.faceprintsSize = sizeof(Faceprints);
+    header.walSequence = _walSequence;
+
+    size_t sizes[NumGallerySections];
+    SectionSizes(num_users, sizes);
+    size_t offset = AlignUp(sizeof(header));
+    for (int section = 0; section < NumGallerySections; section++)
+    {
+        header.offsets[section] = offset;
+        offset = AlignUp(offset + sizes[section]);
+    }
+    header.fileSize = offset;
+
+    std::FILE* file = std::fopen(tmp_path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to create %s", tmp_path.c_str());
+        return false;
+    }
+
+    const size_t row_bytes = FaceprintsGallery::VectorLength * sizeof(feature_t);
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    size_t position = sizeof(header);
+    for (int section = 0; section < NumGallerySections && ok; section++)
+    {
+        ok = WritePadding(file, position, static_cast<size_t>(header.offsets[section]));
+        for (size_t i = 0; i < num_users && ok; i++)
+        {
+            switch (section)
+            {
+            case SectionNoMaskVectors:
+                ok = std::fwrite(gallery.ActiveVector(i, false), row_bytes, 1, file) == 1;
+                break;
+            case SectionMaskVectors:
+                ok = std::fwrite(gallery.ActiveVector(i, true), row_bytes, 1, file) == 1;
+                break;
+            case SectionNoMaskNorms:
+                ok = std::fwrite(&gallery.ActiveNorm(i, false), sizeof(NccNorm), 1, file) == 1;
+                break;
+            case SectionMaskNorms:
+                ok = std::fwrite(&gallery.ActiveNorm(i, true), sizeof(NccNorm), 1, file) == 1;
+                break;
+            case SectionMaskFlags: {
+                uint8_t flag = gallery.HasValidMaskVector(i) ? 1 : 0;
+                ok = std::fwrite(&flag, sizeof(flag), 1, file) == 1;
+                break;
+            }
+            case SectionVersions: {
+                int version = gallery.Version(i);
+                ok = std::fwrite(&version, sizeof(version), 1, file) == 1;
+                break;
+            }
+            case SectionUserIds:
+                ok = std::fwrite(gallery.UserId(i), FaceprintsGallery::UserIdStride, 1, file) == 1;
+                break;
+            case SectionFaceprints:
+                ok = std::fwrite(&gallery.GetFaceprints(i), sizeof(Faceprints), 1, file) == 1;
+                break;
+            default:
+                break;
+            }
+        }
+        position = static_cast<size_t>(header.offsets[section]) + sizes[section];
+    }
+    ok = ok && WritePadding(file, position, static_cast<size_t>(header.fileSize)) && SyncFile(file);
+    ok = (std::fclose(file) == 0) && ok;
+
+    if (!ok || !RenameOverFile(tmp_path, _path))
+    {
+        LOG_ERROR(LOG_TAG, "Failed to write snapshot %s", _path.c_str());
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    // the snapshot now has all the changes, so the WAL can be emptied. if we crash before that, replaying the WAL on
+    // top of the new snapshot is harmless (see ReplayWal()).
+    CloseWal();
+    return OpenWal("wb");
+}
+
+// records are applied in order. records up to the snapshot sequence come from a checkpoint that crashed before
+// emptying the WAL, and are skipped. the other records must follow each other and apply to the gallery as it is at
+// that point (Update and Remove records also check the user id of the index), else the WAL doesn't belong to the
+// snapshot.
+bool FaceprintsGalleryFile::ReplayWal(FaceprintsGallery& gallery)
+{
+    std::FILE* file = std::fopen(_walPath.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return true;
+    }
+
+    const uint64_t snapshot_sequence = _walSequence;
+    WalRecord record;
+    size_t good_bytes = 0;
+    size_t num_records = 0;
+    bool ok = true;
+    bool torn = false;
+
+    while (ok)
+    {
+        size_t read = std::fread(&record, 1, sizeof(record), file);
+        if (read == 0)
+        {
+            break;
+        }
+        if (read != sizeof(record) || record.magic != WalRecordMagic || record.crc != WalRecordCrc(record))
+        {
+            torn = true;
+            break;
+        }
+
+        record.userId[FaceprintsGallery::UserIdStride - 1] = '\0';
+        size_t index = static_cast<size_t>(record.index);
+        if (record.sequence <= snapshot_sequence)
+        {
+            // already in the snapshot
+        }
+        else if (record.sequence != _walSequence + 1)
+        {
+            ok = false;
+        }
+        else if (record.type == WalRecordAdd && index == gallery.Size())
+        {
+            ok = gallery.Add(record.userId, record.faceprints);
+        }
+        else if (record.type == WalRecordUpdate && index < gallery.Size() &&
+                 ::strncmp(gallery.UserId(index), record.userId, FaceprintsGallery::UserIdStride) == 0)
+        {
+            ok = gallery.Update(index, record.faceprints);
+        }
+        else if (record.type == WalRecordRemove && index < gallery.Size() &&
+                 ::strncmp(gallery.UserId(index), record.userId, FaceprintsGallery::UserIdStride) == 0)
+        {
+            ok = gallery.Remove(index);
+        }
+        else
+        {
+            ok = false;
+        }
+
+        if (ok && record.sequence > snapshot_sequence)
+        {
+            _walSequence = record.sequence;
+        }
+
+        if (!ok)
+        {
+            LOG_ERROR(LOG_TAG, "WAL %s: record %zu can't be applied", _walPath.c_str(), num_records);
+        }
+
+        good_bytes += sizeof(record);
+        num_records++;
+    }
+    std::fclose(file);
+
+    // drop the torn record, so the next appends follow the last good record.
+    if (ok && torn)
+    {
+        LOG_ERROR(LOG_TAG, "WAL %s: ignoring torn record after %zu records", _walPath.c_str(), num_records);
+        ok = TruncateFile(_walPath, good_bytes);
+    }
+
+    LOG_DEBUG(LOG_TAG, "Replayed %zu WAL records", num_records);
+    return ok;
+}
+
+bool FaceprintsGalleryFile::AppendWal(uint32_t type, size_t index, const char* user_id, const Faceprints& faceprints)
+{
+    if (_wal == nullptr)
+    {
+        LOG_ERROR(LOG_TAG, "Gallery file is not open");
+        return false;
+    }
+
+    WalRecord record;
+    ::memset(&record, 0, sizeof(record));
+    record.magic = WalRecordMagic;
+    record.type = type;
+    record.sequence = _walSequence + 1;
+    record.index = index;
+    ::strncpy(record.userId, user_id, RSID_MAX_USER_ID_LENGTH_IN_DB);
+    record.faceprints = faceprints;
+    record.crc = WalRecordCrc(record);
+
+    const long position = (std::fseek(_wal, 0, SEEK_END) == 0) ? std::ftell(_wal) : -1;
+    if (position < 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to seek WAL %s", _walPath.c_str());
+        return false;
+    }
+
+    if (std::fwrite(&record, sizeof(record), 1, _wal) != 1 || !SyncFile(_wal))
+    {
+        // the operation fails, so drop whatever part of the record was buffered or written: else its sequence would
+        // be reused by the next record (and replay would fail), or the failed operation replayed. if the WAL can't be
+        // cut back, no more records are appended until Checkpoint() empties it.
+        LOG_ERROR(LOG_TAG, "Failed to write WAL %s", _walPath.c_str());
+        CloseWal();
+        if (TruncateFile(_walPath, static_cast<size_t>(position)))
+        {
+            OpenWal("ab");
+        }
+        return false;
+    }
+
+    _walSequence++;
+    return true;
+}
+
+bool FaceprintsGalleryFile::OpenWal(const char* mode)
+{
+    _wal = std::fopen(_walPath.c_str(), mode);
+    if (_wal == nullptr)
+    {
+        LOG_ERROR(LOG_TAG, "Failed to open WAL %s", _walPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void FaceprintsGalleryFile::CloseWal()
+{
+    if (_wal != nullptr)
+    {
+        std::fclose(_wal);
+        _wal = nullptr;
+    }
+}
+} // namespace RealSenseID
@@ -0,0 +1,69 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include <cstdio>
+#include <string>
+
+namespace RealSenseID
+{
+// On disk FaceprintsGallery: a versioned binary snapshot file plus a write-ahead log (WAL) of the changes made since.
+//
+// The snapshot holds the gallery arrays exactly as laid out in memory (packed cache line aligned matrices, cached
+// norms, flags, versions, user ids and faceprints), each array at a 64 bytes aligned offset. Open() maps it and the
+// gallery reads the mapped arrays directly - no parsing or copying, so even a large gallery opens in milliseconds,
+// and the mapped pages are shared by all the processes that open the same snapshot.
+// The snapshot is written in the host layout (endianness, struct sizes), which the header records and Open() checks.
+//
+// Add(), Update() and Remove() first append a record to the WAL ("<path>.wal", flushed to disk) and then apply it to
+// the gallery. Open() replays the WAL on top of the snapshot, so no acknowledged change is lost. A torn record at the
+// end of the WAL (crash during append) fails its crc and is ignored. Checkpoint() writes a new snapshot of the gallery
+// (to a temporary file renamed over the snapshot) and empties the WAL. WAL records are numbered, and the snapshot
+// records the number of the last record it includes, so replay skips exactly the records already in the snapshot.
+//
+// A missing snapshot is an empty gallery, so a new gallery file is created by Open() followed by Add()s.
+class FaceprintsGalleryFile
+{
+public:
+    explicit FaceprintsGalleryFile(const std::string& path);
+    ~FaceprintsGalleryFile();
+
+    FaceprintsGalleryFile(const FaceprintsGalleryFile&) = delete;
+    FaceprintsGalleryFile& operator=(const FaceprintsGalleryFile&) = delete;
+
+    // map the snapshot into gallery (replacing its users) and replay the WAL.
+    // the user ids and cached norms of the mapped users are always checked. validate_users also checks the faceprints,
+    // rows and norms of every user are consistent and in range - a full pass over the file, so a trusted snapshot
+    // (e.g. just written by Checkpoint()) may skip it.
+    bool Open(FaceprintsGallery& gallery, bool validate_users = true);
+
+    // logged gallery changes. return false if faceprints failed validation, or the WAL write failed (then the gallery
+    // isn't changed and the partial record is cut from the WAL - if that fails too, the changes fail until
+    // Checkpoint()).
+    bool Add(FaceprintsGallery& gallery, const char* user_id, const Faceprints& faceprints);
+    bool Update(FaceprintsGallery& gallery, size_t index, const Faceprints& faceprints);
+    bool Remove(FaceprintsGallery& gallery, size_t index);
+
+    // write the gallery (with all the changes logged so far) as the new snapshot and empty the WAL.
+    // on windows the snapshot can't be replaced while it's mapped, so checkpoint a gallery that isn't opened from it.
+    bool Checkpoint(const FaceprintsGallery& gallery);
+
+    const std::string& Path() const
+    {
+        return _path;
+    }
+
+private:
+    bool ReplayWal(FaceprintsGallery& gallery);
+    bool AppendWal(uint32_t type, size_t index, const char* user_id, const Faceprints& faceprints);
+    bool OpenWal(const char* mode);
+    void CloseWal();
+
+    std::string _path;
+    std::string _walPath;
+    std::FILE* _wal = nullptr;
+    uint64_t _walSequence = 0; // last logged (or replayed) WAL record
+};
+} // namespace RealSenseID
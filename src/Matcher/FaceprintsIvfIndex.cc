@@ -0,0 +1,379 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "FaceprintsIvfIndex.h"
+#include "MatcherKernels.h"
+#include "Logger.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "FaceprintsIvfIndex";
+
+static inline void PrefetchRow(const feature_t* row)
+{
+    const char* bytes = reinterpret_cast<const char*>(row);
+    for (size_t offset = 0; offset < FaceprintsGallery::VectorLength * sizeof(feature_t); offset += FaceprintsGallery::Alignment)
+    {
+#if defined(_MSC_VER)
+        _mm_prefetch(bytes + offset, _MM_HINT_T0);
+#else
+        __builtin_prefetch(bytes + offset);
+#endif
+    }
+}
+
+FaceprintsIvfIndex::FaceprintsIvfIndex(size_t num_lists) : _numLists(std::max<size_t>(1, num_lists))
+{
+}
+
+bool FaceprintsIvfIndex::Train(const FaceprintsGallery& gallery, unsigned int iterations)
+{
+    const size_t vec_length = FaceprintsGallery::VectorLength;
+    const size_t num_users = gallery.Size();
+
+    Clear();
+
+    if (num_users == 0)
+    {
+        LOG_ERROR(LOG_TAG, "Can't train on empty gallery.");
+        return false;
+    }
+
+    // fixed seed, so the same gallery always gives the same index.
+    std::mt19937 rng(RSID_MATCHER_IVF_TRAIN_SEED);
+    std::vector<uint32_t> sample(num_users);
+    std::iota(sample.begin(), sample.end(), 0);
+    std::shuffle(sample.begin(), sample.end(), rng);
+    sample.resize(std::min(num_users, _numLists * RSID_MATCHER_IVF_TRAIN_SAMPLES_PER_LIST));
+
+    const size_t num_lists = std::min(_numLists, sample.size());
+    _centroids.resize(_numLists * vec_length);
+    _centroidNorms.resize(_numLists);
+
+    // initial centroids are distinct random users. with less users than lists, the remaining lists stay empty.
+    std::vector<int64_t> sums(vec_length);
+    for (size_t list = 0; list < _numLists; list++)
+    {
+        const feature_t* vec = gallery.ActiveVector(sample[list % num_lists], false);
+        std::copy(vec, vec + vec_length, sums.begin());
+        SetCentroid(list, sums.data(), 1);
+    }
+
+    std::vector<NccNorm> sampleNorms(sample.size());
+    for (size_t i = 0; i < sample.size(); i++)
+    {
+        sampleNorms[i] = gallery.ActiveNorm(sample[i], false);
+    }
+
+    std::vector<uint32_t> assignment(sample.size(), NotIndexed);
+    std::vector<int64_t> listSums(_numLists * vec_length);
+    std::vector<uint32_t> listCounts(_numLists);
+
+    for (unsigned int iteration = 0; iteration < iterations; iteration++)
+    {
+        bool changed = false;
+        for (size_t i = 0; i < sample.size(); i++)
+        {
+            uint32_t list = NearestList(gallery.ActiveVector(sample[i], false), sampleNorms[i]);
+            changed = changed || (list != assignment[i]);
+            assignment[i] = list;
+        }
+
+        if (!changed)
+        {
+            break;
+        }
+
+        std::fill(listSums.begin(), listSums.end(), 0);
+        std::fill(listCounts.begin(), listCounts.end(), 0);
+        for (size_t i = 0; i < sample.size(); i++)
+        {
+            const feature_t* vec = gallery.ActiveVector(sample[i], false);
+            int64_t* listSum = &listSums[assignment[i] * vec_length];
+            for (size_t j = 0; j < vec_length; j++)
+            {
+                listSum[j] += vec[j];
+            }
+            listCounts[assignment[i]]++;
+        }
+
+        for (size_t list = 0; list < _numLists; list++)
+        {
+            // an empty list is re-seeded with a random sampled user.
+            if (listCounts[list] == 0)
+            {
+                const feature_t* vec = gallery.ActiveVector(sample[rng() % sample.size()], false);
+                std::copy(vec, vec + vec_length, sums.begin());
+                SetCentroid(list, sums.data(), 1);
+                continue;
+            }
+            SetCentroid(list, &listSums[list * vec_length], listCounts[list]);
+        }
+    }
+
+    _lists.resize(_numLists);
+    for (size_t i = 0; i < num_users; i++)
+    {
+        Insert(gallery, i);
+    }
+
+    LOG_DEBUG(LOG_TAG, "Trained %zu lists on %zu sampled users, indexed %zu users.", _numLists, sample.size(), _size);
+    return true;
+}
+
+bool FaceprintsIvfIndex::Insert(const FaceprintsGallery& gallery, size_t index)
+{
+    if (!IsTrained())
+    {
+        LOG_ERROR(LOG_TAG, "Index is not trained");
+        return false;
+    }
+
+    if (index >= gallery.Size())
+    {
+        LOG_ERROR(LOG_TAG, "Invalid user index %zu", index);
+        return false;
+    }
+
+    if (index < _userList.size() && _userList[index] != NotIndexed)
+    {
+        Remove(index);
+    }
+
+    if (index >= _userList.size())
+    {
+        _userList.resize(index + 1, NotIndexed);
+        _userPosition.resize(index + 1, 0);
+    }
+
+    uint32_t list = NearestList(gallery.ActiveVector(index, false), gallery.ActiveNorm(index, false));
+    _userList[index] = list;
+    _userPosition[index] = static_cast<uint32_t>(_lists[list].size());
+    _lists[list].push_back(static_cast<uint32_t>(index));
+    _size++;
+
+    return true;
+}
+
+bool FaceprintsIvfIndex::Remove(size_t index)
+{
+    if (index >= _userList.size() || _userList[index] == NotIndexed)
+    {
+        LOG_ERROR(LOG_TAG, "User index %zu is not indexed", index);
+        return false;
+    }
+
+    // swap with the last user of the list, so removal is O(1).
+    std::vector<uint32_t>& list = _lists[_userList[index]];
+    uint32_t position = _userPosition[index];
+    uint32_t moved = list.back();
+    list[position] = moved;
+    _userPosition[moved] = position;
+    list.pop_back();
+
+    _userList[index] = NotIndexed;
+    _size--;
+
+    return true;
+}
+
+bool FaceprintsIvfIndex::Move(size_t from, size_t to)
+{
+    if (from >= _userList.size() || _userList[from] == NotIndexed || (to < _userList.size() && _userList[to] != NotIndexed))
+    {
+        LOG_ERROR(LOG_TAG, "Can't move user index %zu to %zu", from, to);
+        return false;
+    }
+
+    if (to >= _userList.size())
+    {
+        _userList.resize(to + 1, NotIndexed);
+        _userPosition.resize(to + 1, 0);
+    }
+
+    const uint32_t list = _userList[from];
+    const uint32_t position = _userPosition[from];
+    _lists[list][position] = static_cast<uint32_t>(to);
+    _userList[to] = list;
+    _userPosition[to] = position;
+    _userList[from] = NotIndexed;
+
+    return true;
+}
+
+bool FaceprintsIvfIndex::RemoveUser(FaceprintsGallery& gallery, size_t index)
+{
+    if (index >= gallery.Size())
+    {
+        LOG_ERROR(LOG_TAG, "Invalid user index %zu", index);
+        return false;
+    }
+
+    if (index < _userList.size() && _userList[index] != NotIndexed)
+    {
+        Remove(index);
+    }
+
+    const size_t last = gallery.Size() - 1;
+    if (!gallery.Remove(index))
+    {
+        return false;
+    }
+
+    // the gallery moved its last user to index.
+    if (index != last && last < _userList.size() && _userList[last] != NotIndexed)
+    {
+        return Move(last, index);
+    }
+    return true;
+}
+
+void FaceprintsIvfIndex::Clear()
+{
+    _centroids.clear();
+    _centroidNorms.clear();
+    _lists.clear();
+    _userList.clear();
+    _userPosition.clear();
+    _size = 0;
+}
+
+bool FaceprintsIvfIndex::Search(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery, const bool probe_has_mask,
+                                const size_t nprobe, TagResult& result, TopKCandidates* candidates) const
+{
+    const uint32_t vec_length = static_cast<uint32_t>(FaceprintsGallery::VectorLength);
+    const MatcherKernels::DotFn dot = MatcherKernels::Active(vec_length).dot;
+    const feature_t* probeVector = &probe_faceprints.data.featuresVector[0];
+    const NccNorm probeNorm = Matcher::ComputeNccNorm(probeVector, vec_length);
+    const int probeVersion = probe_faceprints.data.version;
+
+    result.score = -1;
+    result.idx = -1;
+
+    if (!IsTrained())
+    {
+        LOG_ERROR(LOG_TAG, "Index is not trained");
+        return false;
+    }
+
+    // gallery users are validated when added, so the version is checked once for all of them.
+    int galleryVersion = 0;
+    if (!gallery.CommonVersion(galleryVersion) || galleryVersion != probeVersion)
+    {
+        LOG_ERROR(LOG_TAG, "Mismatch in faceprints versions");
+        return false;
+    }
+
+    // best lists for the probe. the lists are assigned by the no-mask vectors, which are also the mask vectors of
+    // users without a valid mask vector, and are close to the mask vectors of the same user otherwise.
+    TopKCandidates bestLists(std::min(std::max<size_t>(1, nprobe), _numLists));
+    for (size_t list = 0; list < _numLists; list++)
+    {
+        int32_t corr = dot(probeVector, Centroid(list), vec_length);
+        bestLists.Insert(static_cast<int>(list), Matcher::ComputeNccGrade(corr, probeNorm, _centroidNorms[list]));
+    }
+
+    match_calc_t maxScore = -1; // must init to -1 so that maximum will be saved if matchScore is 0 !!!
+    int maxSubject = -1;
+
+    for (const auto& list : bestLists.Sorted())
+    {
+        const std::vector<uint32_t>& users = _lists[list.userId];
+        const size_t distance = RSID_MATCHER_IVF_PREFETCH_DISTANCE;
+        for (size_t i = 0; i < users.size(); i++)
+        {
+            const uint32_t subjectIndex = users[i];
+
+            // the list users are scattered in the gallery, so fetch the next rows while scoring this one.
+            if (i + distance < users.size() && users[i + distance] < gallery.Size())
+            {
+                PrefetchRow(gallery.ActiveVector(users[i + distance], probe_has_mask));
+            }
+
+            if (subjectIndex >= gallery.Size())
+            {
+                LOG_ERROR(LOG_TAG, "Index is out of sync with the gallery");
+                return false;
+            }
+
+#if (RSID_MATCHER_SCAN_CHECKS)
+            if (!gallery.ValidateUser(subjectIndex, probeVersion))
+            {
+                return false;
+            }
+#endif
+
+            // a row updated concurrently (FaceprintsGallery::Update()) while it's scored is scored again.
+            match_calc_t matchScore;
+            uint32_t sequence;
+            do
+            {
+                sequence = gallery.BeginRead(subjectIndex);
+                int32_t corr = dot(probeVector, gallery.ActiveVector(subjectIndex, probe_has_mask), vec_length);
+                matchScore = Matcher::ComputeNccGrade(corr, probeNorm, gallery.ActiveNorm(subjectIndex, probe_has_mask));
+            } while (!gallery.EndRead(subjectIndex, sequence));
+
+            // lists are not ordered by user index, so ties are resolved explicitly to the lowest index.
+            if (matchScore > maxScore || (matchScore == maxScore && static_cast<int>(subjectIndex) < maxSubject))
+            {
+                maxScore = matchScore;
+                maxSubject = static_cast<int>(subjectIndex);
+            }
+
+            if (candidates)
+            {
+                candidates->Insert(static_cast<int>(subjectIndex), matchScore);
+            }
+        }
+    }
+
+    result.score = maxScore;
+    result.idx = maxSubject;
+
+    return true;
+}
+
+uint32_t FaceprintsIvfIndex::NearestList(const feature_t* vec, const NccNorm& norm) const
+{
+    const uint32_t vec_length = static_cast<uint32_t>(FaceprintsGallery::VectorLength);
+    const MatcherKernels::DotFn dot = MatcherKernels::Active(vec_length).dot;
+
+    match_calc_t bestGrade = -1;
+    uint32_t bestList = 0;
+    for (size_t list = 0; list < _numLists; list++)
+    {
+        int32_t corr = dot(vec, Centroid(list), vec_length);
+        match_calc_t grade = Matcher::ComputeNccGrade(corr, norm, _centroidNorms[list]);
+        if (grade > bestGrade)
+        {
+            bestGrade = grade;
+            bestList = static_cast<uint32_t>(list);
+        }
+    }
+
+    return bestList;
+}
+
+// the centroid is the rounded mean of the list vectors, so it keeps the features range [-1023,+1023].
+void FaceprintsIvfIndex::SetCentroid(size_t list, const int64_t* sums, uint32_t count)
+{
+    const size_t vec_length = FaceprintsGallery::VectorLength;
+    feature_t* centroid = &_centroids[list * vec_length];
+    const int64_t half = count / 2;
+
+    for (size_t j = 0; j < vec_length; j++)
+    {
+        int64_t sum = sums[j];
+        centroid[j] = static_cast<feature_t>(sum >= 0 ? (sum + half) / count : -((-sum + half) / count));
+    }
+
+    _centroidNorms[list] = Matcher::ComputeNccNorm(centroid, static_cast<uint32_t>(vec_length));
+}
+} // namespace RealSenseID
@@ -0,0 +1,98 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "AlignedAllocator.h"
+#include "FaceprintsGallery.h"
+#include "MatchCandidates.h"
+#include "Matcher.h"
+#include <vector>
+#include <stdint.h>
+
+namespace RealSenseID
+{
+// Inverted file (IVF) approximate nearest neighbour index over a FaceprintsGallery, for large (million users) galleries.
+//
+// The gallery users are clustered to NumLists() lists by spherical k-means, using the matcher's integer ncc grade as
+// the similarity: each list has an integer centroid vector (mean of its users no-mask vectors), and a user belongs to
+// the list of the centroid with the best ncc grade. A search scores the probe against all the centroids, and scans
+// only the users of the nprobe best lists, with the exact ncc score (same score as the 1:N scan). nprobe is the
+// recall/latency knob: nprobe = NumLists() scans the whole gallery.
+//
+// The index only keeps gallery indices - the vectors are read from the gallery during search, so adaptive updates
+// of the gallery (FaceprintsGallery::Update()) are seen by the index without any change. Users added to the gallery
+// after Train() should be added with Insert(). FaceprintsGallery::Remove() is a swap remove (the last user moves to the
+// removed index), so users are removed from the gallery through RemoveUser(), which also renumbers the moved user (or
+// with Remove() before and Move() after the gallery removal).
+class FaceprintsIvfIndex
+{
+public:
+    explicit FaceprintsIvfIndex(size_t num_lists);
+
+    // cluster the gallery users (k-means over a sample of up to num_lists * RSID_MATCHER_IVF_TRAIN_SAMPLES_PER_LIST
+    // users) and index all of them. returns false if the gallery is empty.
+    bool Train(const FaceprintsGallery& gallery, unsigned int iterations = RSID_MATCHER_IVF_TRAIN_ITERATIONS);
+
+    // index (or re-index) the gallery user at given index. returns false if not trained or index is out of range.
+    bool Insert(const FaceprintsGallery& gallery, size_t index);
+
+    // remove the gallery user at given index from the index. returns false if it isn't indexed.
+    bool Remove(size_t index);
+
+    // the indexed gallery user at index from is now at index to (which isn't indexed), e.g. moved there by a swap
+    // remove. returns false if from isn't indexed or to is.
+    bool Move(size_t from, size_t to);
+
+    // remove the user at given index from the index and the gallery, and renumber the user the gallery moved to index.
+    // returns false if index is out of range of the gallery.
+    bool RemoveUser(FaceprintsGallery& gallery, size_t index);
+
+    void Clear();
+
+    bool IsTrained() const
+    {
+        return !_centroidNorms.empty();
+    }
+
+    size_t NumLists() const
+    {
+        return _numLists;
+    }
+
+    // number of indexed users.
+    size_t Size() const
+    {
+        return _size;
+    }
+
+    // score the probe against the users of the nprobe best lists. all scores are inserted to candidates, and the best
+    // one (lowest index on equal scores) is returned in result. returns false on gallery version mismatch.
+    bool Search(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery, const bool probe_has_mask,
+                const size_t nprobe, TagResult& result, TopKCandidates* candidates) const;
+
+private:
+    static constexpr uint32_t NotIndexed = 0xFFFFFFFF;
+
+    using AlignedFeatures = std::vector<feature_t, AlignedAllocator<feature_t, FaceprintsGallery::Alignment>>;
+
+    // list of the centroid with best ncc grade vs. the given vector (lowest list on equal grades).
+    uint32_t NearestList(const feature_t* vec, const NccNorm& norm) const;
+
+    void SetCentroid(size_t list, const int64_t* sums, uint32_t count);
+
+    const feature_t* Centroid(size_t list) const
+    {
+        return &_centroids[list * FaceprintsGallery::VectorLength];
+    }
+
+    size_t _numLists;
+    AlignedFeatures _centroids;
+    std::vector<NccNorm> _centroidNorms;
+    std::vector<std::vector<uint32_t>> _lists;
+    // per gallery index: its list (NotIndexed if not indexed) and position in the list.
+    std::vector<uint32_t> _userList;
+    std::vector<uint32_t> _userPosition;
+    size_t _size = 0;
+};
+} // namespace RealSenseID
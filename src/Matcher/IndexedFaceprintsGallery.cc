@@ -0,0 +1,211 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "IndexedFaceprintsGallery.h"
+#include "Logger.h"
+#include <cstring>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "IndexedFaceprintsGallery";
+
+std::string IndexedFaceprintsGallery::MakeKey(const char* user_id)
+{
+    const char* end = static_cast<const char*>(::memchr(user_id, '\0', RSID_MAX_USER_ID_LENGTH_IN_DB));
+    return std::string(user_id, end != nullptr ? end : user_id + RSID_MAX_USER_ID_LENGTH_IN_DB);
+}
+
+void IndexedFaceprintsGallery::Reserve(size_t num_users)
+{
+    _gallery.Reserve(num_users);
+    _indexById.reserve(num_users);
+    _slots.reserve(num_users);
+    _slotOfIndex.reserve(num_users);
+}
+
+IndexedFaceprintsGallery::Handle IndexedFaceprintsGallery::Upsert(const UserFaceprints_t& user_faceprints)
+{
+    return Upsert(user_faceprints.user_id, user_faceprints.faceprints);
+}
+
+IndexedFaceprintsGallery::Handle IndexedFaceprintsGallery::Upsert(const char* user_id, const Faceprints& faceprints)
+{
+    if (user_id == nullptr)
+    {
+        LOG_ERROR(LOG_TAG, "Null user id");
+        return Handle();
+    }
+
+    std::string key = MakeKey(user_id);
+    auto it = _indexById.find(key);
+    if (it != _indexById.end())
+    {
+        return _gallery.Update(it->second, faceprints) ? HandleAt(it->second) : Handle();
+    }
+
+    const size_t index = _gallery.Size();
+    if (!_gallery.Add(key.c_str(), faceprints))
+    {
+        return Handle();
+    }
+
+    _indexById.emplace(std::move(key), static_cast<uint32_t>(index));
+    return NewHandle(index);
+}
+
+bool IndexedFaceprintsGallery::Remove(const char* user_id)
+{
+    if (user_id == nullptr)
+    {
+        return false;
+    }
+
+    auto it = _indexById.find(MakeKey(user_id));
+    return it != _indexById.end() && RemoveAt(it->second);
+}
+
+bool IndexedFaceprintsGallery::Remove(Handle handle)
+{
+    size_t index;
+    return IndexOf(handle, index) && RemoveAt(index);
+}
+
+bool IndexedFaceprintsGallery::ApplyAdaptiveUpdate(const ExtendedMatchResult& result, const Faceprints& updated_faceprints)
+{
+    if (!result.should_update || result.userId < 0 || static_cast<size_t>(result.userId) >= _gallery.Size())
+    {
+        return false;
+    }
+
+    return _gallery.Update(static_cast<size_t>(result.userId), updated_faceprints);
+}
+
+bool IndexedFaceprintsGallery::ApplyAdaptiveUpdate(Handle handle, const Faceprints& updated_faceprints)
+{
+    size_t index;
+    return IndexOf(handle, index) && _gallery.Update(index, updated_faceprints);
+}
+
+bool IndexedFaceprintsGallery::Assign(const FaceprintsGallery& gallery)
+{
+    Clear();
+    _gallery = gallery;
+    _indexById.reserve(_gallery.Size());
+    _slots.reserve(_gallery.Size());
+    _slotOfIndex.reserve(_gallery.Size());
+
+    for (size_t index = 0; index < _gallery.Size(); index++)
+    {
+        if (!_indexById.emplace(_gallery.UserId(index), static_cast<uint32_t>(index)).second)
+        {
+            LOG_ERROR(LOG_TAG, "Duplicate user id at index %zu", index);
+            Clear();
+            return false;
+        }
+        NewHandle(index);
+    }
+
+    return true;
+}
+
+void IndexedFaceprintsGallery::Clear()
+{
+    _gallery.Clear();
+    _indexById.clear();
+    _slots.clear();
+    _slotOfIndex.clear();
+    _freeSlots.clear();
+}
+
+IndexedFaceprintsGallery::Handle IndexedFaceprintsGallery::Find(const char* user_id) const
+{
+    if (user_id == nullptr)
+    {
+        return Handle();
+    }
+
+    auto it = _indexById.find(MakeKey(user_id));
+    return it != _indexById.end() ? HandleAt(it->second) : Handle();
+}
+
+IndexedFaceprintsGallery::Handle IndexedFaceprintsGallery::HandleAt(size_t index) const
+{
+    Handle handle;
+    if (index < _slotOfIndex.size())
+    {
+        handle.slot = _slotOfIndex[index];
+        handle.generation = _slots[handle.slot].generation;
+    }
+    return handle;
+}
+
+bool IndexedFaceprintsGallery::IndexOf(Handle handle, size_t& index) const
+{
+    if (!handle.IsValid() || handle.slot >= _slots.size())
+    {
+        return false;
+    }
+
+    const Slot& slot = _slots[handle.slot];
+    if (slot.generation != handle.generation || slot.index == Handle::InvalidSlot)
+    {
+        return false;
+    }
+
+    index = slot.index;
+    return true;
+}
+
+IndexedFaceprintsGallery::Handle IndexedFaceprintsGallery::NewHandle(size_t index)
+{
+    uint32_t slot;
+    if (!_freeSlots.empty())
+    {
+        slot = _freeSlots.back();
+        _freeSlots.pop_back();
+    }
+    else
+    {
+        slot = static_cast<uint32_t>(_slots.size());
+        _slots.push_back({Handle::InvalidSlot, 0});
+    }
+
+    _slots[slot].index = static_cast<uint32_t>(index);
+    _slotOfIndex.push_back(slot);
+
+    Handle handle;
+    handle.slot = slot;
+    handle.generation = _slots[slot].generation;
+    return handle;
+}
+
+// the gallery moves its last user to index, so the id entry and the slot of that user follow it.
+bool IndexedFaceprintsGallery::RemoveAt(size_t index)
+{
+    const size_t last = _gallery.Size() - 1;
+    _indexById.erase(MakeKey(_gallery.UserId(index)));
+    if (index != last)
+    {
+        _indexById[MakeKey(_gallery.UserId(last))] = static_cast<uint32_t>(index);
+    }
+
+    if (!_gallery.Remove(index))
+    {
+        return false;
+    }
+
+    // invalidate the handles of the removed user, and re-point the moved user's slot.
+    Slot& removed = _slots[_slotOfIndex[index]];
+    removed.index = Handle::InvalidSlot;
+    removed.generation++;
+    _freeSlots.push_back(_slotOfIndex[index]);
+
+    if (index != last)
+    {
+        _slotOfIndex[index] = _slotOfIndex[last];
+        _slots[_slotOfIndex[index]].index = static_cast<uint32_t>(index);
+    }
+    _slotOfIndex.pop_back();
+    return true;
+}
+} // namespace RealSenseID
@@ -0,0 +1,113 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "FaceprintsGallery.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+namespace RealSenseID
+{
+// FaceprintsGallery maintained by user id, for host mode callers that add, remove and update users over time.
+//
+// A hash index maps each user id to its gallery index, so Upsert(), Remove() and finding a user are O(1) instead of a
+// strcmp scan over the users. Remove() is a swap remove (FaceprintsGallery::Remove()): the last user moves to the
+// removed index, so the packed matrices stay dense and nothing is rebuilt. Every change (insert, remove, adaptive
+// update) writes only the rows of the users it touches, with their cached norms and quantized rows.
+//
+// Gallery indices change when users are removed, so users are referred to by handles: a handle keeps pointing to its
+// user wherever it moves, and becomes invalid when the user is removed (also after its slot is reused by a new user).
+//
+// Match with Matcher::MatchFaceprintsToGallery(probe, Gallery(), ...) and write the adaptive update back with
+// ApplyAdaptiveUpdate(). The result user index is valid until the next Upsert() of a new user or Remove().
+// Not thread safe: changes must not run concurrently with matches (see ConcurrentFaceprintsGallery).
+class IndexedFaceprintsGallery
+{
+public:
+    struct Handle
+    {
+        static constexpr uint32_t InvalidSlot = 0xFFFFFFFF;
+
+        uint32_t slot = InvalidSlot;
+        uint32_t generation = 0;
+
+        bool IsValid() const
+        {
+            return slot != InvalidSlot;
+        }
+    };
+
+    IndexedFaceprintsGallery() = default;
+
+    // reserve room for the given number of users.
+    void Reserve(size_t num_users);
+
+    // add the user, or replace its faceprints if the user id is already in the gallery. returns an invalid handle (and
+    // doesn't change the gallery) if user_id is null or the faceprints failed validation.
+    // user ids are compared up to RSID_MAX_USER_ID_LENGTH_IN_DB characters, as kept by the gallery.
+    Handle Upsert(const char* user_id, const Faceprints& faceprints);
+    Handle Upsert(const UserFaceprints_t& user_faceprints);
+
+    // remove the user. returns false if it's not in the gallery.
+    bool Remove(const char* user_id);
+    bool Remove(Handle handle);
+
+    // write back the updated faceprints of a match of the gallery (result.should_update set). returns false if the
+    // result has no update or its user index is out of range.
+    bool ApplyAdaptiveUpdate(const ExtendedMatchResult& result, const Faceprints& updated_faceprints);
+    bool ApplyAdaptiveUpdate(Handle handle, const Faceprints& updated_faceprints);
+
+    // replace all users with the users of gallery (e.g. opened by FaceprintsGalleryFile). returns false (and leaves
+    // the gallery empty) if gallery has duplicate user ids.
+    bool Assign(const FaceprintsGallery& gallery);
+
+    void Clear();
+
+    // handle of the user, invalid if not in the gallery.
+    Handle Find(const char* user_id) const;
+
+    // handle of the user at given gallery index (e.g. ExtendedMatchResult::userId), invalid if out of range.
+    Handle HandleAt(size_t index) const;
+
+    // current gallery index of the user. returns false if the handle is invalid or its user was removed.
+    bool IndexOf(Handle handle, size_t& index) const;
+
+    const FaceprintsGallery& Gallery() const
+    {
+        return _gallery;
+    }
+
+    size_t Size() const
+    {
+        return _gallery.Size();
+    }
+
+    bool Empty() const
+    {
+        return _gallery.Empty();
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t index;
+        uint32_t generation;
+    };
+
+    static std::string MakeKey(const char* user_id);
+
+    // bind a new slot to the user just added at given gallery index.
+    Handle NewHandle(size_t index);
+    bool RemoveAt(size_t index);
+
+    FaceprintsGallery _gallery;
+
+    std::unordered_map<std::string, uint32_t> _indexById; // user id -> gallery index
+    std::vector<Slot> _slots;                              // handle slot -> gallery index
+    std::vector<uint32_t> _slotOfIndex;                    // gallery index -> handle slot
+    std::vector<uint32_t> _freeSlots;
+};
+} // namespace RealSenseID
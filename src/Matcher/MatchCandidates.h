@@ -0,0 +1,91 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "RealSenseID/MatcherDefines.h"
+#include <algorithm>
+#include <vector>
+
+namespace RealSenseID
+{
+// single (user index, score) match candidate.
+struct MatchCandidate
+{
+    int userId = -1;
+    match_calc_t score = 0;
+};
+
+// candidates ranking: higher score first, lower user index first on equal scores (same tie rule as the 1:N scan).
+inline bool IsBetterCandidate(const MatchCandidate& lhs, const MatchCandidate& rhs)
+{
+    return (lhs.score > rhs.score) || (lhs.score == rhs.score && lhs.userId < rhs.userId);
+}
+
+// Keeps the best K candidates seen so far in a bounded heap (worst kept candidate at the top).
+// Insert() is O(1) for candidates that don't make it into the top K, which is the common case during a scan.
+class TopKCandidates
+{
+public:
+    explicit TopKCandidates(size_t k = 0) : _k(k)
+    {
+        _heap.reserve(k);
+    }
+
+    void Reset(size_t k)
+    {
+        _k = k;
+        _heap.clear();
+        _heap.reserve(k);
+    }
+
+    size_t K() const
+    {
+        return _k;
+    }
+
+    void Insert(const MatchCandidate& candidate)
+    {
+        if (_heap.size() < _k)
+        {
+            _heap.push_back(candidate);
+            std::push_heap(_heap.begin(), _heap.end(), IsBetterCandidate);
+        }
+        else if (_k > 0 && IsBetterCandidate(candidate, _heap.front()))
+        {
+            std::pop_heap(_heap.begin(), _heap.end(), IsBetterCandidate);
+            _heap.back() = candidate;
+            std::push_heap(_heap.begin(), _heap.end(), IsBetterCandidate);
+        }
+    }
+
+    void Insert(int userId, match_calc_t score)
+    {
+        MatchCandidate candidate;
+        candidate.userId = userId;
+        candidate.score = score;
+        Insert(candidate);
+    }
+
+    // merge candidates kept by another instance (e.g. of another thread/shard).
+    void Merge(const TopKCandidates& other)
+    {
+        for (const auto& candidate : other._heap)
+        {
+            Insert(candidate);
+        }
+    }
+
+    // best candidates, best first.
+    std::vector<MatchCandidate> Sorted() const
+    {
+        std::vector<MatchCandidate> sorted(_heap);
+        std::sort(sorted.begin(), sorted.end(), IsBetterCandidate);
+        return sorted;
+    }
+
+private:
+    size_t _k;
+    std::vector<MatchCandidate> _heap;
+};
+} // namespace RealSenseID
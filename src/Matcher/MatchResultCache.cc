@@ -0,0 +1,46 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "MatchResultCache.h"
+#include "FaceprintsGallery.h"
+
+namespace RealSenseID
+{
+MatchResultCache::MatchResultCache(std::chrono::milliseconds ttl, match_calc_t score_margin) : _ttl(ttl), _scoreMargin(score_margin)
+{
+}
+
+void MatchResultCache::Store(const FaceprintsGallery& gallery, const Thresholds& thresholds, size_t user_index)
+{
+    _valid = true;
+    // if the user was just updated (e.g. the adaptive update of the match that accepted it), the generation before its
+    // updates, so OnlyUserUpdatedSince() accepts the following updates of the user too.
+    _generation = gallery.UserBaseGeneration(user_index);
+    _thresholds = thresholds;
+    _userIndex = user_index;
+    _expiry = Clock::now() + _ttl;
+}
+
+bool MatchResultCache::Lookup(const FaceprintsGallery& gallery, const Thresholds& thresholds, size_t& user_index) const
+{
+    if (!_valid || !gallery.OnlyUserUpdatedSince(_generation, _userIndex) || _userIndex >= gallery.Size() ||
+        !SameThresholds(_thresholds, thresholds) || Clock::now() >= _expiry)
+    {
+        return false;
+    }
+
+    user_index = _userIndex;
+    return true;
+}
+
+// field by field: the struct may have padding.
+bool MatchResultCache::SameThresholds(const Thresholds& lhs, const Thresholds& rhs)
+{
+    return lhs.identicalThreshold_gNMgNM == rhs.identicalThreshold_gNMgNM && lhs.identicalThreshold_gMgNM == rhs.identicalThreshold_gMgNM &&
+           lhs.strongThreshold_pNMgNM == rhs.strongThreshold_pNMgNM && lhs.strongThreshold_pMgM == rhs.strongThreshold_pMgM &&
+           lhs.strongThreshold_pMgNM == rhs.strongThreshold_pMgNM &&
+           lhs.strongThreshold_pNMgNM_rgbImgEnroll == rhs.strongThreshold_pNMgNM_rgbImgEnroll &&
+           lhs.updateThreshold_pNMgNM == rhs.updateThreshold_pNMgNM && lhs.updateThreshold_pMgM == rhs.updateThreshold_pMgM &&
+           lhs.updateThreshold_pMgNM_First == rhs.updateThreshold_pMgNM_First && lhs.confidenceLevel == rhs.confidenceLevel;
+}
+} // namespace RealSenseID
@@ -0,0 +1,61 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "MatcherImplDefines.h"
+#include "RealSenseID/MatcherDefines.h"
+#include <chrono>
+#include <stdint.h>
+
+namespace RealSenseID
+{
+class FaceprintsGallery;
+
+// Last accepted user of a stream of probes vs. a FaceprintsGallery (e.g. an authentication loop, where the same
+// person stays in front of the device), see Matcher::MatchFaceprintsToGallery() and ConcurrentFaceprintsGallery::Match()
+// with a cache.
+//
+// An entry is valid for ttl from the full scan that accepted the user, and only for the gallery generation and
+// thresholds it was stored with: any change of the gallery users (FaceprintsGallery::Generation()) or of the
+// thresholds invalidates it - except updates of the cached user itself (e.g. the adaptive update of its match), as
+// a probe is only accepted from the cache by its score against the current faceprints of the user.
+// Not thread safe: use a cache per probes stream.
+class MatchResultCache
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit MatchResultCache(std::chrono::milliseconds ttl = std::chrono::milliseconds {RSID_MATCHER_CACHE_TTL_MS},
+                              match_calc_t score_margin = RSID_MATCHER_CACHE_SCORE_MARGIN);
+
+    // remember the accepted user at given gallery index.
+    void Store(const FaceprintsGallery& gallery, const Thresholds& thresholds, size_t user_index);
+
+    // the cached user index, if the entry is valid for the gallery and thresholds.
+    bool Lookup(const FaceprintsGallery& gallery, const Thresholds& thresholds, size_t& user_index) const;
+
+    void Invalidate()
+    {
+        _valid = false;
+    }
+
+    // a probe is accepted from the cache only if it scores at least the strong threshold plus this margin.
+    match_calc_t ScoreMargin() const
+    {
+        return _scoreMargin;
+    }
+
+private:
+    static bool SameThresholds(const Thresholds& lhs, const Thresholds& rhs);
+
+    std::chrono::milliseconds _ttl;
+    match_calc_t _scoreMargin;
+
+    bool _valid = false;
+    uint64_t _generation = 0;
+    Thresholds _thresholds = {};
+    size_t _userIndex = 0;
+    Clock::time_point _expiry;
+};
+} // namespace RealSenseID
@@ -2,6 +2,11 @@
 // Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
 
 #include "Matcher.h"
+#include "MatcherKernels.h"
+#include "MatcherParallel.h"
+#include "FaceprintsGallery.h"
+#include "FaceprintsIvfIndex.h"
+#include "MatchResultCache.h"
 #include "Logger.h"
 #include "RealSenseID/Faceprints.h"
 #include <cmath>
@@ -100,6 +105,113 @@ void Matcher::SetToDefaultThresholds(Thresholds& thresholds, const ThresholdsCon
     // LOG_DEBUG(LOG_TAG, "----> Thresholds confidence level in matcher is : %d.", confidenceLevel);
 }
 
+// thresholds and update iterations limit of each thresholds configuration, resolved at compile time: once
+// HandleThresholdsConfiguration() picked the configuration, the active thresholds are set without further branches.
+template <ThresholdsConfigEnum Config>
+struct ThresholdsConfigTraits;
+
+// probe no-mask, gallery no-mask. adaptation of the without-mask vector, anchored to the enrollment vector.
+template <>
+struct ThresholdsConfigTraits<ThresholdsConfigEnum::ThresholdConfig_pNM_gNM>
+{
+    static constexpr uint32_t LimitNumIters = RSID_LIMIT_NUM_ITERS_NM;
+
+    static short Identical(const Thresholds& thresholds)
+    {
+        return thresholds.identicalThreshold_gNMgNM;
+    }
+    // use different (lower) strong threshold in case the DB enrollment was from rgb image.
+    static short Strong(const Thresholds& thresholds, const bool rgb_enrolled)
+    {
+        return rgb_enrolled ? thresholds.strongThreshold_pNMgNM_rgbImgEnroll : thresholds.strongThreshold_pNMgNM;
+    }
+    static short Update(const Thresholds& thresholds)
+    {
+        return thresholds.updateThreshold_pNMgNM;
+    }
+};
+
+// probe with mask, gallery with a valid with-mask vector. adaptation of the with-mask vector.
+// the anchor vector is the _gNM vector anyway, so identical threshold is _gMgNM.
+template <>
+struct ThresholdsConfigTraits<ThresholdsConfigEnum::ThresholdConfig_pM_gM>
+{
+    static constexpr uint32_t LimitNumIters = RSID_LIMIT_NUM_ITERS_M;
+
+    static short Identical(const Thresholds& thresholds)
+    {
+        return thresholds.identicalThreshold_gMgNM;
+    }
+    static short Strong(const Thresholds& thresholds, const bool)
+    {
+        return thresholds.strongThreshold_pMgM;
+    }
+    static short Update(const Thresholds& thresholds)
+    {
+        return thresholds.updateThreshold_pMgM;
+    }
+};
+
+// probe with mask, gallery without a valid with-mask vector: the with-mask vector is set for the first time.
+template <>
+struct ThresholdsConfigTraits<ThresholdsConfigEnum::ThresholdConfig_pM_gNM>
+{
+    static constexpr uint32_t LimitNumIters = RSID_LIMIT_NUM_ITERS_M;
+
+    static short Identical(const Thresholds& thresholds)
+    {
+        return thresholds.identicalThreshold_gMgNM;
+    }
+    static short Strong(const Thresholds& thresholds, const bool)
+    {
+        return thresholds.strongThreshold_pMgNM;
+    }
+    static short Update(const Thresholds& thresholds)
+    {
+        return thresholds.updateThreshold_pMgNM_First;
+    }
+};
+
+template <ThresholdsConfigEnum Config>
+static void SetActiveThresholds(AdaptiveThresholds& adaptiveThresholds, const bool rgb_enrolled)
+{
+    using Traits = ThresholdsConfigTraits<Config>;
+
+    adaptiveThresholds.activeConfig = Config;
+    adaptiveThresholds.activeIdenticalThreshold = Traits::Identical(adaptiveThresholds.thresholds);
+    adaptiveThresholds.activeStrongThreshold = Traits::Strong(adaptiveThresholds.thresholds, rgb_enrolled);
+    adaptiveThresholds.activeUpdateThreshold = Traits::Update(adaptiveThresholds.thresholds);
+}
+
+static uint32_t LimitNumIters(const ThresholdsConfigEnum config)
+{
+    switch (config)
+    {
+    case ThresholdsConfigEnum::ThresholdConfig_pM_gM:
+        return ThresholdsConfigTraits<ThresholdsConfigEnum::ThresholdConfig_pM_gM>::LimitNumIters;
+    case ThresholdsConfigEnum::ThresholdConfig_pM_gNM:
+        return ThresholdsConfigTraits<ThresholdsConfigEnum::ThresholdConfig_pM_gNM>::LimitNumIters;
+    case ThresholdsConfigEnum::ThresholdConfig_pNM_gNM:
+        return ThresholdsConfigTraits<ThresholdsConfigEnum::ThresholdConfig_pNM_gNM>::LimitNumIters;
+    default:
+        // like before the traits: every configuration other than pNM_gNM is a mask one.
+        return static_cast<uint32_t>(RSID_LIMIT_NUM_ITERS_M);
+    }
+}
+
+short Matcher::StrongThreshold(const Thresholds& thresholds, const ThresholdsConfigEnum config, const bool rgb_enrolled)
+{
+    switch (config)
+    {
+    case ThresholdsConfigEnum::ThresholdConfig_pM_gM:
+        return ThresholdsConfigTraits<ThresholdsConfigEnum::ThresholdConfig_pM_gM>::Strong(thresholds, rgb_enrolled);
+    case ThresholdsConfigEnum::ThresholdConfig_pM_gNM:
+        return ThresholdsConfigTraits<ThresholdsConfigEnum::ThresholdConfig_pM_gNM>::Strong(thresholds, rgb_enrolled);
+    default:
+        return ThresholdsConfigTraits<ThresholdsConfigEnum::ThresholdConfig_pNM_gNM>::Strong(thresholds, rgb_enrolled);
+    }
+}
+
 void Matcher::InitAdaptiveThresholds(const Thresholds& thresholds, AdaptiveThresholds& adaptiveThresholds)
 {
     adaptiveThresholds.thresholds = thresholds;
@@ -116,16 +228,7 @@ void Matcher::HandleThresholdsConfiguration(const bool& probe_has_mask, const Fa
     // we adjust the correct thresholds and adaptiveVector for w/wo mask scenarios.
     if (!probe_has_mask)
     {
-        adaptiveThresholds.activeConfig = ThresholdsConfigEnum::ThresholdConfig_pNM_gNM;
-        adaptiveThresholds.activeIdenticalThreshold = adaptiveThresholds.thresholds.identicalThreshold_gNMgNM;
-        adaptiveThresholds.activeStrongThreshold = adaptiveThresholds.thresholds.strongThreshold_pNMgNM;
-        adaptiveThresholds.activeUpdateThreshold = adaptiveThresholds.thresholds.updateThreshold_pNMgNM;
-
-        // use different (lower) strong threshold in case the DB enrollment was from rgb image.
-        if (isEnrolledTypeInDbIsRgb)
-        {
-            adaptiveThresholds.activeStrongThreshold = adaptiveThresholds.thresholds.strongThreshold_pNMgNM_rgbImgEnroll;
-        }
+        SetActiveThresholds<ThresholdsConfigEnum::ThresholdConfig_pNM_gNM>(adaptiveThresholds, isEnrolledTypeInDbIsRgb);
     }
     else
     {
@@ -136,22 +239,12 @@ void Matcher::HandleThresholdsConfiguration(const bool& probe_has_mask, const Fa
         if (is_valid)
         {
             // apply adaptation on the WithMask[] vector
-            adaptiveThresholds.activeConfig = ThresholdsConfigEnum::ThresholdConfig_pM_gM;
-            // if with-mask the anchor vector is the _gNM vector anyway, so identical threshold
-            // is _pMgNM.
-            adaptiveThresholds.activeIdenticalThreshold = adaptiveThresholds.thresholds.identicalThreshold_gMgNM;
-            adaptiveThresholds.activeStrongThreshold = adaptiveThresholds.thresholds.strongThreshold_pMgM;
-            adaptiveThresholds.activeUpdateThreshold = adaptiveThresholds.thresholds.updateThreshold_pMgM;
+            SetActiveThresholds<ThresholdsConfigEnum::ThresholdConfig_pM_gM>(adaptiveThresholds, isEnrolledTypeInDbIsRgb);
         }
         else
         {
             // apply adaptation on the WithoutMask[] vector
-            adaptiveThresholds.activeConfig = ThresholdsConfigEnum::ThresholdConfig_pM_gNM;
-            // if with-mask the anchor vector is the _gNM vector anyway, so identical threshold
-            // is _pMgNM.
-            adaptiveThresholds.activeIdenticalThreshold = adaptiveThresholds.thresholds.identicalThreshold_gMgNM;
-            adaptiveThresholds.activeStrongThreshold = adaptiveThresholds.thresholds.strongThreshold_pMgNM;
-            adaptiveThresholds.activeUpdateThreshold = adaptiveThresholds.thresholds.updateThreshold_pMgNM_First;
+            SetActiveThresholds<ThresholdsConfigEnum::ThresholdConfig_pM_gNM>(adaptiveThresholds, isEnrolledTypeInDbIsRgb);
         }
     }
 
@@ -164,8 +257,71 @@ void Matcher::HandleThresholdsConfiguration(const bool& probe_has_mask, const Fa
     return;
 }
 
+// Run scan_shard(begin, end, shard_result, shard_candidates) over the users [0, num_users) and keep the best score, and
+// optionally the best candidates (if candidates is not null).
+//
+// Users are split to shards of RSID_MATCHER_SHARD_SIZE users (so the vectors of a shard fit in the cache), which are
+// picked up dynamically by num_threads threads (the calling thread included). Each shard keeps its own maximum with the
+// lowest index on ties, and shards are merged in index order using the same strict '>' comparison - so the result is
+// identical to a serial scan. Each thread keeps its own bounded top-k heap, and the heaps are merged at the end.
+// Fails if any shard failed.
+template <typename ScanShardFn>
+static bool ScanShards(const size_t num_users, unsigned int num_threads, ScanShardFn& scan_shard, TagResult& result,
+                       TopKCandidates* candidates)
+{
+    // don't pay for threads on small galleries.
+    const size_t max_useful_threads = std::max<size_t>(1, num_users / RSID_MATCHER_MIN_USERS_PER_THREAD);
+    num_threads = MatcherParallel::ThreadsFor(max_useful_threads, num_threads);
+
+    if (num_threads <= 1)
+    {
+        return scan_shard(0, num_users, result, candidates);
+    }
+
+    const size_t shard_size = RSID_MATCHER_SHARD_SIZE;
+    const size_t num_shards = (num_users + shard_size - 1) / shard_size;
+    std::vector<TagResult> shard_results(num_shards);
+    std::vector<char> shard_ok(num_shards, 0);
+    std::vector<TopKCandidates> thread_candidates(num_threads, TopKCandidates(candidates ? candidates->K() : 0));
+
+    MatcherParallel::ParallelFor(num_shards, num_threads, [&](size_t shard, unsigned int thread_index) {
+        TopKCandidates* worker_candidates = candidates ? &thread_candidates[thread_index] : nullptr;
+        size_t begin = shard * shard_size;
+        size_t end = std::min(begin + shard_size, num_users);
+        shard_ok[shard] = scan_shard(begin, end, shard_results[shard], worker_candidates) ? 1 : 0;
+    });
+
+    if (candidates)
+    {
+        for (const auto& worker_candidates : thread_candidates)
+        {
+            candidates->Merge(worker_candidates);
+        }
+    }
+
+    match_calc_t maxScore = -1;
+    int maxSubject = -1;
+    for (size_t shard = 0; shard < num_shards; shard++)
+    {
+        if (!shard_ok[shard])
+        {
+            return false;
+        }
+        if (shard_results[shard].score > maxScore)
+        {
+            maxScore = shard_results[shard].score;
+            maxSubject = shard_results[shard].idx;
+        }
+    }
+
+    result.score = maxScore;
+    result.idx = maxSubject;
+
+    return true;
+}
+
 bool Matcher::GetScores(const MatchElement& probe_faceprints, const std::vector<UserFaceprints_t>& existing_faceprints_array,
-                        TagResult& result, const bool& probe_has_mask)
+                        TagResult& result, const bool& probe_has_mask, const unsigned int num_threads, TopKCandidates* candidates)
 {
     if (existing_faceprints_array.size() == 0)
     {
@@ -176,16 +332,26 @@ bool Matcher::GetScores(const MatchElement& probe_faceprints, const std::vector<
     result.score = 0;
     result.idx = -1;
 
+    auto scan_shard = [&](size_t begin, size_t end, TagResult& shard_result, TopKCandidates* shard_candidates) {
+        return ScanScores(probe_faceprints, existing_faceprints_array, begin, end, shard_result, probe_has_mask, shard_candidates);
+    };
+
+    return ScanShards(existing_faceprints_array.size(), num_threads, scan_shard, result, candidates);
+}
+
+bool Matcher::ScanScores(const MatchElement& probe_faceprints, const std::vector<UserFaceprints_t>& existing_faceprints_array,
+                         const size_t begin, const size_t end, TagResult& result, const bool& probe_has_mask,
+                         TopKCandidates* candidates)
+{
     match_calc_t maxScore = -1; // must init to -1 so that maximum will be saved if matchScore is 0 !!!
     match_calc_t matchScore = -1;
-    int numberOfSubjects = (int)existing_faceprints_array.size();
     int maxSubject = -1;
     uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES;
 
     const feature_t* probeVector = (feature_t*)(&(probe_faceprints.data.featuresVector[0]));
     feature_t* galeryAdaptiveVector = nullptr;
 
-    for (int subjectIndex = 0; subjectIndex < numberOfSubjects; subjectIndex++)
+    for (int subjectIndex = (int)begin; subjectIndex < (int)end; subjectIndex++)
     {
         matchScore = s_minPossibleScore;
         auto& existing_faceprints = existing_faceprints_array[subjectIndex];
@@ -232,6 +398,168 @@ bool Matcher::GetScores(const MatchElement& probe_faceprints, const std::vector<
             maxScore = matchScore;
             maxSubject = static_cast<int>(subjectIndex);
         }
+
+        if (candidates)
+        {
+            candidates->Insert(subjectIndex, matchScore);
+        }
+    }
+
+    result.score = maxScore;
+    result.idx = maxSubject;
+
+    return true;
+}
+
+bool Matcher::GetScores(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery, TagResult& result,
+                        const bool& probe_has_mask, const unsigned int num_threads, TopKCandidates* candidates)
+{
+    if (gallery.Empty())
+    {
+        LOG_ERROR(LOG_TAG, "Can't match with empty gallery.");
+        return false;
+    }
+
+    result.score = 0;
+    result.idx = -1;
+
+    // the probe norm is computed once, and the gallery norms are cached in the gallery. so per user we only need the
+    // correlation - same score as MatchTwoVectors(probeVector, galleryVector).
+    const NccNorm probeNorm = ComputeNccNorm(&probe_faceprints.data.featuresVector[0], RSID_NUM_OF_RECOGNITION_FEATURES);
+
+    auto scan_shard = [&](size_t begin, size_t end, TagResult& shard_result, TopKCandidates* shard_candidates) {
+        return ScanScores(probe_faceprints, probeNorm, gallery, begin, end, shard_result, probe_has_mask, shard_candidates);
+    };
+
+    return ScanShards(gallery.Size(), num_threads, scan_shard, result, candidates);
+}
+
+bool Matcher::ScanScores(const MatchElement& probe_faceprints, const NccNorm& probeNorm, const FaceprintsGallery& gallery,
+                         const size_t begin, const size_t end, TagResult& result, const bool& probe_has_mask,
+                         TopKCandidates* candidates)
+{
+    match_calc_t maxScore = -1; // must init to -1 so that maximum will be saved if matchScore is 0 !!!
+    match_calc_t matchScore = -1;
+    int maxSubject = -1;
+    uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES;
+#if (RSID_MATCHER_SCAN_CHECKS)
+    const int probeVersion = probe_faceprints.data.version;
+#endif
+
+    const feature_t* probeVector = &probe_faceprints.data.featuresVector[0];
+    const MatcherKernels::DotFn dot = MatcherKernels::Active(vec_length).dot;
+
+    // gallery vectors were validated when added to the gallery and the probe version was checked against the gallery
+    // common version (see CheckGalleryMatch()), and the active (w/wo mask) vector of each user is already selected in
+    // the packed matrix, so here we only stream the rows.
+    // a row updated concurrently (FaceprintsGallery::Update()) while it's scored is scored again.
+    for (int subjectIndex = (int)begin; subjectIndex < (int)end; subjectIndex++)
+    {
+#if (RSID_MATCHER_SCAN_CHECKS)
+        if (!gallery.ValidateUser(subjectIndex, probeVersion))
+        {
+            return false;
+        }
+#endif
+
+        uint32_t sequence;
+        do
+        {
+            sequence = gallery.BeginRead(subjectIndex);
+            int32_t corr = dot(probeVector, gallery.ActiveVector(subjectIndex, probe_has_mask), vec_length);
+            matchScore = ComputeNccGrade(corr, probeNorm, gallery.ActiveNorm(subjectIndex, probe_has_mask));
+        } while (!gallery.EndRead(subjectIndex, sequence));
+
+        // save max found so far
+        if (matchScore > maxScore)
+        {
+            maxScore = matchScore;
+            maxSubject = subjectIndex;
+        }
+
+        if (candidates)
+        {
+            candidates->Insert(subjectIndex, matchScore);
+        }
+    }
+
+    result.score = maxScore;
+    result.idx = maxSubject;
+
+    return true;
+}
+
+bool Matcher::GetCoarseCandidates(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery, const bool& probe_has_mask,
+                                  const unsigned int num_threads, TopKCandidates& shortlist)
+{
+    const uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES;
+    const MatcherKernels::KernelTable& kernels = MatcherKernels::Active(vec_length);
+
+    alignas(FaceprintsGallery::Alignment) int8_t probeQuantized[RSID_NUM_OF_RECOGNITION_FEATURES];
+    MatcherKernels::QuantizeToInt8(&probe_faceprints.data.featuresVector[0], probeQuantized, vec_length);
+    int32_t probeNorm = kernels.dot_i8(probeQuantized, probeQuantized, vec_length);
+    const float probeInvNorm = probeNorm > 0 ? 1.0f / std::sqrt(static_cast<float>(probeNorm)) : 0.0f;
+    const int probeVersion = probe_faceprints.data.version;
+
+    auto scan_shard = [&](size_t begin, size_t end, TagResult& shard_result, TopKCandidates* shard_candidates) {
+        return ScanCoarseScores(probeQuantized, probeInvNorm, probeVersion, gallery, begin, end, shard_result, probe_has_mask,
+                                shard_candidates);
+    };
+
+    TagResult coarseResult;
+    return ScanShards(gallery.Size(), num_threads, scan_shard, coarseResult, &shortlist);
+}
+
+// coarse score of a user: cosine of the quantized probe and row, scaled to RSID_MATCHER_COARSE_SCORE_SCALE.
+// it only ranks the users for the shortlist, and is never compared against the thresholds.
+bool Matcher::ScanCoarseScores(const int8_t* probeQuantized, const float probeInvNorm, const int probeVersion,
+                               const FaceprintsGallery& gallery, const size_t begin, const size_t end, TagResult& result,
+                               const bool& probe_has_mask, TopKCandidates* candidates)
+{
+    match_calc_t maxScore = -1;
+    int maxSubject = -1;
+    const uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES;
+    const MatcherKernels::DotI8Fn dot_i8 = MatcherKernels::Active(vec_length).dot_i8;
+    const float scale = probeInvNorm * static_cast<float>(RSID_MATCHER_COARSE_SCORE_SCALE);
+
+    // like the exact scan, users are trusted to be valid (see ScanScores()). probeVersion is for the per user checks.
+    (void)probeVersion;
+
+    for (int subjectIndex = (int)begin; subjectIndex < (int)end; subjectIndex++)
+    {
+#if (RSID_MATCHER_SCAN_CHECKS)
+        if (!gallery.ValidateUser(subjectIndex, probeVersion))
+        {
+            return false;
+        }
+#endif
+
+        // like the exact scan, a row updated concurrently while it's scored is scored again.
+        int32_t corr;
+        float invNorm;
+        uint32_t sequence;
+        do
+        {
+            sequence = gallery.BeginRead(subjectIndex);
+            corr = dot_i8(probeQuantized, gallery.ActiveQuantizedVector(subjectIndex, probe_has_mask), vec_length);
+            invNorm = gallery.ActiveQuantizedInvNorm(subjectIndex, probe_has_mask);
+        } while (!gallery.EndRead(subjectIndex, sequence));
+
+        float cosine = static_cast<float>(corr) * invNorm * scale;
+        cosine = std::max(-static_cast<float>(RSID_MATCHER_COARSE_SCORE_SCALE),
+                          std::min(static_cast<float>(RSID_MATCHER_COARSE_SCORE_SCALE), cosine));
+        match_calc_t coarseScore = static_cast<match_calc_t>(std::lround(cosine));
+
+        if (coarseScore > maxScore)
+        {
+            maxScore = coarseScore;
+            maxSubject = subjectIndex;
+        }
+
+        if (candidates)
+        {
+            candidates->Insert(subjectIndex, coarseScore);
+        }
     }
 
     result.score = maxScore;
@@ -241,7 +569,8 @@ bool Matcher::GetScores(const MatchElement& probe_faceprints, const std::vector<
 }
 
 void Matcher::FaceMatch(const MatchElement& probe_faceprints, const std::vector<UserFaceprints_t>& existing_faceprints_array,
-                        ExtendedMatchResult& result, const bool& probe_has_mask)
+                        ExtendedMatchResult& result, const bool& probe_has_mask, const unsigned int num_threads,
+                        TopKCandidates* candidates)
 {
     result.isSame = false;
     result.maxScore = 0;
@@ -250,7 +579,7 @@ void Matcher::FaceMatch(const MatchElement& probe_faceprints, const std::vector<
 
     TagResult scoresResult;
     // this function returns the index and info of the best score winner in the array.
-    bool isScoreSuccess = GetScores(probe_faceprints, existing_faceprints_array, scoresResult, probe_has_mask);
+    bool isScoreSuccess = GetScores(probe_faceprints, existing_faceprints_array, scoresResult, probe_has_mask, num_threads, candidates);
 
     if (!isScoreSuccess)
     {
@@ -327,8 +656,28 @@ ExtendedMatchResult Matcher::MatchFaceprintsToArray(const MatchElement& probe_fa
 ExtendedMatchResult Matcher::MatchFaceprintsToArray(const MatchElement& probe_faceprints,
                                                     const std::vector<UserFaceprints_t>& existing_faceprints_array,
                                                     Faceprints& updated_faceprints, const Thresholds& thresholds)
+{
+    return MatchFaceprintsToArray(probe_faceprints, existing_faceprints_array, updated_faceprints, thresholds, 1);
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const MatchElement& probe_faceprints,
+                                                    const std::vector<UserFaceprints_t>& existing_faceprints_array,
+                                                    Faceprints& updated_faceprints, const Thresholds& thresholds,
+                                                    const unsigned int num_threads)
+{
+    std::vector<MatchCandidate> top_candidates;
+    return MatchFaceprintsToArray(probe_faceprints, existing_faceprints_array, updated_faceprints, thresholds, num_threads, 0,
+                                  top_candidates);
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToArray(const MatchElement& probe_faceprints,
+                                                    const std::vector<UserFaceprints_t>& existing_faceprints_array,
+                                                    Faceprints& updated_faceprints, const Thresholds& thresholds,
+                                                    const unsigned int num_threads, const size_t top_k,
+                                                    std::vector<MatchCandidate>& top_candidates)
 {
     ExtendedMatchResult result;
+    top_candidates.clear();
 
     result.userId = -1;
     result.maxScore = 0;
@@ -357,7 +706,12 @@ ExtendedMatchResult Matcher::MatchFaceprintsToArray(const MatchElement& probe_fa
     feature_t probeFaceFlags = probe_faceprints.data.featuresVector[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS];
     bool probe_has_mask = (probeFaceFlags == FaVectorFlagsEnum::VecFlagValidWithMask) ? true : false;
 
-    FaceMatch(probe_faceprints, existing_faceprints_array, result, probe_has_mask);
+    TopKCandidates candidates(top_k);
+    FaceMatch(probe_faceprints, existing_faceprints_array, result, probe_has_mask, num_threads, (top_k > 0) ? &candidates : nullptr);
+    if (result.userId >= 0)
+    {
+        top_candidates = candidates.Sorted();
+    }
 
     size_t user_index = (size_t)result.userId;
 
@@ -368,16 +722,317 @@ ExtendedMatchResult Matcher::MatchFaceprintsToArray(const MatchElement& probe_fa
         return result;
     }
 
+    ApplyMatchDecision(probe_faceprints, existing_faceprints_array[user_index].faceprints, probe_has_mask, thresholds, result,
+                       updated_faceprints);
+
+    return result;
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToGallery(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints, const ThresholdsConfidenceEnum confidenceLevel)
+{
+    Thresholds thresholds;
+    SetToDefaultThresholds(thresholds, confidenceLevel);
+
+    return MatchFaceprintsToGallery(probe_faceprints, gallery, updated_faceprints, thresholds);
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToGallery(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints, const Thresholds& thresholds)
+{
+    return MatchFaceprintsToGallery(probe_faceprints, gallery, updated_faceprints, thresholds, 1);
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToGallery(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints, const Thresholds& thresholds,
+                                                      const unsigned int num_threads)
+{
+    std::vector<MatchCandidate> top_candidates;
+    return MatchFaceprintsToGallery(probe_faceprints, gallery, updated_faceprints, thresholds, num_threads, 0, top_candidates);
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToGallery(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints, const Thresholds& thresholds,
+                                                      const unsigned int num_threads, const size_t top_k,
+                                                      std::vector<MatchCandidate>& top_candidates)
+{
+    ExtendedMatchResult result;
+    top_candidates.clear();
+
+    result.userId = -1;
+    result.maxScore = 0;
+
+    if (!CheckGalleryMatch(probe_faceprints, gallery))
+    {
+        return result;
+    }
+
+    feature_t probeFaceFlags = probe_faceprints.data.featuresVector[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS];
+    bool probe_has_mask = (probeFaceFlags == FaVectorFlagsEnum::VecFlagValidWithMask) ? true : false;
+
+    TagResult scoresResult;
+    TopKCandidates candidates(top_k);
+    if (!GetScores(probe_faceprints, gallery, scoresResult, probe_has_mask, num_threads, (top_k > 0) ? &candidates : nullptr))
+    {
+        LOG_ERROR(LOG_TAG, "Failed during GetScores() - please check.");
+        return result;
+    }
+    top_candidates = candidates.Sorted();
+
+    result.maxScore = scoresResult.score;
+    result.userId = scoresResult.idx;
+
+    size_t user_index = (size_t)result.userId;
+
+    // if no user matched, finish here and return.
+    if (user_index >= gallery.Size())
+    {
+        LOG_ERROR(LOG_TAG, "Invalid user_index : Skipping function.");
+        return result;
+    }
+
+    // consistent copy, in case the user is updated concurrently.
+    Faceprints matched_faceprints;
+    gallery.ReadFaceprints(user_index, matched_faceprints);
+
+    ApplyMatchDecision(probe_faceprints, matched_faceprints, probe_has_mask, thresholds, result, updated_faceprints);
+
+    return result;
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToGallery(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery,
+                                                      Faceprints& updated_faceprints, const Thresholds& thresholds,
+                                                      MatchResultCache& cache, const unsigned int num_threads)
+{
+    size_t cached_index = 0;
+    if (cache.Lookup(gallery, thresholds, cached_index) && CheckGalleryMatch(probe_faceprints, gallery))
+    {
+        feature_t probeFaceFlags = probe_faceprints.data.featuresVector[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS];
+        bool probe_has_mask = (probeFaceFlags == FaVectorFlagsEnum::VecFlagValidWithMask) ? true : false;
+
+        ExtendedMatchResult result;
+        Faceprints matched_faceprints;
+        uint32_t sequence;
+        if (ScoreCachedUser(probe_faceprints, gallery, cached_index, probe_has_mask, thresholds, cache.ScoreMargin(), result,
+                            matched_faceprints, sequence))
+        {
+            ApplyMatchDecision(probe_faceprints, matched_faceprints, probe_has_mask, thresholds, result, updated_faceprints);
+            return result;
+        }
+    }
+
+    ExtendedMatchResult result = MatchFaceprintsToGallery(probe_faceprints, gallery, updated_faceprints, thresholds, num_threads);
+    if (result.isSame)
+    {
+        cache.Store(gallery, thresholds, static_cast<size_t>(result.userId));
+    }
+    else
+    {
+        cache.Invalidate();
+    }
+
+    return result;
+}
+
+bool Matcher::ScoreCachedUser(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery, const size_t cached_index,
+                              const bool probe_has_mask, const Thresholds& thresholds, const match_calc_t score_margin,
+                              ExtendedMatchResult& result, Faceprints& matched_faceprints, uint32_t& sequence)
+{
+    const uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES;
+    const MatcherKernels::DotFn dot = MatcherKernels::Active(vec_length).dot;
+    const feature_t* probeVector = &probe_faceprints.data.featuresVector[0];
+    const NccNorm probeNorm = ComputeNccNorm(probeVector, vec_length);
+
+    result = ExtendedMatchResult();
+    result.userId = static_cast<int>(cached_index);
+
+    // score and faceprints of the same version of the user, in case it's updated concurrently.
+    do
+    {
+        sequence = gallery.BeginRead(cached_index);
+        int32_t corr = dot(probeVector, gallery.ActiveVector(cached_index, probe_has_mask), vec_length);
+        result.maxScore = ComputeNccGrade(corr, probeNorm, gallery.ActiveNorm(cached_index, probe_has_mask));
+        ::memcpy(&matched_faceprints, &gallery.GetFaceprints(cached_index), sizeof(Faceprints));
+    } while (!gallery.EndRead(cached_index, sequence));
+
     AdaptiveThresholds adaptiveThresholds;
+    DecideMatch(matched_faceprints, probe_has_mask, thresholds, result, adaptiveThresholds);
+    return result.isSame && result.maxScore >= adaptiveThresholds.activeStrongThreshold + score_margin;
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToGalleryCoarseToFine(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery,
+                                                                  Faceprints& updated_faceprints, const Thresholds& thresholds,
+                                                                  const size_t shortlist_size, const unsigned int num_threads)
+{
+    if (!gallery.HasQuantizedTier() || shortlist_size == 0)
+    {
+        LOG_DEBUG(LOG_TAG, "No quantized tier or empty shortlist - using exact scan.");
+        return MatchFaceprintsToGallery(probe_faceprints, gallery, updated_faceprints, thresholds, num_threads);
+    }
+
+    ExtendedMatchResult result;
+
+    result.userId = -1;
+    result.maxScore = 0;
+
+    if (!CheckGalleryMatch(probe_faceprints, gallery))
+    {
+        return result;
+    }
+
+    feature_t probeFaceFlags = probe_faceprints.data.featuresVector[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS];
+    bool probe_has_mask = (probeFaceFlags == FaVectorFlagsEnum::VecFlagValidWithMask) ? true : false;
+
+    TopKCandidates shortlist(shortlist_size);
+    if (!GetCoarseCandidates(probe_faceprints, gallery, probe_has_mask, num_threads, shortlist))
+    {
+        LOG_ERROR(LOG_TAG, "Failed during GetCoarseCandidates() - please check.");
+        return result;
+    }
+
+    // exact re-rank of the shortlist, with the same score and tie rule (lowest index) as the exact scan.
+    const uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES;
+    const feature_t* probeVector = &probe_faceprints.data.featuresVector[0];
+    const NccNorm probeNorm = ComputeNccNorm(probeVector, vec_length);
+    const MatcherKernels::DotFn dot = MatcherKernels::Active(vec_length).dot;
+
+    MatchCandidate best;
+    best.score = -1;
+    for (const auto& candidate : shortlist.Sorted())
+    {
+        size_t subjectIndex = static_cast<size_t>(candidate.userId);
+
+        MatchCandidate exact;
+        exact.userId = candidate.userId;
+        uint32_t sequence;
+        do
+        {
+            sequence = gallery.BeginRead(subjectIndex);
+            int32_t corr = dot(probeVector, gallery.ActiveVector(subjectIndex, probe_has_mask), vec_length);
+            exact.score = ComputeNccGrade(corr, probeNorm, gallery.ActiveNorm(subjectIndex, probe_has_mask));
+        } while (!gallery.EndRead(subjectIndex, sequence));
+        if (IsBetterCandidate(exact, best))
+        {
+            best = exact;
+        }
+    }
+
+    result.maxScore = best.score;
+    result.userId = best.userId;
+
+    size_t user_index = (size_t)result.userId;
+
+    // if no user matched, finish here and return.
+    if (user_index >= gallery.Size())
+    {
+        LOG_ERROR(LOG_TAG, "Invalid user_index : Skipping function.");
+        return result;
+    }
+
+    // consistent copy, in case the user is updated concurrently.
+    Faceprints matched_faceprints;
+    gallery.ReadFaceprints(user_index, matched_faceprints);
+
+    ApplyMatchDecision(probe_faceprints, matched_faceprints, probe_has_mask, thresholds, result, updated_faceprints);
+
+    return result;
+}
+
+ExtendedMatchResult Matcher::MatchFaceprintsToIndex(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery,
+                                                    const FaceprintsIvfIndex& index, Faceprints& updated_faceprints,
+                                                    const Thresholds& thresholds, const size_t nprobe)
+{
+    if (!index.IsTrained())
+    {
+        LOG_DEBUG(LOG_TAG, "Index is not trained - using exact scan.");
+        return MatchFaceprintsToGallery(probe_faceprints, gallery, updated_faceprints, thresholds);
+    }
+
+    ExtendedMatchResult result;
+
+    result.userId = -1;
+    result.maxScore = 0;
+
+    if (!CheckGalleryMatch(probe_faceprints, gallery))
+    {
+        return result;
+    }
+
+    feature_t probeFaceFlags = probe_faceprints.data.featuresVector[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS];
+    bool probe_has_mask = (probeFaceFlags == FaVectorFlagsEnum::VecFlagValidWithMask) ? true : false;
+
+    TagResult scoresResult;
+    if (!index.Search(probe_faceprints, gallery, probe_has_mask, nprobe, scoresResult, nullptr))
+    {
+        LOG_ERROR(LOG_TAG, "Failed during index Search() - please check.");
+        return result;
+    }
+
+    result.maxScore = scoresResult.score;
+    result.userId = scoresResult.idx;
+
+    size_t user_index = (size_t)result.userId;
+
+    // if no user matched (e.g. the scanned lists are empty), finish here and return.
+    if (user_index >= gallery.Size())
+    {
+        LOG_ERROR(LOG_TAG, "Invalid user_index : Skipping function.");
+        return result;
+    }
+
+    // consistent copy, in case the user is updated concurrently.
+    Faceprints matched_faceprints;
+    gallery.ReadFaceprints(user_index, matched_faceprints);
+
+    ApplyMatchDecision(probe_faceprints, matched_faceprints, probe_has_mask, thresholds, result, updated_faceprints);
+
+    return result;
+}
+
+bool Matcher::CheckGalleryMatch(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery)
+{
+    if (!ValidateFaceprints(probe_faceprints))
+    {
+        LOG_ERROR(LOG_TAG, "Faceprints vector failed range validation.");
+        return false;
+    }
+
+    if (gallery.Empty())
+    {
+        LOG_ERROR(LOG_TAG, "Faceprints gallery size is 0.");
+        return false;
+    }
+
+    // the gallery users were validated when added, so only the probe version is checked against theirs.
+    int galleryVersion = 0;
+    if (!gallery.CommonVersion(galleryVersion) || probe_faceprints.data.version != galleryVersion)
+    {
+        LOG_ERROR(LOG_TAG, "version mismatch between 2 vectors. Skipping this match()!");
+        return false;
+    }
+
+    return true;
+}
+
+void Matcher::DecideMatch(const Faceprints& matched_faceprints, const bool probe_has_mask, const Thresholds& thresholds,
+                          ExtendedMatchResult& result, AdaptiveThresholds& adaptiveThresholds)
+{
     InitAdaptiveThresholds(thresholds, adaptiveThresholds);
 
     // here we handle with/without mask adaptive learning.
     // we choose the correct thresholds Configuration, based on the probe-vector and the (matched) gallery-vector.
-    HandleThresholdsConfiguration(probe_has_mask, existing_faceprints_array[user_index].faceprints, adaptiveThresholds);
+    HandleThresholdsConfiguration(probe_has_mask, matched_faceprints, adaptiveThresholds);
 
     // here correct active thresholds set correctly, so we can use them.
     result.isSame = (result.maxScore > adaptiveThresholds.activeStrongThreshold);
     result.should_update = (result.maxScore >= adaptiveThresholds.activeUpdateThreshold) && result.isSame;
+}
+
+void Matcher::ApplyMatchDecision(const MatchElement& probe_faceprints, const Faceprints& matched_faceprints, const bool probe_has_mask,
+                                 const Thresholds& thresholds, ExtendedMatchResult& result, Faceprints& updated_faceprints)
+{
+    AdaptiveThresholds adaptiveThresholds;
+    DecideMatch(matched_faceprints, probe_has_mask, thresholds, result, adaptiveThresholds);
 
     // Does the DB entry of the user is RGB type ?
     // bool isEnrolledTypeInDbIsRgb = (FaceprintsTypeEnum::RGB ==
@@ -390,7 +1045,7 @@ ExtendedMatchResult Matcher::MatchFaceprintsToArray(const MatchElement& probe_fa
     {
         // Init updated_faceprints to the faceprints already exists in the DB
         //
-        updated_faceprints = existing_faceprints_array[user_index].faceprints;
+        updated_faceprints = matched_faceprints;
 
         const uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES;
         const feature_t* probeVector = &probe_faceprints.data.featuresVector[0];
@@ -454,8 +1109,6 @@ ExtendedMatchResult Matcher::MatchFaceprintsToArray(const MatchElement& probe_fa
               "activeThreshConfig: %d, confidenceLevel: %d.",
               result.maxScore, result.isSame, result.should_update, probe_has_mask, adaptiveThresholds.activeStrongThreshold,
               adaptiveThresholds.activeUpdateThreshold, adaptiveThresholds.activeConfig, adaptiveThresholds.thresholds.confidenceLevel);
-
-    return result;
 }
 
 bool Matcher::LimitAdaptiveVector(feature_t* adaptive_faceprints_vec, const feature_t* anchor_faceprints_vec,
@@ -476,6 +1129,11 @@ bool Matcher::LimitAdaptiveVector(feature_t* adaptive_faceprints_vec, const feat
     match_calc_t match_score = 0;
     MatchTwoVectors(adaptive_faceprints_vec, anchor_faceprints_vec, &match_score, vec_length);
 
+    // each iteration blends and scores in a single pass (MatchTwoVectors() scores 0 for vectors longer than 512).
+    const MatcherKernels::KernelTable& kernels = MatcherKernels::Active(vec_length);
+    const bool valid_length = (vec_length <= 512);
+    MatcherKernels::NccSums sums;
+
 #if (RSID_MATCHER_DEBUG_LOGS)
     LOG_DEBUG(LOG_TAG, "----> match score (adaptive vs. anchor) = %d.", match_score);
 #endif
@@ -484,11 +1142,7 @@ bool Matcher::LimitAdaptiveVector(feature_t* adaptive_faceprints_vec, const feat
     // deadlock here.
     uint32_t cnt_iter = 0;
 
-    uint32_t limit_num_iters = static_cast<uint32_t>(RSID_LIMIT_NUM_ITERS_NM);
-    if (adaptiveThresholds.activeConfig != ThresholdsConfigEnum::ThresholdConfig_pNM_gNM)
-    {
-        limit_num_iters = static_cast<uint32_t>(RSID_LIMIT_NUM_ITERS_M);
-    }
+    const uint32_t limit_num_iters = LimitNumIters(adaptiveThresholds.activeConfig);
 
     while ((match_score < adaptiveThresholds.activeIdenticalThreshold))
     {
@@ -497,11 +1151,25 @@ bool Matcher::LimitAdaptiveVector(feature_t* adaptive_faceprints_vec, const feat
                   match_score);
 #endif
 
-        BlendAverageVector(adaptive_faceprints_vec, anchor_faceprints_vec, vec_length);
+        bool changed = kernels.blend_ncc_sums(adaptive_faceprints_vec, anchor_faceprints_vec, vec_length, sums);
 
-        MatchTwoVectors(adaptive_faceprints_vec, anchor_faceprints_vec, &match_score, vec_length);
+        match_score = valid_length ? ComputeNccGrade(sums.corr, sums.norm1, sums.norm2) : 0;
 
         cnt_iter++;
+
+        // the blend reached its fixed point (e.g. it converged, or one vector is all zeros): the vector and its score
+        // won't change anymore, so the loop can only end at the limit - with this same vector and score.
+        if (!changed)
+        {
+#if (RSID_MATCHER_DEBUG_LOGS)
+            LOG_DEBUG(LOG_TAG, "----> Update while() loop reached a fixed point after %d iterations with score = %d.", cnt_iter,
+                      match_score);
+#endif
+
+            success = false;
+            break;
+        }
+
         if (cnt_iter > limit_num_iters)
         {
 #if (RSID_MATCHER_DEBUG_LOGS)
@@ -588,17 +1256,20 @@ MatchResultInternal Matcher::MatchFaceprints(const MatchElement& probe_faceprint
 //
 bool Matcher::ValidateVector(const feature_t* vec, const uint32_t vec_length)
 {
+    // branch free min/max reduction (vectorized by the compiler): valid vectors are checked to the end anyway, and this
+    // check runs for every user of an array scan.
+    feature_t min_feature = 0;
+    feature_t max_feature = 0;
+
     for (uint32_t i = 0; i < vec_length; i++)
     {
         feature_t curr_feature = (feature_t)vec[i];
 
-        if (curr_feature > s_maxFeatureValue || curr_feature < s_minFeatureValue)
-        {
-            return false;
-        }
+        min_feature = (curr_feature < min_feature) ? curr_feature : min_feature;
+        max_feature = (curr_feature > max_feature) ? curr_feature : max_feature;
     }
 
-    return true;
+    return (max_feature <= s_maxFeatureValue) && (min_feature >= s_minFeatureValue);
 }
 
 void Matcher::BlendAverageVector(feature_t* user_adaptive_faceprints, const feature_t* user_probe_faceprints, const uint32_t vec_length)
@@ -621,22 +1292,9 @@ void Matcher::BlendAverageVector(feature_t* user_adaptive_faceprints, const feat
         return;
     }
 
-    int history_weight = RSID_UPDATE_GALLERY_HISTORY_WEIGHT;
-    int round_value = (history_weight + 1);
-    for (uint32_t i = 0; i < vec_length; ++i)
-    {
-        int32_t v = static_cast<int32_t>(user_adaptive_faceprints[i]);
-        v *= 2 * history_weight;
-        v += 2 * (int)(user_probe_faceprints[i]);
-        v = (v >= 0) ? (v + round_value) : (v - round_value);
-        v /= (2 * round_value);
-
-        short feature_value = static_cast<short>(v);
-        feature_value = (feature_value > s_maxFeatureValue) ? s_maxFeatureValue : feature_value;
-        feature_value = (feature_value < s_minFeatureValue) ? s_minFeatureValue : feature_value;
-
-        user_adaptive_faceprints[i] = static_cast<short>(v);
-    }
+    // the blend is dispatched to the best simd kernel (see MatcherKernels.cc), bit-identical to the scalar formula above.
+    // the blended value is not clamped: the blend of two in-range vectors is in range.
+    MatcherKernels::Active(vec_length).blend(user_adaptive_faceprints, user_probe_faceprints, vec_length);
 }
 
 short Matcher::GetMsb(const uint32_t ux)
@@ -649,6 +1307,10 @@ short Matcher::GetMsb(const uint32_t ux)
     // method - we check the range of x in a binary-search manner.
     // note that we basically compute here msb = floor(log2(x))+1.
     //
+#if defined(__GNUC__) || defined(__clang__)
+    // single instruction (lzcnt/bsr) where the compiler has it.
+    return static_cast<short>((ux == 0) ? 0 : 32 - __builtin_clz(ux));
+#else
     uint32_t x = ux;
     uint32_t shift = 0;
     uint32_t msb = 0;
@@ -670,6 +1332,7 @@ short Matcher::GetMsb(const uint32_t ux)
     msb = (ux == 0) ? 0 : (msb + 1);
 
     return static_cast<short>(msb);
+#endif
 }
 
 void Matcher::MatchTwoVectors(const feature_t* T1, const feature_t* T2, match_calc_t* match_score, const uint32_t vec_length)
@@ -707,33 +1370,65 @@ void Matcher::MatchTwoVectors(const feature_t* T1, const feature_t* T2, match_ca
         return;
     }
 
-    uint32_t nfeatures = vec_length;
+    // the accumulation loop is dispatched to the best simd kernel supported by the cpu (see MatcherKernels.cc).
+    // all kernels return bit-identical sums to the scalar loop.
+    MatcherKernels::NccSums sums;
+    MatcherKernels::Active(vec_length).ncc_sums(T1, T2, vec_length, sums);
 
-    int32_t corr = 0;
-    int32_t min_corr = 0;
-    uint32_t ucorr = 0;
-    uint32_t norm1 = 0;
-    uint32_t norm2 = 0;
+    *match_score = ComputeNccGrade(sums.corr, sums.norm1, sums.norm2);
+}
 
-    for (uint32_t i = 0; i < nfeatures; ++i)
-    {
-        int32_t t1 = static_cast<int32_t>(T1[i]);
-        int32_t t2 = static_cast<int32_t>(T2[i]);
+NccNorm Matcher::MakeNccNorm(uint32_t norm)
+{
+    NccNorm ncc_norm;
 
-        corr += t1 * t2;
-        norm1 += t1 * t1;
-        norm2 += t2 * t2;
-    }
+    // protect division by 0.
+    ncc_norm.norm = (norm == 0) ? 1 : norm;
+    ncc_norm.msb = GetMsb(ncc_norm.norm);
+
+    // reciprocal of the norm for NccNorm::Divide(), with l = ceil(log2(norm)) (the msb of norm - 1):
+    // magic = floor(2^32 * (2^l - norm) / norm) + 1, shift1 = min(l, 1), shift2 = max(l - 1, 0).
+    const uint32_t l = static_cast<uint32_t>(GetMsb(ncc_norm.norm - 1));
+    const uint64_t two_pow_l = static_cast<uint64_t>(1) << l;
+    ncc_norm.magic = static_cast<uint32_t>(((two_pow_l - ncc_norm.norm) << 32) / ncc_norm.norm + 1);
+    ncc_norm.shift1 = static_cast<uint8_t>(std::min<uint32_t>(l, 1));
+    ncc_norm.shift2 = static_cast<uint8_t>((l > 0) ? l - 1 : 0);
+
+    return ncc_norm;
+}
+
+NccNorm Matcher::ComputeNccNorm(const feature_t* vec, const uint32_t vec_length)
+{
+    return MakeNccNorm(static_cast<uint32_t>(MatcherKernels::Active(vec_length).dot(vec, vec, vec_length)));
+}
 
+match_calc_t Matcher::ComputeNccGrade(const int32_t corr, uint32_t norm1, uint32_t norm2)
+{
     // protect division by 0.
     norm1 = (norm1 == 0) ? 1 : norm1;
     norm2 = (norm2 == 0) ? 1 : norm2;
 
+    return NccGrade(
+        corr, GetMsb(norm1), GetMsb(norm2), [norm1](uint32_t n) { return n / norm1; }, [norm2](uint32_t n) { return n / norm2; });
+}
+
+match_calc_t Matcher::ComputeNccGrade(const int32_t corr, const NccNorm& ncc_norm1, const NccNorm& ncc_norm2)
+{
+    // the cached reciprocals of the norms instead of two divisions.
+    return NccGrade(
+        corr, ncc_norm1.msb, ncc_norm2.msb, [&ncc_norm1](uint32_t n) { return ncc_norm1.Divide(n); },
+        [&ncc_norm2](uint32_t n) { return ncc_norm2.Divide(n); });
+}
+
+template <typename Divide1, typename Divide2>
+match_calc_t Matcher::NccGrade(const int32_t corr, short norm1_msb, short norm2_msb, Divide1 divide1, Divide2 divide2)
+{
+    int32_t min_corr = 0;
+    uint32_t ucorr = 0;
+
     // negative correlation will be considered as 0 correlation.
     ucorr = static_cast<uint32_t>(std::max(corr, min_corr));
 
-    short norm1_msb = GetMsb(norm1);
-    short norm2_msb = GetMsb(norm2);
     short corr_msb = GetMsb(ucorr);
     int32_t min_shift = 0;
 
@@ -746,8 +1441,8 @@ void Matcher::MatchTwoVectors(const feature_t* T1, const feature_t* T2, match_ca
     short total_shift = static_cast<short>(shift1 + shift2);
     short shift_back = static_cast<short>(total_shift - 12);
 
-    uint32_t norm_corr1 = (ucorr << shift1) / norm1;
-    uint32_t norm_corr2 = (ucorr << shift2) / norm2;
+    uint32_t norm_corr1 = divide1(ucorr << shift1);
+    uint32_t norm_corr2 = divide2(ucorr << shift2);
     uint32_t similarity = norm_corr1 * norm_corr2;
 
     uint32_t grade = 0;
@@ -763,7 +1458,7 @@ void Matcher::MatchTwoVectors(const feature_t* T1, const feature_t* T2, match_ca
 
     // LOG_DEBUG(LOG_TAG, "ncc result: -----> grade = %u", grade);
 
-    *match_score = static_cast<match_calc_t>(grade);
+    return static_cast<match_calc_t>(grade);
 }
 
 } // namespace RealSenseID
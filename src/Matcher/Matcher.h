@@ -3,6 +3,7 @@
 
 #pragma once
 #include "MatcherImplDefines.h"
+#include "MatchCandidates.h"
 #include "RealSenseID/Faceprints.h"
 #include "RealSenseID/MatcherDefines.h"
 #include <vector>
@@ -10,10 +11,43 @@
 
 namespace RealSenseID
 {
+class FaceprintsGallery;
+class FaceprintsIvfIndex;
+class ConcurrentFaceprintsGallery;
+class MatchResultCache;
 
 // using feature_t = short;
 using match_calc_t = short;
 
+// squared norm of a vector as used by the ncc grade (0 is replaced by 1), and its msb (see Matcher::GetMsb()).
+// can be computed once per vector and re-used across many matches.
+// the grade divides by the norm: magic, shift1 and shift2 are its exact reciprocal (see Matcher::MakeNccNorm()), so the
+// division is a multiply and shifts.
+struct NccNorm
+{
+    uint32_t norm = 1;
+    uint32_t magic = 1;
+    short msb = 1;
+    uint8_t shift1 = 0;
+    uint8_t shift2 = 0;
+
+    // n / norm, exact for every 32 bit n (Granlund & Montgomery, "Division by invariant integers using
+    // multiplication", figure 4.1).
+    uint32_t Divide(const uint32_t n) const
+    {
+        const uint32_t t = static_cast<uint32_t>((static_cast<uint64_t>(magic) * n) >> 32);
+        return (t + ((n - t) >> shift1)) >> shift2;
+    }
+};
+
+// pair of gallery users (first < second) and the ncc score of their no-mask vectors (see Matcher::FindNearDuplicates()).
+struct NearDuplicatePair
+{
+    int first = -1;
+    int second = -1;
+    match_calc_t score = 0;
+};
+
 class Matcher
 {
 public:
@@ -38,6 +72,105 @@ public:
                                                       const std::vector<UserFaceprints_t>& existing_faceprints_array,
                                                       Faceprints& updated_faceprints, const Thresholds& thresholds);
 
+    // same as above, but the array is scanned in parallel by num_threads threads (0 - number of hardware threads).
+    // the array is split to cache sized shards. the result is identical to the single threaded scan (ties resolve to
+    // the lowest index). small arrays are scanned on the calling thread only.
+    static ExtendedMatchResult MatchFaceprintsToArray(const MatchElement& probe_faceprints,
+                                                      const std::vector<UserFaceprints_t>& existing_faceprints_array,
+                                                      Faceprints& updated_faceprints, const Thresholds& thresholds,
+                                                      const unsigned int num_threads);
+
+    // same as above, and also returns the top_k best (index, score) candidates in top_candidates (best first), e.g. for
+    // secondary verification. each thread keeps a bounded heap, so small k (<= 32) costs about the same as the
+    // single best scan. the decision (isSame, should_update, updated_faceprints) is made for the best candidate.
+    static ExtendedMatchResult MatchFaceprintsToArray(const MatchElement& probe_faceprints,
+                                                      const std::vector<UserFaceprints_t>& existing_faceprints_array,
+                                                      Faceprints& updated_faceprints, const Thresholds& thresholds,
+                                                      const unsigned int num_threads, const size_t top_k,
+                                                      std::vector<MatchCandidate>& top_candidates);
+
+    // match single vs. a FaceprintsGallery (packed, structure-of-arrays users layout). Same results as
+    // MatchFaceprintsToArray() on the same users, but with much less memory traffic per probe.
+    // returns updated faceprints if update conditions fulfilled (indicated in result.should_update). it's up to the
+    // caller to write them back to the gallery (FaceprintsGallery::Update()).
+    static ExtendedMatchResult MatchFaceprintsToGallery(
+        const MatchElement& probe_faceprints, const FaceprintsGallery& gallery, Faceprints& updated_faceprints,
+        const ThresholdsConfidenceEnum confidenceLevel = ThresholdsConfidenceEnum::ThresholdsConfidenceLevel_High);
+
+    static ExtendedMatchResult MatchFaceprintsToGallery(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery,
+                                                        Faceprints& updated_faceprints, const Thresholds& thresholds);
+
+    // multi-threaded gallery scan (see the multi-threaded MatchFaceprintsToArray() above).
+    static ExtendedMatchResult MatchFaceprintsToGallery(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery,
+                                                        Faceprints& updated_faceprints, const Thresholds& thresholds,
+                                                        const unsigned int num_threads);
+
+    // multi-threaded gallery scan with top-k candidates (see MatchFaceprintsToArray() above).
+    static ExtendedMatchResult MatchFaceprintsToGallery(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery,
+                                                        Faceprints& updated_faceprints, const Thresholds& thresholds,
+                                                        const unsigned int num_threads, const size_t top_k,
+                                                        std::vector<MatchCandidate>& top_candidates);
+
+    // gallery scan for a stream of probes of (usually) the same person, e.g. during an authentication loop. the probe
+    // is first scored against the user last accepted through the cache: if it's accepted with a score at least
+    // cache.ScoreMargin() above the strong threshold, that user is the result (O(1), no scan). otherwise the gallery is
+    // scanned, and an accepted user is stored in the cache. a cached result can differ from the scan only if another
+    // user scores even higher than a far above threshold score of the cached user.
+    static ExtendedMatchResult MatchFaceprintsToGallery(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery,
+                                                        Faceprints& updated_faceprints, const Thresholds& thresholds,
+                                                        MatchResultCache& cache, const unsigned int num_threads = 1);
+
+    // two stage match vs. a FaceprintsGallery with an int8 quantized tier (FaceprintsGallery::SetQuantizedTier()).
+    // a coarse scan of the quantized rows keeps the shortlist_size users with best approximated score, which are then
+    // re-scored exactly; the best of them goes through the same thresholds decision and adaptive update as in
+    // MatchFaceprintsToGallery(). the result is identical to the exact scan whenever the exact best user made it to the
+    // shortlist - shortlist_size trades recall for latency.
+    // falls back to the exact scan if the gallery has no quantized tier.
+    static ExtendedMatchResult MatchFaceprintsToGalleryCoarseToFine(const MatchElement& probe_faceprints,
+                                                                    const FaceprintsGallery& gallery, Faceprints& updated_faceprints,
+                                                                    const Thresholds& thresholds, const size_t shortlist_size,
+                                                                    const unsigned int num_threads = 1);
+
+    // approximate match vs. a FaceprintsGallery using its ivf index (FaceprintsIvfIndex): only the users of the nprobe
+    // lists nearest to the probe are scored, with the exact score. the best of them goes through the same thresholds
+    // decision and adaptive update as in MatchFaceprintsToGallery(), so the accept decision is unchanged - a user is
+    // only missed if it's not in the scanned lists. nprobe trades recall for latency.
+    // falls back to the exact scan if the index isn't trained.
+    static ExtendedMatchResult MatchFaceprintsToIndex(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery,
+                                                      const FaceprintsIvfIndex& index, Faceprints& updated_faceprints,
+                                                      const Thresholds& thresholds, const size_t nprobe);
+
+    // match many probes vs. a FaceprintsGallery (e.g. re-identification after thresholds change, audits).
+    // returns one result per probe (userId -1 if the probe failed validation). isSame and should_update are set like
+    // in MatchFaceprintsToGallery(), but no adaptive update is made (the gallery is read only here).
+    // the probes and gallery are cache-blocked, so the gallery is streamed from memory once per block of probes.
+    // the gallery must not be updated while the batch runs (see FaceprintsGallery).
+    static std::vector<ExtendedMatchResult> MatchBatch(
+        const std::vector<MatchElement>& probes, const FaceprintsGallery& gallery,
+        const ThresholdsConfidenceEnum confidenceLevel = ThresholdsConfidenceEnum::ThresholdsConfidenceLevel_High);
+
+    static std::vector<ExtendedMatchResult> MatchBatch(const std::vector<MatchElement>& probes, const FaceprintsGallery& gallery,
+                                                       const Thresholds& thresholds);
+
+    // same as above, and also returns the top_k best candidates of each probe (best first) in top_candidates.
+    static std::vector<ExtendedMatchResult> MatchBatch(const std::vector<MatchElement>& probes, const FaceprintsGallery& gallery,
+                                                       const Thresholds& thresholds, const size_t top_k,
+                                                       std::vector<std::vector<MatchCandidate>>& top_candidates);
+
+    // all the pairs of gallery users whose no-mask vectors score at least threshold (e.g. identicalThreshold_gNMgNM),
+    // best first - e.g. to find the same person enrolled under two ids before bulk loading users. the all pairs scan
+    // is cache-blocked and split over num_threads threads (0 - number of hardware threads).
+    // returns no pairs if the gallery users mix faceprints versions. the gallery must not be updated while the scan runs.
+    static std::vector<NearDuplicatePair> FindNearDuplicates(const FaceprintsGallery& gallery, const match_calc_t threshold,
+                                                             const unsigned int num_threads = 0);
+
+    // same as above, but each pair is first scored on the int8 quantized tier (FaceprintsGallery::SetQuantizedTier()),
+    // and only pairs whose approximated score is at most coarse_margin below threshold are scored exactly. reported
+    // scores are exact, but a pair is missed if its approximated score is off by more than coarse_margin.
+    // falls back to the exact scan if the gallery has no quantized tier.
+    static std::vector<NearDuplicatePair> FindNearDuplicatesCoarseToFine(
+        const FaceprintsGallery& gallery, const match_calc_t threshold,
+        const match_calc_t coarse_margin = RSID_MATCHER_DUPLICATES_COARSE_MARGIN, const unsigned int num_threads = 0);
 
     // checks the faceprints vector coordinates are in valid range [-1023,+1023].
     // if check_enrollment_vector=false it validates the adaptive faceprints, otherwise it validates the enrollment
@@ -49,7 +182,24 @@ public:
     static void MatchTwoVectors(const feature_t* T1, const feature_t* T2, match_calc_t* match_score,
                                 const uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES);
 
+    // ncc norm of a single vector. with cached norms, a match only needs the correlation of the two vectors:
+    // ComputeNccGrade(corr, norm1, norm2) gives the same score as MatchTwoVectors().
+    static NccNorm ComputeNccNorm(const feature_t* vec, const uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES);
+
+    static match_calc_t ComputeNccGrade(const int32_t corr, const NccNorm& ncc_norm1, const NccNorm& ncc_norm2);
+
+    // ncc norm of a squared norm (e.g. a dot product of a vector with itself).
+    static NccNorm MakeNccNorm(uint32_t norm);
+
+    // the default thresholds of the confidence level.
+    static void SetToDefaultThresholds(Thresholds& thresholds, const ThresholdsConfidenceEnum confidenceLevel);
+
 private:
+    // composes the scan and match decision steps around its lock free read section.
+    friend class ConcurrentFaceprintsGallery;
+    // evaluates the default thresholds sets and the per configuration strong thresholds.
+    friend class ThresholdSweep;
+
     static void BlendAverageVector(feature_t* user_adaptive_faceprints, const feature_t* user_probe_faceprints,
                                    const uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES);
 
@@ -63,11 +213,60 @@ private:
 
     static short GetMsb(const uint32_t ux);
 
+    // integer ncc grade in range [0, 4096] from the raw correlation and squared norms of two vectors.
+    // divides by the norms (a reciprocal only pays off for norms cached with it, see NccNorm).
+    static match_calc_t ComputeNccGrade(const int32_t corr, uint32_t norm1, uint32_t norm2);
+
+    // the grade computation of both ComputeNccGrade(): divide1(n) and divide2(n) return n / norm1 and n / norm2.
+    template <typename Divide1, typename Divide2>
+    static match_calc_t NccGrade(const int32_t corr, short norm1_msb, short norm2_msb, Divide1 divide1, Divide2 divide2);
+
     static void FaceMatch(const MatchElement& probe_faceprints, const std::vector<UserFaceprints_t>& existing_faceprints_array,
-                          ExtendedMatchResult& result, const bool& probe_has_mask);
+                          ExtendedMatchResult& result, const bool& probe_has_mask, const unsigned int num_threads = 1,
+                          TopKCandidates* candidates = nullptr);
 
     static bool GetScores(const MatchElement& probe_faceprints, const std::vector<UserFaceprints_t>& existing_faceprints_array,
-                          TagResult& result, const bool& probe_has_mask);
+                          TagResult& result, const bool& probe_has_mask, const unsigned int num_threads = 1,
+                          TopKCandidates* candidates = nullptr);
+
+    static bool GetScores(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery, TagResult& result,
+                          const bool& probe_has_mask, const unsigned int num_threads = 1, TopKCandidates* candidates = nullptr);
+
+    // best score of the users in range [begin, end). all scores are also inserted to candidates if not null.
+    static bool ScanScores(const MatchElement& probe_faceprints, const std::vector<UserFaceprints_t>& existing_faceprints_array,
+                           const size_t begin, const size_t end, TagResult& result, const bool& probe_has_mask,
+                           TopKCandidates* candidates);
+
+    static bool ScanScores(const MatchElement& probe_faceprints, const NccNorm& probeNorm, const FaceprintsGallery& gallery,
+                           const size_t begin, const size_t end, TagResult& result, const bool& probe_has_mask,
+                           TopKCandidates* candidates);
+
+    // common checks of a probe vs. gallery match (probe validation, non empty gallery, versions).
+    static bool CheckGalleryMatch(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery);
+
+    // coarse scan of the gallery quantized tier: keeps the best shortlist.K() users by approximated score.
+    static bool GetCoarseCandidates(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery, const bool& probe_has_mask,
+                                    const unsigned int num_threads, TopKCandidates& shortlist);
+
+    static bool ScanCoarseScores(const int8_t* probeQuantized, const float probeInvNorm, const int probeVersion,
+                                 const FaceprintsGallery& gallery, const size_t begin, const size_t end, TagResult& result,
+                                 const bool& probe_has_mask, TopKCandidates* candidates);
+
+    // score of the probe against the user of a MatchResultCache entry, and its thresholds decision (DecideMatch()).
+    // returns true if the user is accepted with at least score_margin above the strong threshold, i.e. without a scan.
+    // the score and matched_faceprints are read at the same sequence of the user (returned), so the user may be
+    // updated concurrently.
+    static bool ScoreCachedUser(const MatchElement& probe_faceprints, const FaceprintsGallery& gallery, const size_t cached_index,
+                                const bool probe_has_mask, const Thresholds& thresholds, const match_calc_t score_margin,
+                                ExtendedMatchResult& result, Faceprints& matched_faceprints, uint32_t& sequence);
+
+    // thresholds decision only (isSame, should_update), given the best matched user of a 1:N scan (result.maxScore).
+    static void DecideMatch(const Faceprints& matched_faceprints, const bool probe_has_mask, const Thresholds& thresholds,
+                            ExtendedMatchResult& result, AdaptiveThresholds& adaptiveThresholds);
+
+    // thresholds decision and adaptive update, given the best matched user of a 1:N scan (result.maxScore).
+    static void ApplyMatchDecision(const MatchElement& probe_faceprints, const Faceprints& matched_faceprints, const bool probe_has_mask,
+                                   const Thresholds& thresholds, ExtendedMatchResult& result, Faceprints& updated_faceprints);
 
     static bool ValidateVector(const feature_t* T1, const uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES);
 
@@ -75,7 +274,8 @@ private:
 
     static bool IsSameVersion(const MatchElement& newFaceprints, const Faceprints& existingFaceprints);
 
-    static void SetToDefaultThresholds(Thresholds& thresholds, const ThresholdsConfidenceEnum confidenceLevel);
+    // strong threshold of the given configuration, as set by HandleThresholdsConfiguration().
+    static short StrongThreshold(const Thresholds& thresholds, const ThresholdsConfigEnum config, const bool rgb_enrolled);
 
     static void InitAdaptiveThresholds(const Thresholds& thresholds, AdaptiveThresholds& adaptiveThresholds);
 };
@@ -0,0 +1,165 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "Matcher.h"
+#include "MatcherKernels.h"
+#include "MatcherParallel.h"
+#include "FaceprintsGallery.h"
+#include "Logger.h"
+#include <algorithm>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "MatcherBatch";
+
+namespace
+{
+struct BatchProbe
+{
+    size_t index = 0;
+    const feature_t* vector = nullptr;
+    NccNorm norm;
+    match_calc_t maxScore = -1; // must init to -1 so that maximum will be saved if matchScore is 0 !!!
+    int maxSubject = -1;
+    TopKCandidates candidates;
+};
+} // namespace
+
+// Score a group of probes (all with mask, or all without) against the gallery, cache-blocked (see
+// MatcherParallel::ScanProbeBlock()). within a probe the rows are visited in increasing index order, so ties resolve to
+// the lowest index like in the single probe scan.
+static void ScoreProbesGroup(std::vector<BatchProbe>& probes, const FaceprintsGallery& gallery, const bool probes_have_mask)
+{
+    const uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES;
+    const MatcherKernels::DotFn dot = MatcherKernels::Active(vec_length).dot;
+
+    for (size_t block = 0; block < MatcherParallel::NumProbeBlocks(probes.size()); block++)
+    {
+        MatcherParallel::ScanProbeBlock(block, probes.size(), gallery.Size(), [&](size_t p, size_t tile_begin, size_t tile_end) {
+            BatchProbe& probe = probes[p];
+            const bool keep_candidates = probe.candidates.K() > 0;
+
+            for (size_t subjectIndex = tile_begin; subjectIndex < tile_end; subjectIndex++)
+            {
+                int32_t corr = dot(probe.vector, gallery.ActiveVector(subjectIndex, probes_have_mask), vec_length);
+                match_calc_t matchScore = Matcher::ComputeNccGrade(corr, probe.norm, gallery.ActiveNorm(subjectIndex, probes_have_mask));
+
+                if (matchScore > probe.maxScore)
+                {
+                    probe.maxScore = matchScore;
+                    probe.maxSubject = static_cast<int>(subjectIndex);
+                }
+
+                if (keep_candidates)
+                {
+                    probe.candidates.Insert(static_cast<int>(subjectIndex), matchScore);
+                }
+            }
+        });
+    }
+}
+
+std::vector<ExtendedMatchResult> Matcher::MatchBatch(const std::vector<MatchElement>& probes, const FaceprintsGallery& gallery,
+                                                     const ThresholdsConfidenceEnum confidenceLevel)
+{
+    Thresholds thresholds;
+    SetToDefaultThresholds(thresholds, confidenceLevel);
+
+    return MatchBatch(probes, gallery, thresholds);
+}
+
+std::vector<ExtendedMatchResult> Matcher::MatchBatch(const std::vector<MatchElement>& probes, const FaceprintsGallery& gallery,
+                                                     const Thresholds& thresholds)
+{
+    std::vector<std::vector<MatchCandidate>> top_candidates;
+    return MatchBatch(probes, gallery, thresholds, 0, top_candidates);
+}
+
+std::vector<ExtendedMatchResult> Matcher::MatchBatch(const std::vector<MatchElement>& probes, const FaceprintsGallery& gallery,
+                                                     const Thresholds& thresholds, const size_t top_k,
+                                                     std::vector<std::vector<MatchCandidate>>& top_candidates)
+{
+    std::vector<ExtendedMatchResult> results(probes.size());
+    top_candidates.clear();
+    top_candidates.resize(top_k > 0 ? probes.size() : 0);
+
+    if (gallery.Empty())
+    {
+        LOG_ERROR(LOG_TAG, "Faceprints gallery size is 0.");
+        return results;
+    }
+
+    // like in the single probe scan - a probe can only be matched if all gallery users share its version.
+    int galleryVersion = 0;
+    const bool uniformVersion = gallery.CommonVersion(galleryVersion);
+
+    std::vector<BatchProbe> noMaskProbes;
+    std::vector<BatchProbe> maskProbes;
+
+    for (size_t i = 0; i < probes.size(); i++)
+    {
+        const MatchElement& probe_faceprints = probes[i];
+
+        if (!ValidateFaceprints(probe_faceprints))
+        {
+            LOG_ERROR(LOG_TAG, "Probe %zu : faceprints vector failed range validation.", i);
+            continue;
+        }
+
+        if (!uniformVersion || probe_faceprints.data.version != galleryVersion)
+        {
+            LOG_ERROR(LOG_TAG, "Probe %zu : version mismatch between 2 vectors. Skipping this match()!", i);
+            continue;
+        }
+
+        feature_t probeFaceFlags = probe_faceprints.data.featuresVector[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS];
+        bool probe_has_mask = (probeFaceFlags == FaVectorFlagsEnum::VecFlagValidWithMask) ? true : false;
+
+        BatchProbe probe;
+        probe.index = i;
+        probe.vector = &probe_faceprints.data.featuresVector[0];
+        probe.norm = ComputeNccNorm(probe.vector, RSID_NUM_OF_RECOGNITION_FEATURES);
+        probe.candidates.Reset(top_k);
+        (probe_has_mask ? maskProbes : noMaskProbes).push_back(std::move(probe));
+    }
+
+#if (RSID_MATCHER_SCAN_CHECKS)
+    // the probes all have the gallery version, so each user is checked once for all of them.
+    for (size_t i = 0; i < gallery.Size() && !(noMaskProbes.empty() && maskProbes.empty()); i++)
+    {
+        if (!gallery.ValidateUser(i, galleryVersion))
+        {
+            return results;
+        }
+    }
+#endif
+
+    ScoreProbesGroup(noMaskProbes, gallery, false);
+    ScoreProbesGroup(maskProbes, gallery, true);
+
+    for (int group = 0; group < 2; group++)
+    {
+        const bool probes_have_mask = (group == 1);
+        for (auto& probe : (probes_have_mask ? maskProbes : noMaskProbes))
+        {
+            ExtendedMatchResult& result = results[probe.index];
+            result.maxScore = probe.maxScore;
+            result.userId = probe.maxSubject;
+
+            AdaptiveThresholds adaptiveThresholds;
+            DecideMatch(gallery.GetFaceprints(static_cast<size_t>(probe.maxSubject)), probes_have_mask, thresholds, result,
+                        adaptiveThresholds);
+
+            if (top_k > 0)
+            {
+                top_candidates[probe.index] = probe.candidates.Sorted();
+            }
+        }
+    }
+
+    LOG_DEBUG(LOG_TAG, "Batch matched %zu probes (%zu with mask) against %zu users.", noMaskProbes.size() + maskProbes.size(),
+              maskProbes.size(), gallery.Size());
+
+    return results;
+}
+} // namespace RealSenseID
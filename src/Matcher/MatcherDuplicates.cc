@@ -0,0 +1,182 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "Matcher.h"
+#include "MatcherKernels.h"
+#include "MatcherParallel.h"
+#include "FaceprintsGallery.h"
+#include "Logger.h"
+#include <algorithm>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "MatcherDuplicates";
+
+// higher score first, then by user indices.
+static bool IsBetterPair(const NearDuplicatePair& lhs, const NearDuplicatePair& rhs)
+{
+    if (lhs.score != rhs.score)
+    {
+        return lhs.score > rhs.score;
+    }
+    return (lhs.first != rhs.first) ? lhs.first < rhs.first : lhs.second < rhs.second;
+}
+
+// All pairs scan of num_users users.
+//
+// Cache blocking: the users are split to tiles of RSID_MATCHER_DUPLICATES_TILE users, and
+// score_tiles(row_begin, row_end, col_begin, col_end, pairs) scores the pairs (i, j), i < j, of a row tile and a
+// later (or the same) column tile while both are in the L2 cache, so each column tile is streamed from memory once
+// per row tile instead of once per user.
+// The row tiles are split over num_threads threads (MatcherParallel::ParallelFor()), first tiles (which have the most
+// pairs) first. Each thread collects its own pairs, which are merged and sorted at the end.
+template <typename ScoreTilesFn>
+static std::vector<NearDuplicatePair> ScanAllPairs(const size_t num_users, unsigned int num_threads, ScoreTilesFn& score_tiles)
+{
+    const size_t tile = RSID_MATCHER_DUPLICATES_TILE;
+    const size_t num_tiles = (num_users + tile - 1) / tile;
+    num_threads = MatcherParallel::ThreadsFor(num_tiles, num_threads);
+
+    std::vector<std::vector<NearDuplicatePair>> thread_pairs(num_threads);
+
+    MatcherParallel::ParallelFor(num_tiles, num_threads, [&](size_t row_tile, unsigned int thread_index) {
+        const size_t row_begin = row_tile * tile;
+        const size_t row_end = std::min(row_begin + tile, num_users);
+        for (size_t col_begin = row_begin; col_begin < num_users; col_begin += tile)
+        {
+            score_tiles(row_begin, row_end, col_begin, std::min(col_begin + tile, num_users), thread_pairs[thread_index]);
+        }
+    });
+
+    std::vector<NearDuplicatePair> pairs;
+    size_t num_pairs = 0;
+    for (const auto& worker_pairs : thread_pairs)
+    {
+        num_pairs += worker_pairs.size();
+    }
+    pairs.reserve(num_pairs);
+    for (const auto& worker_pairs : thread_pairs)
+    {
+        pairs.insert(pairs.end(), worker_pairs.begin(), worker_pairs.end());
+    }
+    std::sort(pairs.begin(), pairs.end(), IsBetterPair);
+
+    return pairs;
+}
+
+// the users are validated when added, so only their common version is checked (and with RSID_MATCHER_SCAN_CHECKS,
+// each user once for all its pairs).
+static bool CheckDuplicatesGallery(const FaceprintsGallery& gallery)
+{
+    int galleryVersion = 0;
+    if (gallery.Size() > 1 && !gallery.CommonVersion(galleryVersion))
+    {
+        LOG_ERROR(LOG_TAG, "Gallery users mix faceprints versions. Skipping near duplicates scan!");
+        return false;
+    }
+
+#if (RSID_MATCHER_SCAN_CHECKS)
+    for (size_t i = 0; i < gallery.Size() && gallery.Size() > 1; i++)
+    {
+        if (!gallery.ValidateUser(i, galleryVersion))
+        {
+            return false;
+        }
+    }
+#endif
+
+    return true;
+}
+
+// exact ncc score of users i and j, as in the 1:N scan.
+static inline match_calc_t PairScore(const FaceprintsGallery& gallery, const MatcherKernels::DotFn dot, const size_t i, const size_t j)
+{
+    const uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES;
+    int32_t corr = dot(gallery.ActiveVector(i, false), gallery.ActiveVector(j, false), vec_length);
+    return Matcher::ComputeNccGrade(corr, gallery.ActiveNorm(i, false), gallery.ActiveNorm(j, false));
+}
+
+std::vector<NearDuplicatePair> Matcher::FindNearDuplicates(const FaceprintsGallery& gallery, const match_calc_t threshold,
+                                                           const unsigned int num_threads)
+{
+    if (!CheckDuplicatesGallery(gallery))
+    {
+        return {};
+    }
+
+    const MatcherKernels::DotFn dot = MatcherKernels::Active(RSID_NUM_OF_RECOGNITION_FEATURES).dot;
+
+    auto score_tiles = [&](size_t row_begin, size_t row_end, size_t col_begin, size_t col_end, std::vector<NearDuplicatePair>& pairs) {
+        for (size_t i = row_begin; i < row_end; i++)
+        {
+            for (size_t j = std::max(col_begin, i + 1); j < col_end; j++)
+            {
+                match_calc_t score = PairScore(gallery, dot, i, j);
+                if (score >= threshold)
+                {
+                    pairs.push_back({static_cast<int>(i), static_cast<int>(j), score});
+                }
+            }
+        }
+    };
+
+    std::vector<NearDuplicatePair> pairs = ScanAllPairs(gallery.Size(), num_threads, score_tiles);
+
+    LOG_DEBUG(LOG_TAG, "Found %zu near duplicate pairs among %zu users.", pairs.size(), gallery.Size());
+
+    return pairs;
+}
+
+// the ncc grade is 4096 * cos^2 of the two vectors (0 for negative correlation), so the quantized rows cosine gives
+// an approximated grade.
+std::vector<NearDuplicatePair> Matcher::FindNearDuplicatesCoarseToFine(const FaceprintsGallery& gallery, const match_calc_t threshold,
+                                                                       const match_calc_t coarse_margin, const unsigned int num_threads)
+{
+    if (!gallery.HasQuantizedTier())
+    {
+        LOG_DEBUG(LOG_TAG, "Gallery has no quantized tier, falling back to the exact scan.");
+        return FindNearDuplicates(gallery, threshold, num_threads);
+    }
+
+    if (!CheckDuplicatesGallery(gallery))
+    {
+        return {};
+    }
+
+    const uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES;
+    const MatcherKernels::KernelTable& kernels = MatcherKernels::Active(vec_length);
+    const MatcherKernels::DotFn dot = kernels.dot;
+    const MatcherKernels::DotI8Fn dot_i8 = kernels.dot_i8;
+    const float coarse_threshold = static_cast<float>(threshold - coarse_margin) / 4096.0f;
+
+    auto score_tiles = [&](size_t row_begin, size_t row_end, size_t col_begin, size_t col_end, std::vector<NearDuplicatePair>& pairs) {
+        for (size_t i = row_begin; i < row_end; i++)
+        {
+            const int8_t* row = gallery.ActiveQuantizedVector(i, false);
+            const float rowInvNorm = gallery.ActiveQuantizedInvNorm(i, false);
+
+            for (size_t j = std::max(col_begin, i + 1); j < col_end; j++)
+            {
+                int32_t corr = dot_i8(row, gallery.ActiveQuantizedVector(j, false), vec_length);
+                float cosine = static_cast<float>(corr) * rowInvNorm * gallery.ActiveQuantizedInvNorm(j, false);
+                if (coarse_threshold > 0.0f && (cosine <= 0.0f || cosine * cosine < coarse_threshold))
+                {
+                    continue;
+                }
+
+                match_calc_t score = PairScore(gallery, dot, i, j);
+                if (score >= threshold)
+                {
+                    pairs.push_back({static_cast<int>(i), static_cast<int>(j), score});
+                }
+            }
+        }
+    };
+
+    std::vector<NearDuplicatePair> pairs = ScanAllPairs(gallery.Size(), num_threads, score_tiles);
+
+    LOG_DEBUG(LOG_TAG, "Found %zu near duplicate pairs among %zu users (coarse to fine).", pairs.size(), gallery.Size());
+
+    return pairs;
+}
+} // namespace RealSenseID
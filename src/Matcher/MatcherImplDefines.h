@@ -76,6 +76,46 @@
 #define RSID_MAX_FEATURE_VALUE (1023)
 #define RSID_MIN_FEATURE_VALUE (-1023)
 
+// multi-threaded 1:N scan defines.
+// number of users per shard (a shard's gallery vectors should fit in the L2 cache).
+#define RSID_MATCHER_SHARD_SIZE (512)
+// minimal number of users per thread, below it the scan uses less threads (down to single threaded).
+#define RSID_MATCHER_MIN_USERS_PER_THREAD (4096)
+
+// batch matching cache blocking: number of probes scored against each gallery tile, and number of gallery users per
+// tile (tile vectors should fit in the L2 cache).
+#define RSID_MATCHER_BATCH_PROBES_BLOCK (64)
+#define RSID_MATCHER_BATCH_GALLERY_TILE (256)
+
+// near duplicates (all pairs) scan defines.
+// number of users per tile: each pair of tiles is scored while both are in the L2 cache.
+#define RSID_MATCHER_DUPLICATES_TILE (256)
+// pairs whose quantized tier approximated score is more than this below the threshold aren't scored exactly.
+#define RSID_MATCHER_DUPLICATES_COARSE_MARGIN (256)
+
+// coarse search (int8 quantized gallery) defines.
+// features in range [-1023,+1023] are shifted right by this to fit int8.
+#define RSID_MATCHER_QUANTIZATION_SHIFT (3)
+// coarse scores are the approximated ncc (cosine) scaled to this value.
+#define RSID_MATCHER_COARSE_SCORE_SCALE (32767)
+
+// ivf index (FaceprintsIvfIndex) training defines.
+#define RSID_MATCHER_IVF_TRAIN_ITERATIONS       (10)
+#define RSID_MATCHER_IVF_TRAIN_SAMPLES_PER_LIST (64)
+#define RSID_MATCHER_IVF_TRAIN_SEED             (1)
+// number of users ahead whose gallery row is prefetched during an ivf list scan.
+#define RSID_MATCHER_IVF_PREFETCH_DISTANCE (2)
+
+// match result cache (MatchResultCache) defines.
+// time a cached accepted user is checked first, from the full scan that accepted it.
+#define RSID_MATCHER_CACHE_TTL_MS (1000)
+// a probe is accepted from the cache only if it scores at least this much above the strong threshold.
+#define RSID_MATCHER_CACHE_SCORE_MARGIN (512)
+
+// gallery scans trust the gallery invariant (users validated when added, common version checked once per probe).
+// set to 1 to re-validate every gallery user (vector range and version) during every scan, for debugging.
+#define RSID_MATCHER_SCAN_CHECKS (0)
+
 // disable matcher logs
 #define RSID_MATCHER_DEBUG_LOGS (0)
 //=============================================================================
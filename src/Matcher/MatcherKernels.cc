@@ -0,0 +1,774 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "MatcherKernels.h"
+#include "CpuFeatures.h"
+#include "MatcherImplDefines.h"
+#include <algorithm>
+
+#if RSID_ARCH_X86
+#include <immintrin.h>
+#endif
+
+// gcc/clang need the target attribute to allow intrinsics of instruction sets that are not enabled globally.
+// msvc allows them anywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define RSID_TARGET(isa) __attribute__((target(isa)))
+#else
+#define RSID_TARGET(isa)
+#endif
+
+/*
+All kernels accumulate in 32 bit lanes with wrap-around adds, exactly like the scalar loop in
+Matcher::MatchTwoVectors(). pmaddwd/vpdpwssd add two adjacent 16x16 bit products into a 32 bit lane (also
+wrapping), so the final sums are identical to the scalar ones for any input (in-range or not).
+
+Each kernel is a template on its vector length: FixedLength = 0 is the generic kernel (any vec_length), and the
+FixedLength = SpecializedLength (RSID_NUM_OF_RECOGNITION_FEATURES) instance ignores vec_length, so its trip counts are compile time
+constants - the loops are unrolled and the scalar tails are compiled out. Active(vec_length) selects it for the
+gallery vectors length.
+*/
+
+namespace RealSenseID
+{
+namespace MatcherKernels
+{
+// vector length of the specialized kernels (see Active(vec_length)).
+static constexpr uint32_t SpecializedLength = RSID_NUM_OF_RECOGNITION_FEATURES;
+
+// the length a kernel runs on: its compile time FixedLength if it has one, else the runtime vec_length.
+template <uint32_t Length>
+static inline uint32_t KernelLength(uint32_t vec_length)
+{
+    return (Length != 0) ? Length : vec_length;
+}
+
+template <uint32_t FixedLength>
+static void NccSumsScalar(const feature_t* T1, const feature_t* T2, uint32_t vec_length, NccSums& sums)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    uint32_t corr = 0;
+    uint32_t norm1 = 0;
+    uint32_t norm2 = 0;
+
+    for (uint32_t i = 0; i < vec_length; ++i)
+    {
+        int32_t t1 = static_cast<int32_t>(T1[i]);
+        int32_t t2 = static_cast<int32_t>(T2[i]);
+
+        corr += static_cast<uint32_t>(t1 * t2);
+        norm1 += static_cast<uint32_t>(t1 * t1);
+        norm2 += static_cast<uint32_t>(t2 * t2);
+    }
+
+    sums.corr = static_cast<int32_t>(corr);
+    sums.norm1 = norm1;
+    sums.norm2 = norm2;
+}
+
+template <uint32_t FixedLength>
+static int32_t DotScalar(const feature_t* T1, const feature_t* T2, uint32_t vec_length)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    uint32_t corr = 0;
+
+    for (uint32_t i = 0; i < vec_length; ++i)
+    {
+        corr += static_cast<uint32_t>(static_cast<int32_t>(T1[i]) * static_cast<int32_t>(T2[i]));
+    }
+
+    return static_cast<int32_t>(corr);
+}
+
+template <uint32_t FixedLength>
+static int32_t DotI8Scalar(const int8_t* T1, const int8_t* T2, uint32_t vec_length)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    int32_t corr = 0;
+
+    for (uint32_t i = 0; i < vec_length; ++i)
+    {
+        corr += static_cast<int32_t>(T1[i]) * static_cast<int32_t>(T2[i]);
+    }
+
+    return corr;
+}
+
+// add the scalar leftovers (vec_length not multiple of the simd width) to the simd sums.
+static void AddTail(const feature_t* T1, const feature_t* T2, uint32_t start, uint32_t vec_length, NccSums& sums)
+{
+    NccSums tail;
+    NccSumsScalar<0>(T1 + start, T2 + start, vec_length - start, tail);
+    sums.corr = static_cast<int32_t>(static_cast<uint32_t>(sums.corr) + static_cast<uint32_t>(tail.corr));
+    sums.norm1 += tail.norm1;
+    sums.norm2 += tail.norm2;
+}
+
+// one feature of the adaptive blend, exactly as Matcher::BlendAverageVector() always computed it:
+// v = (2*w*a + 2*n +/- (w+1)) / (2*(w+1)), truncated. for any int16 inputs v is in int16 range.
+static inline feature_t BlendFeature(int32_t a, int32_t n)
+{
+    const int32_t history_weight = RSID_UPDATE_GALLERY_HISTORY_WEIGHT;
+    const int32_t round_value = history_weight + 1;
+
+    int32_t v = a * 2 * history_weight + 2 * n;
+    v = (v >= 0) ? (v + round_value) : (v - round_value);
+    return static_cast<feature_t>(v / (2 * round_value));
+}
+
+static bool BlendScalar(feature_t* T1, const feature_t* T2, uint32_t vec_length)
+{
+    bool changed = false;
+
+    for (uint32_t i = 0; i < vec_length; ++i)
+    {
+        feature_t blended = BlendFeature(T1[i], T2[i]);
+        changed |= (blended != T1[i]);
+        T1[i] = blended;
+    }
+
+    return changed;
+}
+
+template <uint32_t FixedLength>
+static bool BlendAverageScalar(feature_t* T1, const feature_t* T2, uint32_t vec_length)
+{
+    return BlendScalar(T1, T2, KernelLength<FixedLength>(vec_length));
+}
+
+template <uint32_t FixedLength>
+static bool BlendNccSumsScalar(feature_t* T1, const feature_t* T2, uint32_t vec_length, NccSums& sums)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    bool changed = BlendScalar(T1, T2, vec_length);
+    NccSumsScalar<0>(T1, T2, vec_length, sums);
+    return changed;
+}
+
+#if RSID_ARCH_X86
+RSID_TARGET("sse4.1") static inline uint32_t HorizontalSum128(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("sse4.1") static void NccSumsSse41(const feature_t* T1, const feature_t* T2, uint32_t vec_length, NccSums& sums)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m128i corr = _mm_setzero_si128();
+    __m128i norm1 = _mm_setzero_si128();
+    __m128i norm2 = _mm_setzero_si128();
+
+    uint32_t i = 0;
+    for (; i + 8 <= vec_length; i += 8)
+    {
+        __m128i t1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T1 + i));
+        __m128i t2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T2 + i));
+        corr = _mm_add_epi32(corr, _mm_madd_epi16(t1, t2));
+        norm1 = _mm_add_epi32(norm1, _mm_madd_epi16(t1, t1));
+        norm2 = _mm_add_epi32(norm2, _mm_madd_epi16(t2, t2));
+    }
+
+    sums.corr = static_cast<int32_t>(HorizontalSum128(corr));
+    sums.norm1 = HorizontalSum128(norm1);
+    sums.norm2 = HorizontalSum128(norm2);
+    AddTail(T1, T2, i, vec_length, sums);
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("sse4.1") static int32_t DotSse41(const feature_t* T1, const feature_t* T2, uint32_t vec_length)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m128i corr = _mm_setzero_si128();
+
+    uint32_t i = 0;
+    for (; i + 8 <= vec_length; i += 8)
+    {
+        __m128i t1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T1 + i));
+        __m128i t2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T2 + i));
+        corr = _mm_add_epi32(corr, _mm_madd_epi16(t1, t2));
+    }
+
+    return static_cast<int32_t>(HorizontalSum128(corr) + static_cast<uint32_t>(DotScalar<0>(T1 + i, T2 + i, vec_length - i)));
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("sse4.1") static int32_t DotI8Sse41(const int8_t* T1, const int8_t* T2, uint32_t vec_length)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m128i corr = _mm_setzero_si128();
+
+    uint32_t i = 0;
+    for (; i + 8 <= vec_length; i += 8)
+    {
+        __m128i t1 = _mm_cvtepi8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(T1 + i)));
+        __m128i t2 = _mm_cvtepi8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(T2 + i)));
+        corr = _mm_add_epi32(corr, _mm_madd_epi16(t1, t2));
+    }
+
+    return static_cast<int32_t>(HorizontalSum128(corr)) + DotI8Scalar<0>(T1 + i, T2 + i, vec_length - i);
+}
+
+// blend of 4 features widened to 32 bit: x = 2*w*a + 2*n, x +/- (w+1), then the truncating integer division by
+// 2*(w+1) is done in float: |x| < 2^21 is exact in float, and the correctly rounded quotient truncates to the
+// integer quotient (its distance to the next integer is at least 1/62, far above the float rounding error).
+RSID_TARGET("sse4.1") static inline __m128i BlendSse41(__m128i a, __m128i n)
+{
+    const int32_t history_weight = RSID_UPDATE_GALLERY_HISTORY_WEIGHT;
+    const int32_t round_value = history_weight + 1;
+
+    __m128i x = _mm_add_epi32(_mm_mullo_epi32(a, _mm_set1_epi32(2 * history_weight)), _mm_slli_epi32(n, 1));
+    __m128i round = _mm_sub_epi32(_mm_set1_epi32(round_value), _mm_and_si128(_mm_srai_epi32(x, 31), _mm_set1_epi32(2 * round_value)));
+    __m128 quotient = _mm_div_ps(_mm_cvtepi32_ps(_mm_add_epi32(x, round)), _mm_set1_ps(static_cast<float>(2 * round_value)));
+    return _mm_cvttps_epi32(quotient);
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("sse4.1") static bool BlendAverageSse41(feature_t* T1, const feature_t* T2, uint32_t vec_length)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m128i changed = _mm_setzero_si128();
+
+    uint32_t i = 0;
+    for (; i + 8 <= vec_length; i += 8)
+    {
+        __m128i t1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T1 + i));
+        __m128i t2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T2 + i));
+        __m128i lo = BlendSse41(_mm_cvtepi16_epi32(t1), _mm_cvtepi16_epi32(t2));
+        __m128i hi = BlendSse41(_mm_cvtepi16_epi32(_mm_srli_si128(t1, 8)), _mm_cvtepi16_epi32(_mm_srli_si128(t2, 8)));
+        __m128i blended = _mm_packs_epi32(lo, hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(T1 + i), blended);
+
+        changed = _mm_or_si128(changed, _mm_xor_si128(blended, t1));
+    }
+
+    bool any_changed = !_mm_testz_si128(changed, changed);
+    any_changed |= BlendScalar(T1 + i, T2 + i, vec_length - i);
+    return any_changed;
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("sse4.1") static bool BlendNccSumsSse41(feature_t* T1, const feature_t* T2, uint32_t vec_length, NccSums& sums)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m128i corr = _mm_setzero_si128();
+    __m128i norm1 = _mm_setzero_si128();
+    __m128i norm2 = _mm_setzero_si128();
+    __m128i changed = _mm_setzero_si128();
+
+    uint32_t i = 0;
+    for (; i + 8 <= vec_length; i += 8)
+    {
+        __m128i t1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T1 + i));
+        __m128i t2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(T2 + i));
+        __m128i lo = BlendSse41(_mm_cvtepi16_epi32(t1), _mm_cvtepi16_epi32(t2));
+        __m128i hi = BlendSse41(_mm_cvtepi16_epi32(_mm_srli_si128(t1, 8)), _mm_cvtepi16_epi32(_mm_srli_si128(t2, 8)));
+        __m128i blended = _mm_packs_epi32(lo, hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(T1 + i), blended);
+
+        changed = _mm_or_si128(changed, _mm_xor_si128(blended, t1));
+        corr = _mm_add_epi32(corr, _mm_madd_epi16(blended, t2));
+        norm1 = _mm_add_epi32(norm1, _mm_madd_epi16(blended, blended));
+        norm2 = _mm_add_epi32(norm2, _mm_madd_epi16(t2, t2));
+    }
+
+    bool any_changed = !_mm_testz_si128(changed, changed);
+    any_changed |= BlendScalar(T1 + i, T2 + i, vec_length - i);
+
+    sums.corr = static_cast<int32_t>(HorizontalSum128(corr));
+    sums.norm1 = HorizontalSum128(norm1);
+    sums.norm2 = HorizontalSum128(norm2);
+    AddTail(T1, T2, i, vec_length, sums);
+    return any_changed;
+}
+
+RSID_TARGET("avx2") static inline uint32_t HorizontalSum256(__m256i v)
+{
+    __m128i v128 = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    v128 = _mm_add_epi32(v128, _mm_shuffle_epi32(v128, _MM_SHUFFLE(1, 0, 3, 2)));
+    v128 = _mm_add_epi32(v128, _mm_shuffle_epi32(v128, _MM_SHUFFLE(2, 3, 0, 1)));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(v128));
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("avx2") static void NccSumsAvx2(const feature_t* T1, const feature_t* T2, uint32_t vec_length, NccSums& sums)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m256i corr = _mm256_setzero_si256();
+    __m256i norm1 = _mm256_setzero_si256();
+    __m256i norm2 = _mm256_setzero_si256();
+
+    uint32_t i = 0;
+    for (; i + 16 <= vec_length; i += 16)
+    {
+        __m256i t1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T1 + i));
+        __m256i t2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T2 + i));
+        corr = _mm256_add_epi32(corr, _mm256_madd_epi16(t1, t2));
+        norm1 = _mm256_add_epi32(norm1, _mm256_madd_epi16(t1, t1));
+        norm2 = _mm256_add_epi32(norm2, _mm256_madd_epi16(t2, t2));
+    }
+
+    sums.corr = static_cast<int32_t>(HorizontalSum256(corr));
+    sums.norm1 = HorizontalSum256(norm1);
+    sums.norm2 = HorizontalSum256(norm2);
+    AddTail(T1, T2, i, vec_length, sums);
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("avx2") static int32_t DotAvx2(const feature_t* T1, const feature_t* T2, uint32_t vec_length)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    // two accumulators to hide the madd latency.
+    __m256i corr0 = _mm256_setzero_si256();
+    __m256i corr1 = _mm256_setzero_si256();
+
+    uint32_t i = 0;
+    for (; i + 32 <= vec_length; i += 32)
+    {
+        __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T1 + i));
+        __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T2 + i));
+        __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T1 + i + 16));
+        __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T2 + i + 16));
+        corr0 = _mm256_add_epi32(corr0, _mm256_madd_epi16(a0, b0));
+        corr1 = _mm256_add_epi32(corr1, _mm256_madd_epi16(a1, b1));
+    }
+    for (; i + 16 <= vec_length; i += 16)
+    {
+        __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T1 + i));
+        __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T2 + i));
+        corr0 = _mm256_add_epi32(corr0, _mm256_madd_epi16(a0, b0));
+    }
+
+    uint32_t corr = HorizontalSum256(_mm256_add_epi32(corr0, corr1));
+    return static_cast<int32_t>(corr + static_cast<uint32_t>(DotScalar<0>(T1 + i, T2 + i, vec_length - i)));
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("avx2") static int32_t DotI8Avx2(const int8_t* T1, const int8_t* T2, uint32_t vec_length)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m256i corr = _mm256_setzero_si256();
+
+    uint32_t i = 0;
+    for (; i + 16 <= vec_length; i += 16)
+    {
+        __m256i t1 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(T1 + i)));
+        __m256i t2 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(T2 + i)));
+        corr = _mm256_add_epi32(corr, _mm256_madd_epi16(t1, t2));
+    }
+
+    return static_cast<int32_t>(HorizontalSum256(corr)) + DotI8Scalar<0>(T1 + i, T2 + i, vec_length - i);
+}
+
+RSID_TARGET("avx2") static inline __m256i BlendAvx2(__m256i a, __m256i n)
+{
+    const int32_t history_weight = RSID_UPDATE_GALLERY_HISTORY_WEIGHT;
+    const int32_t round_value = history_weight + 1;
+
+    __m256i x = _mm256_add_epi32(_mm256_mullo_epi32(a, _mm256_set1_epi32(2 * history_weight)), _mm256_slli_epi32(n, 1));
+    __m256i round =
+        _mm256_sub_epi32(_mm256_set1_epi32(round_value), _mm256_and_si256(_mm256_srai_epi32(x, 31), _mm256_set1_epi32(2 * round_value)));
+    __m256 quotient = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(x, round)), _mm256_set1_ps(static_cast<float>(2 * round_value)));
+    return _mm256_cvttps_epi32(quotient);
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("avx2") static bool BlendAverageAvx2(feature_t* T1, const feature_t* T2, uint32_t vec_length)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m256i changed = _mm256_setzero_si256();
+
+    uint32_t i = 0;
+    for (; i + 16 <= vec_length; i += 16)
+    {
+        __m256i t1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T1 + i));
+        __m256i t2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T2 + i));
+        __m256i lo = BlendAvx2(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(t1)), _mm256_cvtepi16_epi32(_mm256_castsi256_si128(t2)));
+        __m256i hi =
+            BlendAvx2(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(t1, 1)), _mm256_cvtepi16_epi32(_mm256_extracti128_si256(t2, 1)));
+        // packs works per 128 bit lane, the permute restores the features order.
+        __m256i blended = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(T1 + i), blended);
+
+        changed = _mm256_or_si256(changed, _mm256_xor_si256(blended, t1));
+    }
+
+    bool any_changed = !_mm256_testz_si256(changed, changed);
+    any_changed |= BlendScalar(T1 + i, T2 + i, vec_length - i);
+    return any_changed;
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("avx2") static bool BlendNccSumsAvx2(feature_t* T1, const feature_t* T2, uint32_t vec_length, NccSums& sums)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m256i corr = _mm256_setzero_si256();
+    __m256i norm1 = _mm256_setzero_si256();
+    __m256i norm2 = _mm256_setzero_si256();
+    __m256i changed = _mm256_setzero_si256();
+
+    uint32_t i = 0;
+    for (; i + 16 <= vec_length; i += 16)
+    {
+        __m256i t1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T1 + i));
+        __m256i t2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(T2 + i));
+        __m256i lo = BlendAvx2(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(t1)), _mm256_cvtepi16_epi32(_mm256_castsi256_si128(t2)));
+        __m256i hi =
+            BlendAvx2(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(t1, 1)), _mm256_cvtepi16_epi32(_mm256_extracti128_si256(t2, 1)));
+        // packs works per 128 bit lane, the permute restores the features order.
+        __m256i blended = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(T1 + i), blended);
+
+        changed = _mm256_or_si256(changed, _mm256_xor_si256(blended, t1));
+        corr = _mm256_add_epi32(corr, _mm256_madd_epi16(blended, t2));
+        norm1 = _mm256_add_epi32(norm1, _mm256_madd_epi16(blended, blended));
+        norm2 = _mm256_add_epi32(norm2, _mm256_madd_epi16(t2, t2));
+    }
+
+    bool any_changed = !_mm256_testz_si256(changed, changed);
+    any_changed |= BlendScalar(T1 + i, T2 + i, vec_length - i);
+
+    sums.corr = static_cast<int32_t>(HorizontalSum256(corr));
+    sums.norm1 = HorizontalSum256(norm1);
+    sums.norm2 = HorizontalSum256(norm2);
+    AddTail(T1, T2, i, vec_length, sums);
+    return any_changed;
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("avx512f,avx512bw") static void NccSumsAvx512(const feature_t* T1, const feature_t* T2, uint32_t vec_length, NccSums& sums)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m512i corr = _mm512_setzero_si512();
+    __m512i norm1 = _mm512_setzero_si512();
+    __m512i norm2 = _mm512_setzero_si512();
+
+    uint32_t i = 0;
+    for (; i + 32 <= vec_length; i += 32)
+    {
+        __m512i t1 = _mm512_loadu_si512(reinterpret_cast<const void*>(T1 + i));
+        __m512i t2 = _mm512_loadu_si512(reinterpret_cast<const void*>(T2 + i));
+        corr = _mm512_add_epi32(corr, _mm512_madd_epi16(t1, t2));
+        norm1 = _mm512_add_epi32(norm1, _mm512_madd_epi16(t1, t1));
+        norm2 = _mm512_add_epi32(norm2, _mm512_madd_epi16(t2, t2));
+    }
+
+    sums.corr = _mm512_reduce_add_epi32(corr);
+    sums.norm1 = static_cast<uint32_t>(_mm512_reduce_add_epi32(norm1));
+    sums.norm2 = static_cast<uint32_t>(_mm512_reduce_add_epi32(norm2));
+    AddTail(T1, T2, i, vec_length, sums);
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("avx512f,avx512bw") static int32_t DotAvx512(const feature_t* T1, const feature_t* T2, uint32_t vec_length)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m512i corr0 = _mm512_setzero_si512();
+    __m512i corr1 = _mm512_setzero_si512();
+
+    uint32_t i = 0;
+    for (; i + 64 <= vec_length; i += 64)
+    {
+        __m512i a0 = _mm512_loadu_si512(reinterpret_cast<const void*>(T1 + i));
+        __m512i b0 = _mm512_loadu_si512(reinterpret_cast<const void*>(T2 + i));
+        __m512i a1 = _mm512_loadu_si512(reinterpret_cast<const void*>(T1 + i + 32));
+        __m512i b1 = _mm512_loadu_si512(reinterpret_cast<const void*>(T2 + i + 32));
+        corr0 = _mm512_add_epi32(corr0, _mm512_madd_epi16(a0, b0));
+        corr1 = _mm512_add_epi32(corr1, _mm512_madd_epi16(a1, b1));
+    }
+    for (; i + 32 <= vec_length; i += 32)
+    {
+        __m512i a0 = _mm512_loadu_si512(reinterpret_cast<const void*>(T1 + i));
+        __m512i b0 = _mm512_loadu_si512(reinterpret_cast<const void*>(T2 + i));
+        corr0 = _mm512_add_epi32(corr0, _mm512_madd_epi16(a0, b0));
+    }
+
+    uint32_t corr = static_cast<uint32_t>(_mm512_reduce_add_epi32(_mm512_add_epi32(corr0, corr1)));
+    return static_cast<int32_t>(corr + static_cast<uint32_t>(DotScalar<0>(T1 + i, T2 + i, vec_length - i)));
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("avx512f,avx512bw") static int32_t DotI8Avx512(const int8_t* T1, const int8_t* T2, uint32_t vec_length)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m512i corr = _mm512_setzero_si512();
+
+    uint32_t i = 0;
+    for (; i + 32 <= vec_length; i += 32)
+    {
+        __m512i t1 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(T1 + i)));
+        __m512i t2 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(T2 + i)));
+        corr = _mm512_add_epi32(corr, _mm512_madd_epi16(t1, t2));
+    }
+
+    return _mm512_reduce_add_epi32(corr) + DotI8Scalar<0>(T1 + i, T2 + i, vec_length - i);
+}
+
+RSID_TARGET("avx512f,avx512bw") static inline __m512i BlendAvx512(__m512i a, __m512i n)
+{
+    const int32_t history_weight = RSID_UPDATE_GALLERY_HISTORY_WEIGHT;
+    const int32_t round_value = history_weight + 1;
+
+    __m512i x = _mm512_add_epi32(_mm512_mullo_epi32(a, _mm512_set1_epi32(2 * history_weight)), _mm512_slli_epi32(n, 1));
+    __m512i round =
+        _mm512_sub_epi32(_mm512_set1_epi32(round_value), _mm512_and_si512(_mm512_srai_epi32(x, 31), _mm512_set1_epi32(2 * round_value)));
+    __m512 quotient = _mm512_div_ps(_mm512_cvtepi32_ps(_mm512_add_epi32(x, round)), _mm512_set1_ps(static_cast<float>(2 * round_value)));
+    return _mm512_cvttps_epi32(quotient);
+}
+
+// the blends are also used by the vnni table: they have no 16 bit dot products to gain from vpdpwssd.
+template <uint32_t FixedLength>
+RSID_TARGET("avx512f,avx512bw") static bool BlendAverageAvx512(feature_t* T1, const feature_t* T2, uint32_t vec_length)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __mmask32 changed = 0;
+
+    uint32_t i = 0;
+    for (; i + 32 <= vec_length; i += 32)
+    {
+        __m512i t1 = _mm512_loadu_si512(reinterpret_cast<const void*>(T1 + i));
+        __m512i t2 = _mm512_loadu_si512(reinterpret_cast<const void*>(T2 + i));
+        __m512i lo = BlendAvx512(_mm512_cvtepi16_epi32(_mm512_castsi512_si256(t1)), _mm512_cvtepi16_epi32(_mm512_castsi512_si256(t2)));
+        __m512i hi =
+            BlendAvx512(_mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(t1, 1)), _mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(t2, 1)));
+        __m512i blended = _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtsepi32_epi16(lo)), _mm512_cvtsepi32_epi16(hi), 1);
+        _mm512_storeu_si512(reinterpret_cast<void*>(T1 + i), blended);
+
+        changed |= _mm512_cmpneq_epi16_mask(blended, t1);
+    }
+
+    bool any_changed = (changed != 0);
+    any_changed |= BlendScalar(T1 + i, T2 + i, vec_length - i);
+    return any_changed;
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("avx512f,avx512bw") static bool BlendNccSumsAvx512(feature_t* T1, const feature_t* T2, uint32_t vec_length, NccSums& sums)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m512i corr = _mm512_setzero_si512();
+    __m512i norm1 = _mm512_setzero_si512();
+    __m512i norm2 = _mm512_setzero_si512();
+    __mmask32 changed = 0;
+
+    uint32_t i = 0;
+    for (; i + 32 <= vec_length; i += 32)
+    {
+        __m512i t1 = _mm512_loadu_si512(reinterpret_cast<const void*>(T1 + i));
+        __m512i t2 = _mm512_loadu_si512(reinterpret_cast<const void*>(T2 + i));
+        __m512i lo = BlendAvx512(_mm512_cvtepi16_epi32(_mm512_castsi512_si256(t1)), _mm512_cvtepi16_epi32(_mm512_castsi512_si256(t2)));
+        __m512i hi =
+            BlendAvx512(_mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(t1, 1)), _mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(t2, 1)));
+        __m512i blended = _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtsepi32_epi16(lo)), _mm512_cvtsepi32_epi16(hi), 1);
+        _mm512_storeu_si512(reinterpret_cast<void*>(T1 + i), blended);
+
+        changed |= _mm512_cmpneq_epi16_mask(blended, t1);
+        corr = _mm512_add_epi32(corr, _mm512_madd_epi16(blended, t2));
+        norm1 = _mm512_add_epi32(norm1, _mm512_madd_epi16(blended, blended));
+        norm2 = _mm512_add_epi32(norm2, _mm512_madd_epi16(t2, t2));
+    }
+
+    bool any_changed = (changed != 0);
+    any_changed |= BlendScalar(T1 + i, T2 + i, vec_length - i);
+
+    sums.corr = _mm512_reduce_add_epi32(corr);
+    sums.norm1 = static_cast<uint32_t>(_mm512_reduce_add_epi32(norm1));
+    sums.norm2 = static_cast<uint32_t>(_mm512_reduce_add_epi32(norm2));
+    AddTail(T1, T2, i, vec_length, sums);
+    return any_changed;
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("avx512f,avx512bw,avx512vnni")
+static void NccSumsAvx512Vnni(const feature_t* T1, const feature_t* T2, uint32_t vec_length, NccSums& sums)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m512i corr = _mm512_setzero_si512();
+    __m512i norm1 = _mm512_setzero_si512();
+    __m512i norm2 = _mm512_setzero_si512();
+
+    uint32_t i = 0;
+    for (; i + 32 <= vec_length; i += 32)
+    {
+        __m512i t1 = _mm512_loadu_si512(reinterpret_cast<const void*>(T1 + i));
+        __m512i t2 = _mm512_loadu_si512(reinterpret_cast<const void*>(T2 + i));
+        corr = _mm512_dpwssd_epi32(corr, t1, t2);
+        norm1 = _mm512_dpwssd_epi32(norm1, t1, t1);
+        norm2 = _mm512_dpwssd_epi32(norm2, t2, t2);
+    }
+
+    sums.corr = _mm512_reduce_add_epi32(corr);
+    sums.norm1 = static_cast<uint32_t>(_mm512_reduce_add_epi32(norm1));
+    sums.norm2 = static_cast<uint32_t>(_mm512_reduce_add_epi32(norm2));
+    AddTail(T1, T2, i, vec_length, sums);
+}
+
+template <uint32_t FixedLength>
+RSID_TARGET("avx512f,avx512bw,avx512vnni")
+static int32_t DotAvx512Vnni(const feature_t* T1, const feature_t* T2, uint32_t vec_length)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    __m512i corr0 = _mm512_setzero_si512();
+    __m512i corr1 = _mm512_setzero_si512();
+
+    uint32_t i = 0;
+    for (; i + 64 <= vec_length; i += 64)
+    {
+        __m512i a0 = _mm512_loadu_si512(reinterpret_cast<const void*>(T1 + i));
+        __m512i b0 = _mm512_loadu_si512(reinterpret_cast<const void*>(T2 + i));
+        __m512i a1 = _mm512_loadu_si512(reinterpret_cast<const void*>(T1 + i + 32));
+        __m512i b1 = _mm512_loadu_si512(reinterpret_cast<const void*>(T2 + i + 32));
+        corr0 = _mm512_dpwssd_epi32(corr0, a0, b0);
+        corr1 = _mm512_dpwssd_epi32(corr1, a1, b1);
+    }
+    for (; i + 32 <= vec_length; i += 32)
+    {
+        __m512i a0 = _mm512_loadu_si512(reinterpret_cast<const void*>(T1 + i));
+        __m512i b0 = _mm512_loadu_si512(reinterpret_cast<const void*>(T2 + i));
+        corr0 = _mm512_dpwssd_epi32(corr0, a0, b0);
+    }
+
+    uint32_t corr = static_cast<uint32_t>(_mm512_reduce_add_epi32(_mm512_add_epi32(corr0, corr1)));
+    return static_cast<int32_t>(corr + static_cast<uint32_t>(DotScalar<0>(T1 + i, T2 + i, vec_length - i)));
+}
+
+// vpdpbusd multiplies unsigned by signed bytes, so T1 is biased to unsigned (t1 + 128, a xor with 0x80) and the bias
+// is removed at the end: sum((t1 + 128) * t2) - 128 * sum(t2). products are accumulated in 32 bit without saturation.
+template <uint32_t FixedLength>
+RSID_TARGET("avx512f,avx512bw,avx512vnni")
+static int32_t DotI8Avx512Vnni(const int8_t* T1, const int8_t* T2, uint32_t vec_length)
+{
+    vec_length = KernelLength<FixedLength>(vec_length);
+
+    const __m512i bias = _mm512_set1_epi8(static_cast<char>(0x80));
+    const __m512i ones = _mm512_set1_epi8(1);
+    __m512i corr = _mm512_setzero_si512();
+    __m512i sum2 = _mm512_setzero_si512();
+
+    uint32_t i = 0;
+    for (; i + 64 <= vec_length; i += 64)
+    {
+        __m512i t1 = _mm512_xor_si512(_mm512_loadu_si512(reinterpret_cast<const void*>(T1 + i)), bias);
+        __m512i t2 = _mm512_loadu_si512(reinterpret_cast<const void*>(T2 + i));
+        corr = _mm512_dpbusd_epi32(corr, t1, t2);
+        sum2 = _mm512_dpbusd_epi32(sum2, ones, t2);
+    }
+
+    int32_t dot = _mm512_reduce_add_epi32(corr) - 128 * _mm512_reduce_add_epi32(sum2);
+    return dot + DotI8Scalar<0>(T1 + i, T2 + i, vec_length - i);
+}
+#endif // RSID_ARCH_X86
+
+void QuantizeToInt8(const feature_t* src, int8_t* dst, uint32_t vec_length)
+{
+    for (uint32_t i = 0; i < vec_length; ++i)
+    {
+        int32_t q = static_cast<int32_t>(src[i]) >> RSID_MATCHER_QUANTIZATION_SHIFT;
+        dst[i] = static_cast<int8_t>(std::max(-128, std::min(127, q)));
+    }
+}
+
+// per instruction set: the generic kernels and the ones specialized for SpecializedLength.
+static const KernelTable s_scalarKernels[] = {
+    {Isa::Scalar, "scalar", 0, NccSumsScalar<0>, DotScalar<0>, DotI8Scalar<0>, BlendAverageScalar<0>, BlendNccSumsScalar<0>},
+    {Isa::Scalar, "scalar", SpecializedLength, NccSumsScalar<SpecializedLength>, DotScalar<SpecializedLength>,
+     DotI8Scalar<SpecializedLength>, BlendAverageScalar<SpecializedLength>, BlendNccSumsScalar<SpecializedLength>}};
+#if RSID_ARCH_X86
+static const KernelTable s_sse41Kernels[] = {
+    {Isa::Sse41, "sse4.1", 0, NccSumsSse41<0>, DotSse41<0>, DotI8Sse41<0>, BlendAverageSse41<0>, BlendNccSumsSse41<0>},
+    {Isa::Sse41, "sse4.1", SpecializedLength, NccSumsSse41<SpecializedLength>, DotSse41<SpecializedLength>,
+     DotI8Sse41<SpecializedLength>, BlendAverageSse41<SpecializedLength>, BlendNccSumsSse41<SpecializedLength>}};
+static const KernelTable s_avx2Kernels[] = {
+    {Isa::Avx2, "avx2", 0, NccSumsAvx2<0>, DotAvx2<0>, DotI8Avx2<0>, BlendAverageAvx2<0>, BlendNccSumsAvx2<0>},
+    {Isa::Avx2, "avx2", SpecializedLength, NccSumsAvx2<SpecializedLength>, DotAvx2<SpecializedLength>, DotI8Avx2<SpecializedLength>,
+     BlendAverageAvx2<SpecializedLength>, BlendNccSumsAvx2<SpecializedLength>}};
+static const KernelTable s_avx512Kernels[] = {
+    {Isa::Avx512, "avx512", 0, NccSumsAvx512<0>, DotAvx512<0>, DotI8Avx512<0>, BlendAverageAvx512<0>, BlendNccSumsAvx512<0>},
+    {Isa::Avx512, "avx512", SpecializedLength, NccSumsAvx512<SpecializedLength>, DotAvx512<SpecializedLength>,
+     DotI8Avx512<SpecializedLength>, BlendAverageAvx512<SpecializedLength>, BlendNccSumsAvx512<SpecializedLength>}};
+static const KernelTable s_avx512VnniKernels[] = {
+    {Isa::Avx512Vnni, "avx512-vnni", 0, NccSumsAvx512Vnni<0>, DotAvx512Vnni<0>, DotI8Avx512Vnni<0>, BlendAverageAvx512<0>,
+     BlendNccSumsAvx512<0>},
+    {Isa::Avx512Vnni, "avx512-vnni", SpecializedLength, NccSumsAvx512Vnni<SpecializedLength>, DotAvx512Vnni<SpecializedLength>,
+     DotI8Avx512Vnni<SpecializedLength>, BlendAverageAvx512<SpecializedLength>, BlendNccSumsAvx512<SpecializedLength>}};
+#endif
+
+// both tables (generic, specialized) of an instruction set, or nullptr if not supported by the running cpu.
+static const KernelTable* TablesForIsa(Isa isa)
+{
+#if RSID_ARCH_X86
+    const CpuFeatures& cpu = GetCpuFeatures();
+    switch (isa)
+    {
+    case Isa::Scalar:
+        return s_scalarKernels;
+    case Isa::Sse41:
+        return cpu.sse41 ? s_sse41Kernels : nullptr;
+    case Isa::Avx2:
+        return cpu.avx2 ? s_avx2Kernels : nullptr;
+    case Isa::Avx512:
+        return cpu.avx512bw ? s_avx512Kernels : nullptr;
+    case Isa::Avx512Vnni:
+        return cpu.avx512vnni ? s_avx512VnniKernels : nullptr;
+    default:
+        return nullptr;
+    }
+#else
+    return (isa == Isa::Scalar) ? s_scalarKernels : nullptr;
+#endif
+}
+
+static inline const KernelTable& SelectLength(const KernelTable* tables, uint32_t vec_length)
+{
+    return tables[(vec_length == SpecializedLength) ? 1 : 0];
+}
+
+const KernelTable* ForIsa(Isa isa, uint32_t vec_length)
+{
+    const KernelTable* tables = TablesForIsa(isa);
+    return (tables != nullptr) ? &SelectLength(tables, vec_length) : nullptr;
+}
+
+static const KernelTable* SelectBestTables()
+{
+    for (int isa = static_cast<int>(Isa::NumIsas) - 1; isa > static_cast<int>(Isa::Scalar); isa--)
+    {
+        const KernelTable* tables = TablesForIsa(static_cast<Isa>(isa));
+        if (tables != nullptr)
+        {
+            return tables;
+        }
+    }
+    return s_scalarKernels;
+}
+
+const KernelTable& Active(uint32_t vec_length)
+{
+    static const KernelTable* tables = SelectBestTables();
+    return SelectLength(tables, vec_length);
+}
+} // namespace MatcherKernels
+} // namespace RealSenseID
@@ -0,0 +1,78 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+// Low level matcher kernels with runtime cpu dispatch.
+// Every implementation produces bit-identical sums to the scalar reference, so the integer ncc grade computed
+// from them never depends on the selected instruction set.
+
+#include "RealSenseID/FaceprintsDefines.h"
+#include <stdint.h>
+
+namespace RealSenseID
+{
+namespace MatcherKernels
+{
+enum class Isa
+{
+    Scalar = 0,
+    Sse41,
+    Avx2,
+    Avx512,
+    Avx512Vnni,
+    NumIsas
+};
+
+// raw ncc accumulators of two vectors (modulo 2^32, like the original scalar loop).
+struct NccSums
+{
+    int32_t corr = 0;
+    uint32_t norm1 = 0;
+    uint32_t norm2 = 0;
+};
+
+using NccSumsFn = void (*)(const feature_t* T1, const feature_t* T2, uint32_t vec_length, NccSums& sums);
+
+// correlation only (modulo 2^32). used when both vectors norms are already known.
+using DotFn = int32_t (*)(const feature_t* T1, const feature_t* T2, uint32_t vec_length);
+
+// correlation of two int8 quantized vectors (see QuantizeToInt8()). exact, no saturation.
+using DotI8Fn = int32_t (*)(const int8_t* T1, const int8_t* T2, uint32_t vec_length);
+
+// adaptive update step: T1 = round((30 * T1 + T2) / 31) in place (see Matcher::BlendAverageVector()). returns false if
+// no feature of T1 changed.
+using BlendFn = bool (*)(feature_t* T1, const feature_t* T2, uint32_t vec_length);
+
+// the same step fused with the ncc sums of its result: T1 = round((30 * T1 + T2) / 31) in place (see
+// Matcher::BlendAverageVector()), then sums = ncc sums of (T1, T2). returns false if no feature of T1 changed, i.e.
+// T1 is a fixed point of the blend.
+using BlendNccSumsFn = bool (*)(feature_t* T1, const feature_t* T2, uint32_t vec_length, NccSums& sums);
+
+struct KernelTable
+{
+    Isa isa;
+    const char* name;
+    // 0 for the generic kernels. else the kernels only support (and ignore) vec_length == fixed_length.
+    uint32_t fixed_length;
+    NccSumsFn ncc_sums;
+    DotFn dot;
+    DotI8Fn dot_i8;
+    BlendFn blend;
+    BlendNccSumsFn blend_ncc_sums;
+};
+
+// int8 quantization of a feature vector for coarse (approximate) search: features in range [-1023,+1023] are
+// arithmetically shifted right by RSID_MATCHER_QUANTIZATION_SHIFT into [-128,+127].
+void QuantizeToInt8(const feature_t* src, int8_t* dst, uint32_t vec_length);
+
+// best kernels supported by the running cpu for vectors of vec_length features. resolved once. for the recognition
+// vectors length (RSID_NUM_OF_RECOGNITION_FEATURES) these are kernels specialized at compile time for it (unrolled,
+// no tails). for any other length, or with the default 0 (length not known in advance), the generic kernels.
+const KernelTable& Active(uint32_t vec_length = 0);
+
+// kernels of a specific instruction set (see Active() for vec_length), or nullptr if not supported by the running cpu
+// (or not compiled in).
+const KernelTable* ForIsa(Isa isa, uint32_t vec_length = 0);
+} // namespace MatcherKernels
+} // namespace RealSenseID
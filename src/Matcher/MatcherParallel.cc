@@ -0,0 +1,168 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "MatcherParallel.h"
+#include "Logger.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace RealSenseID
+{
+namespace MatcherParallel
+{
+static const char* LOG_TAG = "MatcherParallel";
+
+unsigned int ThreadsFor(size_t num_items, unsigned int num_threads)
+{
+    if (num_threads == 0)
+    {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(num_threads, num_items)));
+}
+
+namespace
+{
+// a parallel for call handed to the pool: the items are picked up dynamically from next_item.
+struct Job
+{
+    const std::function<void(size_t item, unsigned int thread_index)>* work;
+    size_t num_items;
+    std::atomic<size_t> next_item {0};
+    unsigned int num_helpers = 0;
+
+    void Run(unsigned int thread_index)
+    {
+        for (size_t item = next_item++; item < num_items; item = next_item++)
+        {
+            (*work)(item, thread_index);
+        }
+    }
+};
+
+// worker threads kept for the life of the process, so a scan doesn't pay for starting and joining threads (tens of
+// microseconds each) on every call. the pool grows on demand to the largest number of helpers asked for and runs one
+// job at a time; worker i is thread_index i + 1 of the jobs that have more than i helpers.
+class WorkerPool
+{
+public:
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (auto& thread : _threads)
+        {
+            thread.join();
+        }
+    }
+
+    // false if the pool is already running a job (another scan, or a ParallelFor() nested in a work item).
+    bool TryRun(size_t num_items, unsigned int num_threads, const std::function<void(size_t item, unsigned int thread_index)>& work)
+    {
+        std::unique_lock<std::mutex> run_lock(_runMutex, std::try_to_lock);
+        if (!run_lock.owns_lock())
+        {
+            return false;
+        }
+
+        Job job;
+        job.work = &work;
+        job.num_items = num_items;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            try
+            {
+                while (_threads.size() < num_threads - 1)
+                {
+                    _threads.emplace_back(&WorkerPool::WorkerLoop, this, static_cast<unsigned int>(_threads.size()));
+                }
+            }
+            catch (const std::system_error& ex)
+            {
+                // not fatal - the items are picked up by the threads that did start (at least the calling one).
+                LOG_EXCEPTION(LOG_TAG, ex);
+            }
+            job.num_helpers = static_cast<unsigned int>(std::min<size_t>(_threads.size(), num_threads - 1));
+            _job = &job;
+            _active = job.num_helpers;
+            _generation++;
+        }
+        _wake.notify_all();
+
+        job.Run(0);
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this] { return _active == 0; });
+        _job = nullptr;
+        return true;
+    }
+
+private:
+    void WorkerLoop(unsigned int worker)
+    {
+        uint64_t seen_generation = 0;
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (;;)
+        {
+            _wake.wait(lock, [&] { return _stop || _generation != seen_generation; });
+            if (_stop)
+            {
+                return;
+            }
+            seen_generation = _generation;
+            // a worker that sat out a job may wake after it is done (no job), or after later ones were started
+            Job* job = _job;
+            if (job == nullptr || worker >= job->num_helpers)
+            {
+                continue;
+            }
+
+            lock.unlock();
+            job->Run(worker + 1);
+            lock.lock();
+            if (--_active == 0)
+            {
+                _done.notify_one();
+            }
+        }
+    }
+
+    std::mutex _runMutex;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    std::vector<std::thread> _threads;
+    Job* _job = nullptr;
+    unsigned int _active = 0;
+    uint64_t _generation = 0;
+    bool _stop = false;
+};
+} // namespace
+
+void ParallelFor(size_t num_items, unsigned int num_threads, const std::function<void(size_t item, unsigned int thread_index)>& work)
+{
+    static WorkerPool pool;
+
+    if (num_threads > 1 && pool.TryRun(num_items, num_threads, work))
+    {
+        return;
+    }
+
+    // a single thread, or the pool is busy: the calling thread runs all the items (the concurrent scans already keep
+    // the cores busy, and a nested call can't wait for the pool it runs on).
+    for (size_t item = 0; item < num_items; item++)
+    {
+        work(item, 0);
+    }
+}
+} // namespace MatcherParallel
+} // namespace RealSenseID
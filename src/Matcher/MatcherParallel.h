@@ -0,0 +1,55 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "MatcherImplDefines.h"
+#include <algorithm>
+#include <functional>
+#include <stddef.h>
+
+namespace RealSenseID
+{
+// Work sharing and cache blocking of the matcher's scans (the 1:N shards, Matcher::MatchBatch(), the near duplicates
+// scan and ThresholdSweep).
+namespace MatcherParallel
+{
+// number of threads to run num_items work items with: num_threads (0 - number of hardware threads), but at most
+// num_items and at least 1.
+unsigned int ThreadsFor(size_t num_items, unsigned int num_threads);
+
+// run work(item, thread_index) for every item in [0, num_items), and return when all are done. the items are picked
+// up dynamically by num_threads threads (see ThreadsFor()), the calling thread is thread 0 - so per thread state can
+// be kept in num_threads slots indexed by thread_index. the other threads come from a pool of worker threads that is
+// kept for the life of the process. if some threads can't be started, their items are run by the threads that did
+// start, and while the pool runs another call (a concurrent scan, or a call from inside work) the calling thread runs
+// all the items.
+void ParallelFor(size_t num_items, unsigned int num_threads, const std::function<void(size_t item, unsigned int thread_index)>& work);
+
+// probes x gallery scans are split to blocks of RSID_MATCHER_BATCH_PROBES_BLOCK probes.
+inline size_t NumProbeBlocks(size_t num_probes)
+{
+    return (num_probes + RSID_MATCHER_BATCH_PROBES_BLOCK - 1) / RSID_MATCHER_BATCH_PROBES_BLOCK;
+}
+
+// score_tile(probe, tile_begin, tile_end) for every probe of the block and every tile of RSID_MATCHER_BATCH_GALLERY_TILE
+// gallery users: all the probes of the block are scored against a tile while it is still in the L2 cache, so the
+// gallery is streamed from memory once per block instead of once per probe. tiles are visited in index order.
+template <typename ScoreTileFn>
+void ScanProbeBlock(size_t block, size_t num_probes, size_t num_users, ScoreTileFn&& score_tile)
+{
+    const size_t block_begin = block * RSID_MATCHER_BATCH_PROBES_BLOCK;
+    const size_t block_end = std::min(block_begin + RSID_MATCHER_BATCH_PROBES_BLOCK, num_probes);
+
+    for (size_t tile_begin = 0; tile_begin < num_users; tile_begin += RSID_MATCHER_BATCH_GALLERY_TILE)
+    {
+        const size_t tile_end = std::min(tile_begin + RSID_MATCHER_BATCH_GALLERY_TILE, num_users);
+
+        for (size_t probe = block_begin; probe < block_end; probe++)
+        {
+            score_tile(probe, tile_begin, tile_end);
+        }
+    }
+}
+} // namespace MatcherParallel
+} // namespace RealSenseID
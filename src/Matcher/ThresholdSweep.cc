@@ -0,0 +1,220 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#include "ThresholdSweep.h"
+#include "MatcherKernels.h"
+#include "MatcherParallel.h"
+#include "FaceprintsGallery.h"
+#include "Logger.h"
+#include <algorithm>
+
+namespace RealSenseID
+{
+static const char* LOG_TAG = "ThresholdSweep";
+
+void ScoreHistogram::Merge(const ScoreHistogram& other)
+{
+    for (size_t bin = 0; bin < NumBins; bin++)
+    {
+        _bins[bin] += other._bins[bin];
+    }
+    _count += other._count;
+}
+
+uint64_t ScoreHistogram::CountAtLeast(match_calc_t threshold) const
+{
+    uint64_t count = 0;
+    for (size_t bin = static_cast<size_t>(std::max<int>(threshold, 0)); bin < NumBins; bin++)
+    {
+        count += _bins[bin];
+    }
+    return count;
+}
+
+namespace
+{
+struct SweepProbe
+{
+    const feature_t* vector = nullptr;
+    NccNorm norm;
+    bool hasMask = false;
+    int label = 0;
+};
+} // namespace
+
+bool ThresholdSweep::Accumulate(const std::vector<MatchElement>& probes, const std::vector<int>& probe_labels,
+                                const FaceprintsGallery& gallery, const std::vector<int>& gallery_labels, unsigned int num_threads)
+{
+    if (probe_labels.size() != probes.size() || gallery_labels.size() != gallery.Size())
+    {
+        LOG_ERROR(LOG_TAG, "Labels size mismatch: %zu probes, %zu probe labels, %zu users, %zu user labels", probes.size(),
+                  probe_labels.size(), gallery.Size(), gallery_labels.size());
+        return false;
+    }
+
+    if (gallery.Empty())
+    {
+        return true;
+    }
+
+    int galleryVersion = 0;
+    if (!gallery.CommonVersion(galleryVersion))
+    {
+        LOG_ERROR(LOG_TAG, "Gallery users mix faceprints versions.");
+        return false;
+    }
+
+    std::vector<SweepProbe> sweepProbes;
+    sweepProbes.reserve(probes.size());
+    for (size_t i = 0; i < probes.size(); i++)
+    {
+        const MatchElement& probe_faceprints = probes[i];
+        if (!Matcher::ValidateFaceprints(probe_faceprints) || probe_faceprints.data.version != galleryVersion)
+        {
+            LOG_ERROR(LOG_TAG, "Probe %zu : failed validation or version mismatch. Skipping it!", i);
+            continue;
+        }
+
+        SweepProbe probe;
+        probe.vector = &probe_faceprints.data.featuresVector[0];
+        probe.norm = Matcher::ComputeNccNorm(probe.vector);
+        probe.hasMask =
+            (probe_faceprints.data.featuresVector[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS] == FaVectorFlagsEnum::VecFlagValidWithMask);
+        probe.label = probe_labels[i];
+        sweepProbes.push_back(probe);
+    }
+
+    // pairs class of each user for probes without / with mask (see Matcher::HandleThresholdsConfiguration()), so the
+    // scan doesn't read the cold faceprints.
+    const size_t num_users = gallery.Size();
+    std::vector<uint8_t> noMaskClasses(num_users), maskClasses(num_users);
+    for (size_t j = 0; j < num_users; j++)
+    {
+#if (RSID_MATCHER_SCAN_CHECKS)
+        if (!gallery.ValidateUser(j, galleryVersion))
+        {
+            return false;
+        }
+#endif
+
+        const bool rgb_enrolled = (gallery.GetFaceprints(j).data.featuresType == FaceprintsTypeEnum::RGB);
+        noMaskClasses[j] = static_cast<uint8_t>(ClassOf(ThresholdsConfigEnum::ThresholdConfig_pNM_gNM, rgb_enrolled));
+        maskClasses[j] = static_cast<uint8_t>(ClassOf(
+            gallery.HasValidMaskVector(j) ? ThresholdsConfigEnum::ThresholdConfig_pM_gM : ThresholdsConfigEnum::ThresholdConfig_pM_gNM,
+            rgb_enrolled));
+    }
+
+    // cache blocking like Matcher::MatchBatch() (MatcherParallel::ScanProbeBlock()). the probe blocks are split over
+    // num_threads threads, each with its own histograms.
+    const uint32_t vec_length = RSID_NUM_OF_RECOGNITION_FEATURES;
+    const MatcherKernels::DotFn dot = MatcherKernels::Active(vec_length).dot;
+    const size_t num_blocks = MatcherParallel::NumProbeBlocks(sweepProbes.size());
+    num_threads = MatcherParallel::ThreadsFor(num_blocks, num_threads);
+
+    // the calling thread adds to this sweep directly.
+    std::vector<ThresholdSweep> threadSweeps(num_threads - 1);
+
+    MatcherParallel::ParallelFor(num_blocks, num_threads, [&](size_t block, unsigned int thread_index) {
+        ThresholdSweep& sweep = (thread_index == 0) ? *this : threadSweeps[thread_index - 1];
+        MatcherParallel::ScanProbeBlock(block, sweepProbes.size(), num_users, [&](size_t p, size_t tile_begin, size_t tile_end) {
+            const SweepProbe& probe = sweepProbes[p];
+            const uint8_t* classes = probe.hasMask ? maskClasses.data() : noMaskClasses.data();
+
+            for (size_t j = tile_begin; j < tile_end; j++)
+            {
+                int32_t corr = dot(probe.vector, gallery.ActiveVector(j, probe.hasMask), vec_length);
+                match_calc_t score = Matcher::ComputeNccGrade(corr, probe.norm, gallery.ActiveNorm(j, probe.hasMask));
+                (probe.label == gallery_labels[j] ? sweep._genuine : sweep._impostor)[classes[j]].Add(score);
+            }
+        });
+    });
+
+    for (const auto& sweep : threadSweeps)
+    {
+        Merge(sweep);
+    }
+
+    return true;
+}
+
+void ThresholdSweep::Merge(const ThresholdSweep& other)
+{
+    for (size_t c = 0; c < NumClasses; c++)
+    {
+        _genuine[c].Merge(other._genuine[c]);
+        _impostor[c].Merge(other._impostor[c]);
+    }
+}
+
+void ThresholdSweep::Clear()
+{
+    *this = ThresholdSweep();
+}
+
+OperatingPoint ThresholdSweep::At(const Thresholds& thresholds) const
+{
+    OperatingPoint point;
+    for (int config = 0; config < NumThresholdConfigs; config++)
+    {
+        for (int rgb = 0; rgb < 2; rgb++)
+        {
+            const size_t c = ClassOf(static_cast<ThresholdsConfigEnum>(config), rgb != 0);
+            const match_calc_t threshold = Matcher::StrongThreshold(thresholds, static_cast<ThresholdsConfigEnum>(config), rgb != 0);
+            point.genuine += _genuine[c].Count();
+            point.impostor += _impostor[c].Count();
+            point.falseRejects += _genuine[c].Count() - _genuine[c].CountAbove(threshold);
+            point.falseAccepts += _impostor[c].CountAbove(threshold);
+        }
+    }
+    return point;
+}
+
+OperatingPoint ThresholdSweep::At(const ThresholdsConfidenceEnum confidenceLevel) const
+{
+    Thresholds thresholds;
+    Matcher::SetToDefaultThresholds(thresholds, confidenceLevel);
+    return At(thresholds);
+}
+
+OperatingPoint ThresholdSweep::At(const ThresholdsConfigEnum config, const match_calc_t threshold) const
+{
+    OperatingPoint point;
+    point.threshold = threshold;
+    for (int rgb = 0; rgb < 2; rgb++)
+    {
+        const size_t c = ClassOf(config, rgb != 0);
+        point.genuine += _genuine[c].Count();
+        point.impostor += _impostor[c].Count();
+        point.falseRejects += _genuine[c].Count() - _genuine[c].CountAbove(threshold);
+        point.falseAccepts += _impostor[c].CountAbove(threshold);
+    }
+    return point;
+}
+
+// one pass over the bins, from the highest threshold down.
+std::vector<OperatingPoint> ThresholdSweep::Curve(const ThresholdsConfigEnum config) const
+{
+    std::vector<OperatingPoint> curve(ScoreHistogram::NumBins);
+    const size_t c0 = ClassOf(config, false);
+    const size_t c1 = ClassOf(config, true);
+    const uint64_t genuine = _genuine[c0].Count() + _genuine[c1].Count();
+    const uint64_t impostor = _impostor[c0].Count() + _impostor[c1].Count();
+
+    // the scores above the threshold of each point are the bins after it.
+    uint64_t genuineAbove = 0;
+    uint64_t impostorAbove = 0;
+    for (size_t bin = ScoreHistogram::NumBins; bin-- > 0;)
+    {
+        OperatingPoint& point = curve[bin];
+        point.threshold = static_cast<match_calc_t>(bin);
+        point.genuine = genuine;
+        point.impostor = impostor;
+        point.falseRejects = genuine - genuineAbove;
+        point.falseAccepts = impostorAbove;
+
+        genuineAbove += _genuine[c0].Bin(bin) + _genuine[c1].Bin(bin);
+        impostorAbove += _impostor[c0].Bin(bin) + _impostor[c1].Bin(bin);
+    }
+    return curve;
+}
+} // namespace RealSenseID
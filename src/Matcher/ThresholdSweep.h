@@ -0,0 +1,140 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "Matcher.h"
+#include "RealSenseID/Faceprints.h"
+#include "RealSenseID/MatcherDefines.h"
+#include <vector>
+#include <stdint.h>
+
+namespace RealSenseID
+{
+class FaceprintsGallery;
+
+// histogram of ncc scores, one bin per score in [0, RSID_MAX_POSSIBLE_SCORE].
+class ScoreHistogram
+{
+public:
+    static constexpr size_t NumBins = RSID_MAX_POSSIBLE_SCORE + 1;
+
+    ScoreHistogram() : _bins(NumBins, 0)
+    {
+    }
+
+    void Add(match_calc_t score)
+    {
+        const int bin = score < 0 ? 0 : (score > RSID_MAX_POSSIBLE_SCORE ? RSID_MAX_POSSIBLE_SCORE : score);
+        _bins[bin]++;
+        _count++;
+    }
+
+    void Merge(const ScoreHistogram& other);
+
+    uint64_t Count() const
+    {
+        return _count;
+    }
+
+    uint64_t Bin(size_t score) const
+    {
+        return _bins[score];
+    }
+
+    // number of scores >= threshold.
+    uint64_t CountAtLeast(match_calc_t threshold) const;
+
+    // number of scores > threshold, the scores the matcher accepts at strong threshold threshold.
+    uint64_t CountAbove(match_calc_t threshold) const
+    {
+        return threshold >= RSID_MAX_POSSIBLE_SCORE ? 0 : CountAtLeast(static_cast<match_calc_t>(threshold + 1));
+    }
+
+private:
+    std::vector<uint64_t> _bins;
+    uint64_t _count = 0;
+};
+
+// false accept / false reject counts of the genuine and impostor pairs at a threshold (or thresholds set). like the
+// matcher, a pair is accepted if its score is above the threshold.
+struct OperatingPoint
+{
+    match_calc_t threshold = 0; // 0 for a thresholds set (each pair vs. the strong threshold of its configuration)
+    uint64_t genuine = 0;
+    uint64_t impostor = 0;
+    uint64_t falseRejects = 0; // genuine pairs scored at most the threshold
+    uint64_t falseAccepts = 0; // impostor pairs scored above the threshold
+
+    double Frr() const
+    {
+        return genuine > 0 ? static_cast<double>(falseRejects) / static_cast<double>(genuine) : 0.0;
+    }
+
+    double Far() const
+    {
+        return impostor > 0 ? static_cast<double>(falseAccepts) / static_cast<double>(impostor) : 0.0;
+    }
+};
+
+// Threshold sweep (ROC) evaluation of labelled faceprints: probes vs. gallery users, where a pair is genuine if both
+// have the same label and impostor otherwise.
+//
+// Accumulate() scores every probe against every gallery user with the 1:N scan kernels and cached norms (cache-blocked
+// like Matcher::MatchBatch(), split over threads), and only keeps genuine and impostor score histograms - so memory
+// stays bounded whatever the number of pairs, and large sets can be fed in chunks of probes.
+//
+// The histograms are kept per thresholds configuration (probe / gallery mask, ThresholdsConfigEnum) and gallery
+// enrollment type (rgb image or not), so a thresholds set gives the same accept decision as the matcher: each pair is
+// accepted if its score is above the strong threshold of its configuration (a 1:1 verification decision).
+class ThresholdSweep
+{
+public:
+    // score the probes against the gallery users and add the scores to the histograms. labels are per probe and per
+    // gallery user. probes that fail validation or don't have the gallery faceprints version are skipped.
+    // returns false if labels sizes mismatch or the gallery users mix faceprints versions. the gallery must not be
+    // updated while it's scored (see FaceprintsGallery).
+    bool Accumulate(const std::vector<MatchElement>& probes, const std::vector<int>& probe_labels, const FaceprintsGallery& gallery,
+                    const std::vector<int>& gallery_labels, const unsigned int num_threads = 0);
+
+    // add the histograms of another sweep (e.g. of another chunk of probes).
+    void Merge(const ThresholdSweep& other);
+
+    void Clear();
+
+    // far / frr of the strong thresholds decision with the given thresholds set, over all pairs.
+    OperatingPoint At(const Thresholds& thresholds) const;
+
+    // same, with the default thresholds set of the confidence level (see MatcherImplDefines.h).
+    OperatingPoint At(const ThresholdsConfidenceEnum confidenceLevel) const;
+
+    // far / frr of the pairs of one configuration at a single threshold.
+    OperatingPoint At(const ThresholdsConfigEnum config, const match_calc_t threshold) const;
+
+    // far / frr curve of the pairs of one configuration: one operating point per threshold in
+    // [0, RSID_MAX_POSSIBLE_SCORE].
+    std::vector<OperatingPoint> Curve(const ThresholdsConfigEnum config) const;
+
+    const ScoreHistogram& Genuine(const ThresholdsConfigEnum config, const bool rgb_enrolled) const
+    {
+        return _genuine[ClassOf(config, rgb_enrolled)];
+    }
+
+    const ScoreHistogram& Impostor(const ThresholdsConfigEnum config, const bool rgb_enrolled) const
+    {
+        return _impostor[ClassOf(config, rgb_enrolled)];
+    }
+
+private:
+    // pairs class: thresholds configuration and gallery enrollment type.
+    static constexpr size_t NumClasses = NumThresholdConfigs * 2;
+
+    static size_t ClassOf(const ThresholdsConfigEnum config, const bool rgb_enrolled)
+    {
+        return static_cast<size_t>(config) * 2 + (rgb_enrolled ? 1 : 0);
+    }
+
+    ScoreHistogram _genuine[NumClasses];
+    ScoreHistogram _impostor[NumClasses];
+};
+} // namespace RealSenseID
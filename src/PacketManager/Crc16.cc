@@ -5,7 +5,7 @@
 
 // crc-16/aug-ccitt (initial=0x1d0f, polynom=0x1021)
 
-static const uint16_t CRC16_LOOKUP[256] = {
+static constexpr uint16_t CRC16_LOOKUP[256] = {
     0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7, 0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
     0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6, 0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
     0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485, 0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
@@ -25,16 +25,51 @@ static const uint16_t CRC16_LOOKUP[256] = {
 
 static constexpr unsigned int CRC16_INITIAL_VAL = 0x1d0f;
 
+// slicing by 8: slice k holds the crc of a byte followed by k zero bytes, so 8 bytes are folded with 8 independent
+// lookups instead of 8 dependent ones.
+struct Crc16Slices
+{
+    uint16_t slice[8][256];
+};
+
+static constexpr Crc16Slices MakeCrc16Slices()
+{
+    Crc16Slices slices {};
+    for (unsigned int i = 0; i < 256; i++)
+    {
+        slices.slice[0][i] = CRC16_LOOKUP[i];
+    }
+    for (unsigned int k = 1; k < 8; k++)
+    {
+        for (unsigned int i = 0; i < 256; i++)
+        {
+            unsigned int prev = slices.slice[k - 1][i];
+            slices.slice[k][i] = static_cast<uint16_t>((prev << 8) ^ CRC16_LOOKUP[prev >> 8]);
+        }
+    }
+    return slices;
+}
+
+static constexpr Crc16Slices CRC16_SLICES = MakeCrc16Slices();
 
 uint16_t RealSenseID::PacketManager::Crc16(uint16_t initial_crc, const char* buffer, std::size_t bufferSize)
 {
     unsigned int crc = initial_crc;
-    auto* bytePtr = buffer;
+    auto* bytePtr = reinterpret_cast<const unsigned char*>(buffer);
+    const auto& slice = CRC16_SLICES.slice;
+
+    while (bufferSize >= 8)
+    {
+        crc = slice[7][bytePtr[0] ^ (crc >> 8)] ^ slice[6][bytePtr[1] ^ (crc & 0xff)] ^ slice[5][bytePtr[2]] ^ slice[4][bytePtr[3]] ^
+              slice[3][bytePtr[4]] ^ slice[2][bytePtr[5]] ^ slice[1][bytePtr[6]] ^ slice[0][bytePtr[7]];
+        bytePtr += 8;
+        bufferSize -= 8;
+    }
 
     while (bufferSize-- > 0)
     {
         auto idx = ((crc >> 8) ^ *bytePtr) & 0xff;
-        crc = CRC16_LOOKUP[idx] ^ (crc << 8);
+        crc = (CRC16_LOOKUP[idx] ^ (crc << 8)) & 0xffff;
         ++bytePtr;
     }
     return static_cast<uint16_t>(crc);
@@ -12,8 +12,13 @@
 #include <fcntl.h>
 #include <string.h>
 #include <termios.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#include <sys/uio.h>
 #include <errno.h>
+#include <algorithm>
 #include <cassert>
+#include <climits>
 #include <cmath>
 
 static const char* LOG_TAG = "LinuxSerial";
@@ -44,11 +49,83 @@ static speed_t to_speed_t(unsigned int baudRate)
         return B57600;
     case 115200:
         return B115200;
+#ifdef B230400
+    case 230400:
+        return B230400;
+#endif
+#ifdef B460800
+    case 460800:
+        return B460800;
+#endif
+#ifdef B500000
+    case 500000:
+        return B500000;
+#endif
+#ifdef B576000
+    case 576000:
+        return B576000;
+#endif
+#ifdef B921600
+    case 921600:
+        return B921600;
+#endif
+#ifdef B1000000
+    case 1000000:
+        return B1000000;
+#endif
+#ifdef B1152000
+    case 1152000:
+        return B1152000;
+#endif
+#ifdef B1500000
+    case 1500000:
+        return B1500000;
+#endif
+#ifdef B2000000
+    case 2000000:
+        return B2000000;
+#endif
+#ifdef B2500000
+    case 2500000:
+        return B2500000;
+#endif
+#ifdef B3000000
+    case 3000000:
+        return B3000000;
+#endif
+#ifdef B3500000
+    case 3500000:
+        return B3500000;
+#endif
+#ifdef B4000000
+    case 4000000:
+        return B4000000;
+#endif
     default:
         return B0;
     }
 }
 
+#ifdef TCGETS2
+// the kernel's termios2 (asm/termbits.h, which can't be included along with <termios.h>): sets any baud rate with
+// BOTHER, which the driver turns to the nearest rate its uart clock divisors can make.
+struct termios2
+{
+    tcflag_t c_iflag;
+    tcflag_t c_oflag;
+    tcflag_t c_cflag;
+    tcflag_t c_lflag;
+    cc_t c_line;
+    cc_t c_cc[19];
+    speed_t c_ispeed;
+    speed_t c_ospeed;
+};
+
+#ifndef BOTHER
+#define BOTHER 0010000
+#endif
+#endif // TCGETS2
+
 namespace RealSenseID
 {
 namespace PacketManager
@@ -76,7 +153,57 @@ static void throw_on_error(int result, const char* err_msg, int handle_to_close)
         throw std::runtime_error(std::string(buf));
     }
 }
-LinuxSerial::LinuxSerial(const SerialConfig& config) : _config {config}
+
+// set a baud rate that has no Bxxx constant. returns -1 (with errno) if failed.
+static int set_custom_baudrate(int handle, unsigned int baudRate)
+{
+#ifdef TCGETS2
+    struct termios2 options;
+    if (::ioctl(handle, TCGETS2, &options) < 0)
+    {
+        return -1;
+    }
+    options.c_cflag &= ~CBAUD;
+    options.c_cflag |= BOTHER;
+    options.c_ispeed = baudRate;
+    options.c_ospeed = baudRate;
+    if (::ioctl(handle, TCSETS2, &options) < 0)
+    {
+        return -1;
+    }
+
+    if (::ioctl(handle, TCGETS2, &options) == 0 && options.c_ospeed != baudRate)
+    {
+        LOG_WARNING(LOG_TAG, "Requested baudrate %u, the port is set to %u", baudRate, static_cast<unsigned int>(options.c_ospeed));
+    }
+    return 0;
+#else
+    (void)handle;
+    (void)baudRate;
+    errno = EINVAL;
+    return -1;
+#endif // TCGETS2
+}
+
+// set the baud rate of an open port, standard rates with cfsetspeed() and others with termios2. returns -1 (with
+// errno) if failed.
+static int set_baudrate(int handle, unsigned int baudRate)
+{
+    auto speed = to_speed_t(baudRate);
+    if (speed == B0)
+    {
+        return set_custom_baudrate(handle, baudRate);
+    }
+
+    struct termios options;
+    if (::tcgetattr(handle, &options) < 0 || ::cfsetispeed(&options, speed) < 0 || ::cfsetospeed(&options, speed) < 0)
+    {
+        return -1;
+    }
+    return ::tcsetattr(handle, TCSANOW, &options);
+}
+
+LinuxSerial::LinuxSerial(const SerialConfig& config) : _config {config}, _recv_buffer(_recv_buffer_size)
 {
     LOG_DEBUG(LOG_TAG, "Opening serial port %s baudrate %u", config.port, config.baudrate);
     _handle = ::open(config.port, O_RDWR | O_NOCTTY);
@@ -88,23 +215,34 @@ LinuxSerial::LinuxSerial(const SerialConfig& config) : _config {config}
     struct termios options;
     ::memset(&options, 0, sizeof(options));
 
-    auto baudRate = to_speed_t(config.baudrate);
-    if (baudRate == B0)
+    if (config.baudrate == 0)
     {
         ::close(_handle);
         throw std::runtime_error("Failed open serial port. Invalid baudrate");
     }
 
+    // rates without a Bxxx constant are set after the port is set up (at B38400 - never B0, which hangs up the line).
+    auto baudRate = to_speed_t(config.baudrate);
+    const bool custom_baudrate = (baudRate == B0);
+    if (custom_baudrate)
+    {
+        baudRate = B38400;
+    }
+
     throw_on_error(::cfsetispeed(&options, baudRate), "cfsetispeed", _handle);
     throw_on_error(::cfsetospeed(&options, baudRate), "cfsetospeed", _handle);
 
-    // return whatever bytes available after 200ms max
-    options.c_cc[VTIME] = 2;
+    // read() returns whatever bytes available without waiting - the receive timeouts are waited in poll().
+    options.c_cc[VTIME] = 0;
     options.c_cc[VMIN] = 0;
     options.c_cflag |= (CLOCAL | CREAD | CS8);
     options.c_iflag |= (IGNPAR | IGNBRK);
 
     throw_on_error(::tcsetattr(_handle, TCSANOW, &options), "tcsetattr", _handle);
+    if (custom_baudrate)
+    {
+        throw_on_error(set_custom_baudrate(_handle, config.baudrate), "Failed set baudrate", _handle);
+    }
 
     // discard any existing data in input/output buffers
     ::tcflush(_handle, TCIOFLUSH);
@@ -112,30 +250,113 @@ LinuxSerial::LinuxSerial(const SerialConfig& config) : _config {config}
 
 SerialStatus LinuxSerial::SendBytes(const char* buffer, size_t n_bytes)
 {
+    SendBuffer send_buffer {buffer, n_bytes};
+    return SendBytesV(&send_buffer, 1);
+}
+
+// the bytes are only queued to the tty, no drain after each write: the device replies after it got them anyway, and
+// Drain() is called where the protocol needs them to be out.
+SerialStatus LinuxSerial::SendBytesV(const SendBuffer* buffers, size_t n_buffers)
+{
+    constexpr size_t max_buffers = 16;
+    if (n_buffers > max_buffers)
+    {
+        return SerialConnection::SendBytesV(buffers, n_buffers);
+    }
+
+    struct iovec iov[max_buffers];
+    size_t n_bytes = 0;
+    for (size_t i = 0; i < n_buffers; i++)
+    {
+        DEBUG_SERIAL(LOG_TAG, "[snd]", buffers[i].data, buffers[i].size);
+        iov[i].iov_base = const_cast<char*>(buffers[i].data);
+        iov[i].iov_len = buffers[i].size;
+        n_bytes += buffers[i].size;
+    }
+
     size_t bytes_sent = 0;
+    size_t first = 0; // first buffer not fully sent
     while (n_bytes > bytes_sent)
     {
-        auto* send_ptr = &buffer[bytes_sent];
-        size_t n_bytes_left = n_bytes - bytes_sent;
-        DEBUG_SERIAL(LOG_TAG, "[snd]", send_ptr, n_bytes_left);
-        auto write_rv = ::write(_handle, send_ptr, n_bytes_left);
+        auto write_rv = ::writev(_handle, &iov[first], static_cast<int>(n_buffers - first));
         if (write_rv <= 0)
         {
-            LOG_ERROR(LOG_TAG, "Error while sending %zu bytes. errno=%d, sent so far: %zu, write rv=%zu", n_bytes, errno, bytes_sent,
+            if (write_rv < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR(LOG_TAG, "Error while sending %zu bytes. errno=%d, sent so far: %zu, write rv=%zd", n_bytes, errno, bytes_sent,
                       write_rv);
             return SerialStatus::SendFailed;
         }
         bytes_sent += static_cast<size_t>(write_rv);
-        ::tcdrain(_handle);
 #ifdef RSID_DEBUG_SERIAL
         LOG_DEBUG(LOG_TAG, "[snd] Sent %zu/%zu", bytes_sent, n_bytes);
 #endif
+
+        // skip the sent buffers and advance the partially sent one
+        size_t written = static_cast<size_t>(write_rv);
+        while (first < n_buffers && written >= iov[first].iov_len)
+        {
+            written -= iov[first].iov_len;
+            first++;
+        }
+        if (first < n_buffers)
+        {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + written;
+            iov[first].iov_len -= written;
+        }
     }
     assert(n_bytes == bytes_sent);
 
     return SerialStatus::Ok;
 }
 
+SerialStatus LinuxSerial::Drain()
+{
+    if (::tcdrain(_handle) < 0)
+    {
+        LOG_ERROR(LOG_TAG, "tcdrain failed. errno=%d error: '%s'", errno, strerror(errno));
+        return SerialStatus::SendFailed;
+    }
+    return SerialStatus::Ok;
+}
+
+// the bytes already sent go out at the current rate, then the new rate applies to the next sends and receives.
+SerialStatus LinuxSerial::SetBaudRate(unsigned int baudrate)
+{
+    if (baudrate == 0)
+    {
+        LOG_ERROR(LOG_TAG, "Invalid baudrate 0");
+        return SerialStatus::OpenFailed;
+    }
+
+    auto status = Drain();
+    if (status != SerialStatus::Ok)
+    {
+        return status;
+    }
+
+    if (set_baudrate(_handle, baudrate) < 0)
+    {
+        LOG_ERROR(LOG_TAG, "Failed set baudrate %u. errno=%d error: '%s'", baudrate, errno, strerror(errno));
+        return SerialStatus::OpenFailed;
+    }
+
+    LOG_DEBUG(LOG_TAG, "Baudrate changed from %u to %u", _config.baudrate, baudrate);
+    _config.baudrate = baudrate;
+    return SerialStatus::Ok;
+}
+
+bool LinuxSerial::SupportsBaudRate(unsigned int baudrate) const
+{
+#ifdef TCGETS2
+    return baudrate != 0;
+#else
+    return to_speed_t(baudrate) != B0;
+#endif
+}
+
 // receive all bytes and copy to the buffer or return error status
 SerialStatus LinuxSerial::RecvBytes(char* buffer, size_t n_bytes)
 {
@@ -147,36 +368,103 @@ SerialStatus LinuxSerial::RecvBytes(char* buffer, size_t n_bytes)
 
     // set timeout to depend on number of bytes needed
     Timer timer {std::chrono::milliseconds {200 + 4 * n_bytes}};
-    unsigned int total_bytes_read = 0;
-    while (!timer.ReachedTimeout())
+    size_t total_bytes_read = ReadRecvBuffer(buffer, n_bytes);
+    while (total_bytes_read < n_bytes)
     {
-        unsigned char* buf_ptr = (unsigned char*)buffer + total_bytes_read;
-        auto last_read_result = read(_handle, (void*)buf_ptr, n_bytes - total_bytes_read);
-        if (last_read_result > 0)
+        auto status = FillRecvBuffer(timer.TimeLeft());
+        if (status == SerialStatus::RecvTimeout)
         {
-            DEBUG_SERIAL(LOG_TAG, "[rcv]", (const char*)buf_ptr, last_read_result);
-            total_bytes_read += static_cast<unsigned int>(last_read_result);
-
-            if (total_bytes_read >= n_bytes)
-            {
-                assert(n_bytes == total_bytes_read);
-                return SerialStatus::Ok;
-            }
+            break;
         }
-        else if (last_read_result < 0)
+        if (status != SerialStatus::Ok)
         {
-            LOG_ERROR(LOG_TAG, "[rcv] rv=%ld errno=%d error: '%s'", last_read_result, errno, strerror(errno));
-            return SerialStatus::RecvFailed;
+            return status;
         }
+        total_bytes_read += ReadRecvBuffer(buffer + total_bytes_read, n_bytes - total_bytes_read);
+    }
+
+    if (total_bytes_read == n_bytes)
+    {
+        return SerialStatus::Ok;
     }
 
     // reached here on timout
     if (n_bytes != 1)
     {
-        LOG_DEBUG(LOG_TAG, "Timeout recv %zu bytes. Got only %u bytes", n_bytes, total_bytes_read);
+        LOG_DEBUG(LOG_TAG, "Timeout recv %zu bytes. Got only %zu bytes", n_bytes, total_bytes_read);
     }
 
     return SerialStatus::RecvTimeout;
 }
+
+SerialStatus LinuxSerial::FillRecvBuffer(timeout_t timeout)
+{
+    // called only when the buffer is empty, so the bytes are read to its start.
+    assert(_recv_begin == _recv_end);
+    _recv_begin = _recv_end = 0;
+
+    Timer timer {timeout};
+    while (true)
+    {
+        // one clock read per iteration: a negative poll() timeout would block forever.
+        const int64_t time_left = static_cast<int64_t>(timer.TimeLeft().count());
+        if (time_left <= 0)
+        {
+            break;
+        }
+
+        struct pollfd poll_fd;
+        poll_fd.fd = _handle;
+        poll_fd.events = POLLIN;
+        poll_fd.revents = 0;
+        auto poll_rv = ::poll(&poll_fd, 1, static_cast<int>(std::min<int64_t>(std::max<int64_t>(0, time_left), INT_MAX)));
+        if (poll_rv < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR(LOG_TAG, "[rcv] poll failed. errno=%d error: '%s'", errno, strerror(errno));
+            return SerialStatus::RecvFailed;
+        }
+        if (poll_rv == 0)
+        {
+            break;
+        }
+        if (poll_fd.revents & (POLLERR | POLLNVAL))
+        {
+            LOG_ERROR(LOG_TAG, "[rcv] poll revents=0x%x", poll_fd.revents);
+            return SerialStatus::RecvFailed;
+        }
+
+        auto read_rv = ::read(_handle, _recv_buffer.data(), _recv_buffer.size());
+        if (read_rv > 0)
+        {
+            DEBUG_SERIAL(LOG_TAG, "[rcv]", _recv_buffer.data(), read_rv);
+            _recv_end = static_cast<size_t>(read_rv);
+            return SerialStatus::Ok;
+        }
+        if (read_rv == 0 && (poll_fd.revents & POLLHUP))
+        {
+            LOG_ERROR(LOG_TAG, "[rcv] serial port hung up");
+            return SerialStatus::RecvFailed;
+        }
+        if (read_rv < 0 && errno != EINTR && errno != EAGAIN)
+        {
+            LOG_ERROR(LOG_TAG, "[rcv] rv=%ld errno=%d error: '%s'", read_rv, errno, strerror(errno));
+            return SerialStatus::RecvFailed;
+        }
+    }
+
+    return SerialStatus::RecvTimeout;
+}
+
+size_t LinuxSerial::ReadRecvBuffer(char* buffer, size_t n_bytes)
+{
+    size_t n_copy = std::min(n_bytes, _recv_end - _recv_begin);
+    ::memcpy(buffer, _recv_buffer.data() + _recv_begin, n_copy);
+    _recv_begin += n_copy;
+    return n_copy;
+}
 } // namespace PacketManager
 } // namespace RealSenseID
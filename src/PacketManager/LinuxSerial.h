@@ -4,11 +4,16 @@
 #pragma once
 
 #include "SerialConnection.h"
+#include <vector>
 
 namespace RealSenseID
 {
 namespace PacketManager
 {
+// Received bytes are buffered in user space: RecvBytes() is served from the receive buffer, which is refilled by
+// read()s of all the available bytes (up to the buffer size) after poll() reports the port readable. So byte by byte
+// receives (e.g. waiting for the sync bytes) cost a syscall per read chunk instead of per byte, and timeouts are
+// waited in poll() instead of polling read().
 class LinuxSerial : public SerialConnection
 {
 public:
@@ -23,12 +28,37 @@ public:
     // send all bytes and return status
     SerialStatus SendBytes(const char* buffer, size_t n_bytes) final;
 
+    // send all bytes of the buffers with writev()
+    SerialStatus SendBytesV(const SendBuffer* buffers, size_t n_buffers) final;
+
+    // tcdrain()
+    SerialStatus Drain() final;
+
+    // drain and switch the port to the baud rate. any rate the driver supports (termios2 / BOTHER for rates without
+    // a Bxxx constant).
+    SerialStatus SetBaudRate(unsigned int baudrate) final;
+
+    // rates with a Bxxx constant, or any rate where termios2 is available.
+    bool SupportsBaudRate(unsigned int baudrate) const final;
+
     // receive all bytes and copy to the buffer
     SerialStatus RecvBytes(char* buffer, size_t n_bytes) final;
 
 private:
+    // wait (up to timeout) for the port to be readable and read all the available bytes to the receive buffer.
+    // returns Ok if any bytes were read.
+    SerialStatus FillRecvBuffer(timeout_t timeout);
+
+    // copy up to n_bytes buffered bytes to buffer. returns the number of bytes copied.
+    size_t ReadRecvBuffer(char* buffer, size_t n_bytes);
+
     SerialConfig _config;
     int _handle = -1;
+
+    static const size_t _recv_buffer_size = 65536;
+    std::vector<char> _recv_buffer;
+    size_t _recv_begin = 0; // first buffered byte
+    size_t _recv_end = 0;   // end of the buffered bytes
 };
 } // namespace PacketManager
 } // namespace RealSenseID
@@ -137,6 +137,14 @@ SerialStatus NonSecureSession::RecvDataPacket(DataPacket& packet)
     return IsDataPacket(packet) ? SerialStatus::Ok : SerialStatus::RecvUnexpectedPacket;
 }
 
+SerialStatus NonSecureSession::SendPacketsWindowed(size_t n_packets, size_t window, const MakePacketCallback& make_packet,
+                                                   const ReplyCallback& on_reply)
+{
+    return SendDataPacketsWindowed(
+        n_packets, window, make_packet, on_reply, [this](SerialPacket& packet) { return SendPacketImpl(packet); },
+        [this](SerialPacket& packet) { return RecvPacketImpl(packet, PacketSender::DefaultRecvTimeout); });
+}
+
 SerialStatus NonSecureSession::SendPacketImpl(SerialPacket& packet)
 {
     // increment and set sequence number in the packet
@@ -7,6 +7,7 @@
 #include "SerialPacket.h"
 #include "CommonTypes.h"
 #include "Timer.h"
+#include "SendWindow.h"
 #include <atomic>
 #include <functional>
 
@@ -66,6 +67,13 @@ public:
     // return Status::Ok on success, or error status otherwise.
     SerialStatus RecvDataPacket(DataPacket& packet);
 
+    // Send n_packets data packets (make_packet(i) returns the i'th) keeping up to window of them in flight, and pass
+    // the reply of each packet to on_reply(i, reply), in order (see SendWindowed()).
+    // window 1 waits for the reply of each packet before sending the next one.
+    // return Status::Ok on success, or error status otherwise.
+    SerialStatus SendPacketsWindowed(size_t n_packets, size_t window, const MakePacketCallback& make_packet,
+                                     const ReplyCallback& on_reply);
+
     // async cancel. set the _cancel_required flag and send cancel before next recv
     void Cancel();
 
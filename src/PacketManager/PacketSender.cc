@@ -43,26 +43,14 @@ SerialStatus PacketSender::Send(SerialPacket& packet)
 #ifdef RSID_DEBUG_PACKETS
     LOG_DEBUG(LOG_TAG, "Sending packet '%c'", packet.header.id);
 #endif
-    // send the headers + payload
+    // send the headers + payload, hmac and crc in one write
     auto* packet_ptr = reinterpret_cast<const char*>(&packet);
     auto packet_size = sizeof(packet.header) + packet.header.payload_size;
-    auto status = _serial->SendBytes(packet_ptr, packet_size);
-    if (status != SerialStatus::Ok)
-    {
-        return status;
-    }
-
-    // send the hmac
-    status = _serial->SendBytes(packet.hmac, sizeof(packet.hmac));
-    if (status != SerialStatus::Ok)
-    {
-        return status;
-    }
-
-    // send crc
     auto crc = CalcCrc(packet);
-    status = _serial->SendBytes(reinterpret_cast<const char*>(&crc), sizeof(crc));
-    return status;
+    const SendBuffer buffers[] = {{packet_ptr, packet_size},
+                                  {packet.hmac, sizeof(packet.hmac)},
+                                  {reinterpret_cast<const char*>(&crc), sizeof(crc)}};
+    return _serial->SendBytesV(buffers, sizeof(buffers) / sizeof(buffers[0]));
 }
 
 SerialStatus PacketSender::SendBinary(SerialPacket& packet)
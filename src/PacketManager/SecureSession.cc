@@ -203,6 +203,14 @@ SerialStatus SecureSession::RecvDataPacket(DataPacket& packet)
     return IsDataPacket(packet) ? SerialStatus::Ok : SerialStatus::RecvUnexpectedPacket;
 }
 
+SerialStatus SecureSession::SendPacketsWindowed(size_t n_packets, size_t window, const MakePacketCallback& make_packet,
+                                                const ReplyCallback& on_reply)
+{
+    return SendDataPacketsWindowed(
+        n_packets, window, make_packet, on_reply, [this](SerialPacket& packet) { return SendPacketImpl(packet); },
+        [this](SerialPacket& packet) { return RecvPacketImpl(packet, PacketSender::DefaultRecvTimeout); });
+}
+
 RealSenseID::PacketManager::SerialStatus SecureSession::PairImpl(SerialConnection* serial_conn, const char* ecdsaHostPubKey,
                                                                  const char* ecdsaHostPubKeySig, char* ecdsaDevicePubKey)
 {
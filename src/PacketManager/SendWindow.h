@@ -0,0 +1,93 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include "CommonTypes.h"
+#include "SerialPacket.h"
+#include <algorithm>
+#include <functional>
+#include <stddef.h>
+
+namespace RealSenseID
+{
+namespace PacketManager
+{
+// max packets in flight of a windowed send. the sessions accept a received sequence number only up to
+// MAX_SEQ_NUMBER_DELTA (20) ahead of the last one, so the window is kept within it.
+static constexpr size_t MaxSendWindow = 20;
+
+// returns the index'th packet of a windowed send.
+using MakePacketCallback = std::function<DataPacket(size_t index)>;
+
+// handles the reply of the index'th packet. returns false to stop sending (the replies of the packets already in
+// flight are still received, to keep the session in sync).
+using ReplyCallback = std::function<bool(size_t index, const SerialPacket& reply)>;
+
+// Sliding window send loop of the sessions' SendPacketsWindowed().
+// send_packet(i) sends the i'th packet as long as less than window replies are pending, so the link isn't idle for
+// a round trip per packet. The device handles the packets and replies in the order of their sequence numbers, so
+// recv_reply(i, stop) receives the reply of the i'th packet, and sets stop to send no more packets.
+// Returns the first receive error (the session is out of sync after it), or else the send error if a send failed
+// (after the replies of the packets sent before it were received).
+template <typename SendFn, typename RecvFn>
+SerialStatus SendWindowed(size_t n_packets, size_t window, SendFn&& send_packet, RecvFn&& recv_reply)
+{
+    window = std::max<size_t>(1, std::min(window, MaxSendWindow));
+
+    size_t n_sent = 0;
+    size_t n_replies = 0;
+    bool stop = false;
+    SerialStatus send_status = SerialStatus::Ok;
+    while (true)
+    {
+        while (!stop && send_status == SerialStatus::Ok && n_sent < n_packets && n_sent - n_replies < window)
+        {
+            send_status = send_packet(n_sent);
+            if (send_status == SerialStatus::Ok)
+            {
+                n_sent++;
+            }
+        }
+
+        if (n_replies == n_sent)
+        {
+            break;
+        }
+
+        auto recv_status = recv_reply(n_replies, stop);
+        if (recv_status != SerialStatus::Ok)
+        {
+            return recv_status;
+        }
+        n_replies++;
+    }
+
+    return send_status;
+}
+
+// SendWindowed() over the packets of make_packet, passing each reply to on_reply. the session's send_packet(packet)
+// sends a packet (and sets its sequence number) and recv_packet(packet) receives the next one.
+template <typename SendPacketFn, typename RecvPacketFn>
+SerialStatus SendDataPacketsWindowed(size_t n_packets, size_t window, const MakePacketCallback& make_packet, const ReplyCallback& on_reply,
+                                     SendPacketFn&& send_packet, RecvPacketFn&& recv_packet)
+{
+    auto send_index = [&](size_t index) {
+        DataPacket packet = make_packet(index);
+        return send_packet(packet);
+    };
+
+    SerialPacket reply;
+    auto recv_reply = [&](size_t index, bool& stop) {
+        auto status = recv_packet(reply);
+        if (status == SerialStatus::Ok && !on_reply(index, reply))
+        {
+            stop = true;
+        }
+        return status;
+    };
+
+    return SendWindowed(n_packets, window, send_index, recv_reply);
+}
+} // namespace PacketManager
+} // namespace RealSenseID
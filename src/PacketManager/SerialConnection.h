@@ -4,11 +4,19 @@
 #pragma once
 
 #include "CommonTypes.h"
+#include <stddef.h>
 
 namespace RealSenseID
 {
 namespace PacketManager
 {
+// one buffer of a gather send (see SerialConnection::SendBytesV()).
+struct SendBuffer
+{
+    const char* data;
+    size_t size;
+};
+
 // Represents an open serial connection (raii over the os serial connection).
 // Should open new connection on construction and close it on destruction.
 // Should throw if connection could not be established on construction.
@@ -17,9 +25,48 @@ class SerialConnection
 public:
     virtual ~SerialConnection() = default;
 
-    // send all bytes and return status
+    // send all bytes and return status.
+    // bytes may still be queued for transmission on return (see Drain()).
     virtual SerialStatus SendBytes(const char* buffer, size_t n_bytes) = 0;
 
+    // send all bytes of the buffers, in order (e.g. a packet's header + payload, hmac and crc) and return status.
+    // connections that support it send all of them in one write.
+    virtual SerialStatus SendBytesV(const SendBuffer* buffers, size_t n_buffers)
+    {
+        for (size_t i = 0; i < n_buffers; i++)
+        {
+            auto status = SendBytes(buffers[i].data, buffers[i].size);
+            if (status != SerialStatus::Ok)
+            {
+                return status;
+            }
+        }
+        return SerialStatus::Ok;
+    }
+
+    // wait until all the sent bytes were transmitted, where the protocol needs it (e.g. before pausing to let the
+    // device process them).
+    virtual SerialStatus Drain()
+    {
+        return SerialStatus::Ok;
+    }
+
+    // switch the connection to another baud rate after the device agreed to it (e.g. after the fw updater dlspd
+    // command). sent bytes are transmitted at the current rate first.
+    // connections that can't change their rate return OpenFailed.
+    virtual SerialStatus SetBaudRate(unsigned int baudrate)
+    {
+        (void)baudrate;
+        return SerialStatus::OpenFailed;
+    }
+
+    // whether SetBaudRate(baudrate) can succeed, checked before asking the device to switch its rate.
+    virtual bool SupportsBaudRate(unsigned int baudrate) const
+    {
+        (void)baudrate;
+        return false;
+    }
+
     // receive all bytes and copy to the buffer
     virtual SerialStatus RecvBytes(char* buffer, size_t n_bytes) = 0;
 };
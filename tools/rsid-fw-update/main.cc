@@ -124,6 +124,7 @@ struct CommandLineArgs
     bool auto_approve = false;                                              // automatically approve all (use default params)
     std::string fw_file;                                                    // path to firmware update binary
     std::string serial_port;                                                // serial port
+    long baud_rate = 115200;                                                // serial baud rate of the modules download
     RealSenseID::DeviceType device_type = RealSenseID::DeviceType::Unknown; // device type is auto-detected by default. user can override
 };
 
@@ -140,7 +141,7 @@ static void PrintUsage(const char* program_name)
 {
     std::cout << "usage: " << program_name
               << " --file <bin path> [--port <COM#>] [--force-version] [--force-full] [--device-type <<F45x/F46x>>] [--interactive] "
-                 "[--auto-approve] [--help]\n";
+                 "[--auto-approve] [--baud-rate <rate>] [--help]\n";
 }
 
 static CommandLineArgs ParseCommandLineArgs(int argc, char* argv[])
@@ -177,6 +178,18 @@ static CommandLineArgs ParseCommandLineArgs(int argc, char* argv[])
                 }
             }
         }
+        else if (strcmp(argv[i], "--baud-rate") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                args.baud_rate = atol(argv[++i]);
+                if (args.baud_rate <= 0)
+                {
+                    std::cerr << "Invalid baud rate\n";
+                    exit(EXIT_FAILURE);
+                }
+            }
+        }
         else if (strcmp(argv[i], "--force-full") == 0)
         {
             args.force_full = true;
@@ -362,6 +375,7 @@ int main(int argc, char* argv[])
         RealSenseID::FwUpdater::Settings settings;
         settings.serial_config = RealSenseID::SerialConfig({selected_device.device_info->serialPort});
         settings.force_full = args.force_full;
+        settings.baud_rate = args.baud_rate;
 
         // check sku compatibility
         int expectedSkuVer = 0, deviceSkuVer = 0;
@@ -0,0 +1,1342 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2020-2021 Intel Corporation. All Rights Reserved.
+
+// Matcher micro-benchmarks on synthetic faceprints (fixed seed, so runs are comparable).
+//
+// Each benchmark runs its operation until --min-time has passed and prints ns/op, vectors/s (feature vectors scored
+// per second) and GB/s (feature vector bytes scored per second - the bytes the scan must stream, not the total
+// bytes touched). --verify checks that all the kernels give bit-identical results to a frozen copy of the original
+// MatchTwoVectors() loop, that the simd kernels give bit-identical results to the scalar ones, that the ncc grade
+// reciprocals give the same results as the divisions, that the threshold sweep counts the matcher's decisions, and
+// that the crc kernels give the same crcs as the byte-wise loops.
+
+#include "Matcher.h"
+#include "MatcherKernels.h"
+#include "FaceprintsGallery.h"
+#include "FaceprintsIvfIndex.h"
+#include "IndexedFaceprintsGallery.h"
+#include "MatchResultCache.h"
+#include "ThresholdSweep.h"
+#include "FwUpdate/Common/Crc32.h"
+#include "PacketManager/Crc16.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace RealSenseID;
+
+static const uint32_t BENCH_SEED = 20211;
+static const uint32_t VEC_LENGTH = RSID_NUM_OF_RECOGNITION_FEATURES;
+static const size_t NUM_PROBES = 64;
+
+struct BenchOptions
+{
+    bool verify = false;
+    std::string filter;
+    size_t max_users = 1000000;
+    unsigned int threads = 0;
+    double min_time = 0.5;
+};
+
+// the results of benchmarked calls are accumulated here, so the calls are not optimized away.
+static volatile int64_t s_sink = 0;
+
+/* Synthetic faceprints */
+
+static feature_t ClampFeature(double value)
+{
+    long v = std::lround(value);
+    return static_cast<feature_t>(std::max<long>(RSID_MIN_FEATURE_VALUE, std::min<long>(RSID_MAX_FEATURE_VALUE, v)));
+}
+
+static void RandomVector(std::mt19937& rng, feature_t* vec, double sigma = 300.0)
+{
+    std::normal_distribution<double> dist(0.0, sigma);
+    for (uint32_t i = 0; i < VEC_LENGTH; ++i)
+    {
+        vec[i] = ClampFeature(dist(rng));
+    }
+}
+
+static void NoisyVector(std::mt19937& rng, const feature_t* base, feature_t* vec, double sigma)
+{
+    std::normal_distribution<double> dist(0.0, sigma);
+    for (uint32_t i = 0; i < VEC_LENGTH; ++i)
+    {
+        vec[i] = ClampFeature(base[i] + dist(rng));
+    }
+}
+
+// user i is generated from its own seed, so galleries of different sizes (and layouts) hold the same users.
+static UserFaceprints_t MakeUser(size_t index)
+{
+    std::mt19937 rng(BENCH_SEED + static_cast<uint32_t>(index) * 7919u);
+    UserFaceprints_t user;
+    snprintf(user.user_id, sizeof(user.user_id), "user_%zu", index);
+
+    Faceprints& fp = user.faceprints;
+    RandomVector(rng, fp.data.enrollmentDescriptor);
+    NoisyVector(rng, fp.data.enrollmentDescriptor, fp.data.adaptiveDescriptorWithoutMask, 100.0);
+    fp.data.enrollmentDescriptor[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS] = FaVectorFlagsEnum::VecFlagValidWithoutMask;
+    fp.data.adaptiveDescriptorWithoutMask[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS] = FaVectorFlagsEnum::VecFlagValidWithoutMask;
+
+    // a quarter of the users also have an adaptive with-mask vector.
+    if (index % 4 == 0)
+    {
+        NoisyVector(rng, fp.data.adaptiveDescriptorWithoutMask, fp.data.adaptiveDescriptorWithMask, 150.0);
+        fp.data.adaptiveDescriptorWithMask[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS] = FaVectorFlagsEnum::VecFlagValidWithMask;
+    }
+
+    return user;
+}
+
+static MatchElement MakeProbe(std::mt19937& rng, const feature_t* base, double sigma, bool with_mask)
+{
+    MatchElement probe;
+    NoisyVector(rng, base, probe.data.featuresVector, sigma);
+    probe.data.featuresVector[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS] =
+        with_mask ? FaVectorFlagsEnum::VecFlagValidWithMask : FaVectorFlagsEnum::VecFlagValidWithoutMask;
+    return probe;
+}
+
+// probes near random users of a gallery of the given size.
+static std::vector<MatchElement> MakeProbes(size_t num_users)
+{
+    std::mt19937 rng(BENCH_SEED);
+    std::vector<MatchElement> probes;
+    for (size_t i = 0; i < NUM_PROBES; ++i)
+    {
+        UserFaceprints_t user = MakeUser(rng() % num_users);
+        probes.push_back(MakeProbe(rng, user.faceprints.data.adaptiveDescriptorWithoutMask, 120.0, i % 4 == 0));
+    }
+    return probes;
+}
+
+static Thresholds HighConfidenceThresholds()
+{
+    Thresholds thresholds;
+    thresholds.identicalThreshold_gNMgNM = RSID_IDENTICAL_THRESHOLD_GNM_GNM_HIGH_CONFIDENCE_LEVEL;
+    thresholds.identicalThreshold_gMgNM = RSID_IDENTICAL_THRESHOLD_GM_GNM_HIGH_CONFIDENCE_LEVEL;
+    thresholds.strongThreshold_pNMgNM = RSID_STRONG_THRESHOLD_PNM_GNM_HIGH_CONFIDENCE_LEVEL;
+    thresholds.strongThreshold_pMgM = RSID_STRONG_THRESHOLD_PM_GM_HIGH_CONFIDENCE_LEVEL;
+    thresholds.strongThreshold_pMgNM = RSID_STRONG_THRESHOLD_PM_GNM_HIGH_CONFIDENCE_LEVEL;
+    thresholds.strongThreshold_pNMgNM_rgbImgEnroll = RSID_STRONG_THRESHOLD_PNM_GNM_RGB_IMG_ENROLL_HIGH_CONFIDENCE_LEVEL;
+    thresholds.updateThreshold_pNMgNM = RSID_UPDATE_THRESHOLD_PNM_GNM_HIGH_CONFIDENCE_LEVEL;
+    thresholds.updateThreshold_pMgM = RSID_UPDATE_THRESHOLD_PM_GM_HIGH_CONFIDENCE_LEVEL;
+    thresholds.updateThreshold_pMgNM_First = RSID_UPDATE_THRESHOLD_PM_GNM_FIRST_HIGH_CONFIDENCE_LEVEL;
+    thresholds.confidenceLevel = ThresholdsConfidenceEnum::ThresholdsConfidenceLevel_High;
+    return thresholds;
+}
+
+/* Harness */
+
+class Bench
+{
+public:
+    explicit Bench(const BenchOptions& options) : _options(options)
+    {
+    }
+
+    bool Selected(const std::string& name) const
+    {
+        return _options.filter.empty() || name.find(_options.filter) != std::string::npos;
+    }
+
+    // run op() (one operation) repeatedly for at least min_time, doubling the batch of calls between clock reads.
+    void Run(const std::string& name, double vectors_per_op, double bytes_per_op, const std::function<void()>& op)
+    {
+        if (!Selected(name))
+        {
+            return;
+        }
+
+        op(); // warm up
+
+        using Clock = std::chrono::steady_clock;
+        uint64_t ops = 0;
+        uint64_t batch = 1;
+        double elapsed = 0;
+        auto start = Clock::now();
+        while (elapsed < _options.min_time)
+        {
+            for (uint64_t i = 0; i < batch; ++i)
+            {
+                op();
+            }
+            ops += batch;
+            batch *= 2;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        double ns_per_op = elapsed * 1e9 / static_cast<double>(ops);
+        printf("%-48s %14.1f ns/op %12.4g vectors/s %9.2f GB/s\n", name.c_str(), ns_per_op, vectors_per_op * 1e9 / ns_per_op,
+               bytes_per_op / ns_per_op);
+        fflush(stdout);
+    }
+
+    const BenchOptions& Options() const
+    {
+        return _options;
+    }
+
+private:
+    BenchOptions _options;
+};
+
+static std::string ThreadsSuffix(unsigned int threads)
+{
+    return "/threads=" + std::to_string(threads);
+}
+
+/* Benchmarks */
+
+static void BenchKernels(Bench& bench)
+{
+    std::mt19937 rng(BENCH_SEED);
+    std::vector<feature_t> v1(VEC_LENGTH), v2(VEC_LENGTH), work(VEC_LENGTH);
+    RandomVector(rng, v1.data());
+    RandomVector(rng, v2.data());
+    std::vector<int8_t> q1(VEC_LENGTH), q2(VEC_LENGTH);
+    MatcherKernels::QuantizeToInt8(v1.data(), q1.data(), VEC_LENGTH);
+    MatcherKernels::QuantizeToInt8(v2.data(), q2.data(), VEC_LENGTH);
+
+    const double pair_bytes = 2.0 * VEC_LENGTH * sizeof(feature_t);
+
+    bench.Run("MatchTwoVectors", 1, pair_bytes, [&] {
+        match_calc_t score = 0;
+        Matcher::MatchTwoVectors(v1.data(), v2.data(), &score);
+        s_sink += score;
+    });
+
+    // generic kernels, then the ones specialized for VEC_LENGTH (see MatcherKernels::Active()).
+    for (int table = 0; table < 2 * static_cast<int>(MatcherKernels::Isa::NumIsas); ++table)
+    {
+        const uint32_t fixed_length = (table % 2 == 0) ? 0 : VEC_LENGTH;
+        const MatcherKernels::KernelTable* kernels = MatcherKernels::ForIsa(static_cast<MatcherKernels::Isa>(table / 2), fixed_length);
+        if (kernels == nullptr)
+        {
+            continue;
+        }
+
+        std::string suffix = std::string("/") + kernels->name + (kernels->fixed_length != 0 ? "/fixed" : "");
+        bench.Run("kernel/ncc_sums" + suffix, 1, pair_bytes, [&] {
+            MatcherKernels::NccSums sums;
+            kernels->ncc_sums(v1.data(), v2.data(), VEC_LENGTH, sums);
+            s_sink += sums.corr;
+        });
+        bench.Run("kernel/dot" + suffix, 1, pair_bytes, [&] { s_sink += kernels->dot(v1.data(), v2.data(), VEC_LENGTH); });
+        bench.Run("kernel/dot_i8" + suffix, 1, 2.0 * VEC_LENGTH, [&] { s_sink += kernels->dot_i8(q1.data(), q2.data(), VEC_LENGTH); });
+
+        work = v1;
+        bench.Run("kernel/blend_ncc_sums" + suffix, 1, pair_bytes, [&] {
+            MatcherKernels::NccSums sums;
+            s_sink += kernels->blend_ncc_sums(work.data(), v2.data(), VEC_LENGTH, sums);
+        });
+    }
+}
+
+static void BenchValidation(Bench& bench)
+{
+    UserFaceprints_t user = MakeUser(0);
+    std::mt19937 rng(BENCH_SEED);
+    MatchElement probe = MakeProbe(rng, user.faceprints.data.adaptiveDescriptorWithoutMask, 120.0, false);
+
+    bench.Run("validate/faceprints", 2, 2.0 * VEC_LENGTH * sizeof(feature_t),
+              [&] { s_sink += Matcher::ValidateFaceprints(user.faceprints); });
+    bench.Run("validate/probe", 1, VEC_LENGTH * sizeof(feature_t), [&] { s_sink += Matcher::ValidateFaceprints(probe); });
+}
+
+// the should_update path: a probe close to the user's adaptive vector, which drifted from the enrollment vector, so
+// the update blends the probe and then pulls the adaptive vector back towards the anchor (LimitAdaptiveVector()).
+static void BenchUpdate(Bench& bench)
+{
+    const Thresholds thresholds = HighConfidenceThresholds();
+    std::mt19937 rng(BENCH_SEED);
+
+    UserFaceprints_t user = MakeUser(1);
+    NoisyVector(rng, user.faceprints.data.enrollmentDescriptor, user.faceprints.data.adaptiveDescriptorWithoutMask, 250.0);
+    std::vector<UserFaceprints_t> users(1, user);
+
+    struct UpdateCase
+    {
+        const char* name;
+        bool with_mask;
+    };
+    const UpdateCase cases[] = {{"update/no-mask", false}, {"update/mask-first", true}};
+
+    for (const UpdateCase& update_case : cases)
+    {
+        MatchElement probe = MakeProbe(rng, user.faceprints.data.adaptiveDescriptorWithoutMask, 40.0, update_case.with_mask);
+
+        Faceprints updated;
+        ExtendedMatchResult result = Matcher::MatchFaceprintsToArray(probe, users, updated, thresholds);
+        if (!result.should_update)
+        {
+            printf("%-48s skipped: synthetic probe did not trigger an update (score %d)\n", update_case.name, result.maxScore);
+            continue;
+        }
+
+        bench.Run(update_case.name, 1, VEC_LENGTH * sizeof(feature_t), [&] {
+            s_sink += Matcher::MatchFaceprintsToArray(probe, users, updated, thresholds).should_update;
+        });
+    }
+}
+
+static void BenchArray(Bench& bench, size_t num_users)
+{
+    const std::string prefix = "MatchFaceprintsToArray/" + std::to_string(num_users);
+    const unsigned int threads = bench.Options().threads;
+    if (!bench.Selected(prefix))
+    {
+        return;
+    }
+
+    const Thresholds thresholds = HighConfidenceThresholds();
+    std::vector<UserFaceprints_t> users;
+    users.reserve(num_users);
+    for (size_t i = 0; i < num_users; ++i)
+    {
+        users.push_back(MakeUser(i));
+    }
+    const std::vector<MatchElement> probes = MakeProbes(num_users);
+
+    const double vectors = static_cast<double>(num_users);
+    const double bytes = vectors * VEC_LENGTH * sizeof(feature_t);
+    size_t next = 0;
+    Faceprints updated;
+
+    bench.Run(prefix, vectors, bytes, [&] {
+        s_sink += Matcher::MatchFaceprintsToArray(probes[next++ % NUM_PROBES], users, updated, thresholds).userId;
+    });
+
+    if (threads > 1)
+    {
+        bench.Run(prefix + ThreadsSuffix(threads), vectors, bytes, [&] {
+            s_sink += Matcher::MatchFaceprintsToArray(probes[next++ % NUM_PROBES], users, updated, thresholds, threads).userId;
+        });
+    }
+}
+
+// fraction of the probes for which the approximate match found the same user as the exact gallery scan.
+static double Recall(const std::vector<MatchElement>& probes, const std::vector<int>& exact_ids,
+                     const std::function<ExtendedMatchResult(const MatchElement&)>& match)
+{
+    size_t same = 0;
+    for (size_t i = 0; i < probes.size(); ++i)
+    {
+        same += (match(probes[i]).userId == exact_ids[i]) ? 1 : 0;
+    }
+    return static_cast<double>(same) / static_cast<double>(probes.size());
+}
+
+static void BenchGallery(Bench& bench, size_t num_users)
+{
+    const std::string prefix = "MatchFaceprintsToGallery/" + std::to_string(num_users);
+    const std::string coarse_prefix = "CoarseToFine/" + std::to_string(num_users);
+    const std::string ivf_prefix = "Ivf/" + std::to_string(num_users);
+    const unsigned int threads = bench.Options().threads;
+    const bool approximate = (num_users >= 1000);
+    if (!bench.Selected(prefix) && !(approximate && (bench.Selected(coarse_prefix) || bench.Selected(ivf_prefix))))
+    {
+        return;
+    }
+
+    const Thresholds thresholds = HighConfidenceThresholds();
+    FaceprintsGallery gallery;
+    gallery.Reserve(num_users);
+    for (size_t i = 0; i < num_users; ++i)
+    {
+        gallery.Add(MakeUser(i));
+    }
+    const std::vector<MatchElement> probes = MakeProbes(num_users);
+
+    const double vectors = static_cast<double>(num_users);
+    const double bytes = vectors * VEC_LENGTH * sizeof(feature_t);
+    size_t next = 0;
+    Faceprints updated;
+
+    bench.Run(prefix, vectors, bytes, [&] {
+        s_sink += Matcher::MatchFaceprintsToGallery(probes[next++ % NUM_PROBES], gallery, updated, thresholds).userId;
+    });
+
+    if (threads > 1)
+    {
+        bench.Run(prefix + ThreadsSuffix(threads), vectors, bytes, [&] {
+            s_sink += Matcher::MatchFaceprintsToGallery(probes[next++ % NUM_PROBES], gallery, updated, thresholds, threads).userId;
+        });
+    }
+
+    // an authentication loop: consecutive probes of the same person (each a fresh noisy extraction).
+    {
+        std::mt19937 rng(BENCH_SEED);
+        const UserFaceprints_t user = MakeUser(num_users / 2);
+        std::vector<MatchElement> stream;
+        for (size_t i = 0; i < NUM_PROBES; ++i)
+        {
+            stream.push_back(MakeProbe(rng, user.faceprints.data.adaptiveDescriptorWithoutMask, 60.0, false));
+        }
+
+        MatchResultCache cache;
+        bench.Run(prefix + "/cached-stream", 1, VEC_LENGTH * sizeof(feature_t), [&] {
+            s_sink += Matcher::MatchFaceprintsToGallery(stream[next++ % NUM_PROBES], gallery, updated, thresholds, cache).userId;
+        });
+    }
+
+    if (!approximate)
+    {
+        return;
+    }
+
+    std::vector<int> exact_ids;
+    for (const MatchElement& probe : probes)
+    {
+        exact_ids.push_back(Matcher::MatchFaceprintsToGallery(probe, gallery, updated, thresholds).userId);
+    }
+
+    if (bench.Selected(coarse_prefix))
+    {
+        gallery.SetQuantizedTier(true);
+        for (size_t shortlist : {4, 16, 64})
+        {
+            const std::string name = coarse_prefix + "/shortlist=" + std::to_string(shortlist);
+            bench.Run(name, vectors, vectors * VEC_LENGTH, [&] {
+                s_sink += Matcher::MatchFaceprintsToGalleryCoarseToFine(probes[next++ % NUM_PROBES], gallery, updated, thresholds, shortlist)
+                              .userId;
+            });
+            double recall = Recall(probes, exact_ids, [&](const MatchElement& probe) {
+                return Matcher::MatchFaceprintsToGalleryCoarseToFine(probe, gallery, updated, thresholds, shortlist);
+            });
+            printf("%-48s recall %.3f\n", name.c_str(), recall);
+        }
+        gallery.SetQuantizedTier(false);
+    }
+
+    if (bench.Selected(ivf_prefix))
+    {
+        const size_t num_lists = std::max<size_t>(1, static_cast<size_t>(std::sqrt(static_cast<double>(num_users))));
+        FaceprintsIvfIndex index(num_lists);
+        index.Train(gallery);
+
+        for (size_t nprobe : {1, 4, 16})
+        {
+            // on average nprobe lists of num_users / num_lists users are scored.
+            const double scored = std::min(vectors, vectors * static_cast<double>(nprobe) / static_cast<double>(num_lists));
+            const std::string name = ivf_prefix + "/lists=" + std::to_string(num_lists) + "/nprobe=" + std::to_string(nprobe);
+            bench.Run(name, scored, scored * VEC_LENGTH * sizeof(feature_t), [&] {
+                s_sink += Matcher::MatchFaceprintsToIndex(probes[next++ % NUM_PROBES], gallery, index, updated, thresholds, nprobe).userId;
+            });
+            double recall = Recall(probes, exact_ids, [&](const MatchElement& probe) {
+                return Matcher::MatchFaceprintsToIndex(probe, gallery, index, updated, thresholds, nprobe);
+            });
+            printf("%-48s recall %.3f\n", name.c_str(), recall);
+        }
+    }
+}
+
+// incremental maintenance by user id (IndexedFaceprintsGallery), vs. finding the user by a strcmp scan of an array.
+static void BenchMaintenance(Bench& bench, size_t num_users)
+{
+    const std::string prefix = "Maintenance/" + std::to_string(num_users);
+    if (!bench.Selected(prefix))
+    {
+        return;
+    }
+
+    IndexedFaceprintsGallery gallery;
+    gallery.Reserve(num_users + 1);
+    std::vector<UserFaceprints_t> users;
+    users.reserve(num_users);
+    for (size_t i = 0; i < num_users; ++i)
+    {
+        users.push_back(MakeUser(i));
+        gallery.Upsert(users.back());
+    }
+
+    std::mt19937 rng(BENCH_SEED);
+    const double row_bytes = VEC_LENGTH * sizeof(feature_t);
+
+    bench.Run(prefix + "/array-find", 0, 0, [&] {
+        const char* user_id = users[rng() % num_users].user_id;
+        for (size_t i = 0; i < num_users; ++i)
+        {
+            if (::strcmp(users[i].user_id, user_id) == 0)
+            {
+                s_sink += static_cast<int64_t>(i);
+                break;
+            }
+        }
+    });
+
+    bench.Run(prefix + "/find", 0, 0, [&] { s_sink += gallery.Find(users[rng() % num_users].user_id).slot; });
+
+    bench.Run(prefix + "/upsert-existing", 1, row_bytes, [&] {
+        const UserFaceprints_t& user = users[rng() % num_users];
+        s_sink += gallery.Upsert(user).slot;
+    });
+
+    // the removed user is inserted back, so the gallery size is unchanged.
+    bench.Run(prefix + "/remove+insert", 2, 2 * row_bytes, [&] {
+        const UserFaceprints_t& user = users[rng() % num_users];
+        gallery.Remove(user.user_id);
+        s_sink += gallery.Upsert(user).slot;
+    });
+}
+
+// all pairs near duplicates scan of a gallery where every 100th user is a noisy copy of the previous one (same person
+// under another id), exact and coarse to fine. vectors/s counts scored pairs.
+static void BenchDuplicates(Bench& bench, size_t num_users)
+{
+    const std::string prefix = "FindNearDuplicates/" + std::to_string(num_users);
+    if (!bench.Selected(prefix))
+    {
+        return;
+    }
+
+    FaceprintsGallery gallery;
+    gallery.Reserve(num_users);
+    std::mt19937 rng(BENCH_SEED);
+    for (size_t i = 0; i < num_users; ++i)
+    {
+        UserFaceprints_t user = MakeUser(i);
+        if (i % 100 == 1)
+        {
+            NoisyVector(rng, gallery.GetFaceprints(i - 1).data.adaptiveDescriptorWithoutMask,
+                        user.faceprints.data.adaptiveDescriptorWithoutMask, 60.0);
+        }
+        gallery.Add(user);
+    }
+    gallery.SetQuantizedTier(true);
+
+    const match_calc_t threshold = HighConfidenceThresholds().identicalThreshold_gNMgNM;
+    const unsigned int threads = bench.Options().threads;
+    const double pairs = 0.5 * static_cast<double>(num_users) * static_cast<double>(num_users - 1);
+    const double bytes = pairs * VEC_LENGTH * sizeof(feature_t);
+
+    std::vector<NearDuplicatePair> exact, coarse;
+    bench.Run(prefix + ThreadsSuffix(threads), pairs, bytes, [&] { exact = Matcher::FindNearDuplicates(gallery, threshold, threads); });
+    bench.Run(prefix + "/coarse-to-fine" + ThreadsSuffix(threads), pairs, bytes / 2,
+              [&] { coarse = Matcher::FindNearDuplicatesCoarseToFine(gallery, threshold, RSID_MATCHER_DUPLICATES_COARSE_MARGIN, threads); });
+
+    // coarse pairs are a subset of the exact ones (same order), with the same scores.
+    size_t found = 0;
+    for (const auto& pair : coarse)
+    {
+        found += std::any_of(exact.begin(), exact.end(), [&](const NearDuplicatePair& other) {
+                     return other.first == pair.first && other.second == pair.second && other.score == pair.score;
+                 })
+                     ? 1
+                     : 0;
+    }
+    printf("%-48s pairs %zu, coarse to fine recall %.3f\n", prefix.c_str(), exact.size(),
+           exact.empty() ? 1.0 : static_cast<double>(found) / static_cast<double>(exact.size()));
+}
+
+// threshold sweep of num_users labelled users vs. 4 probes of each (a quarter with mask): far / frr of the default
+// thresholds sets. vectors/s counts scored pairs.
+static void BenchSweep(Bench& bench, size_t num_users)
+{
+    const std::string prefix = "ThresholdSweep/" + std::to_string(num_users);
+    if (!bench.Selected(prefix))
+    {
+        return;
+    }
+
+    FaceprintsGallery gallery;
+    gallery.Reserve(num_users);
+    std::vector<int> gallery_labels(num_users);
+    std::vector<MatchElement> probes;
+    std::vector<int> probe_labels;
+    std::mt19937 rng(BENCH_SEED);
+    for (size_t i = 0; i < num_users; ++i)
+    {
+        UserFaceprints_t user = MakeUser(i);
+        gallery.Add(user);
+        gallery_labels[i] = static_cast<int>(i);
+        for (int p = 0; p < 4; ++p)
+        {
+            probes.push_back(MakeProbe(rng, user.faceprints.data.adaptiveDescriptorWithoutMask, 120.0 + 60.0 * p, p == 3));
+            probe_labels.push_back(static_cast<int>(i));
+        }
+    }
+
+    const unsigned int threads = bench.Options().threads;
+    const double pairs = static_cast<double>(probes.size()) * static_cast<double>(num_users);
+    ThresholdSweep sweep;
+    bench.Run(prefix + ThreadsSuffix(threads), pairs, pairs * VEC_LENGTH * sizeof(feature_t), [&] {
+        sweep.Clear();
+        sweep.Accumulate(probes, probe_labels, gallery, gallery_labels, threads);
+    });
+
+    const struct
+    {
+        const char* name;
+        ThresholdsConfidenceEnum level;
+    } levels[] = {{"low", ThresholdsConfidenceEnum::ThresholdsConfidenceLevel_Low},
+                  {"medium", ThresholdsConfidenceEnum::ThresholdsConfidenceLevel_Medium},
+                  {"high", ThresholdsConfidenceEnum::ThresholdsConfidenceLevel_High}};
+    for (const auto& level : levels)
+    {
+        const OperatingPoint point = sweep.At(level.level);
+        printf("%-48s %-6s far %.3g frr %.3g (%llu genuine, %llu impostor pairs)\n", prefix.c_str(), level.name, point.Far(),
+               point.Frr(), static_cast<unsigned long long>(point.genuine), static_cast<unsigned long long>(point.impostor));
+    }
+}
+
+/* Kernels equivalence */
+
+// frozen copy of Matcher::GetMsb() and of the Matcher::MatchTwoVectors() loop and grade as they were before the
+// kernels, the reference of the kernels. the int32 sums are only defined for in-range vectors of up to 512 features.
+static short BaselineGetMsb(const uint32_t ux)
+{
+    uint32_t x = ux;
+    uint32_t shift = 0;
+    uint32_t msb = 0;
+
+    msb = (x > 0xFFFF) << 4;
+    x >>= msb;
+    shift = (x > 0xFF) << 3;
+    x >>= shift;
+    msb |= shift;
+    shift = (x > 0xF) << 2;
+    x >>= shift;
+    msb |= shift;
+    shift = (x > 0x3) << 1;
+    x >>= shift;
+    msb |= shift;
+    msb |= (x >> 1);
+
+    msb = (ux == 0) ? 0 : (msb + 1);
+
+    return static_cast<short>(msb);
+}
+
+static void BaselineNccSums(const feature_t* T1, const feature_t* T2, const uint32_t nfeatures, int32_t& corr, uint32_t& norm1,
+                            uint32_t& norm2)
+{
+    corr = 0;
+    norm1 = 0;
+    norm2 = 0;
+
+    for (uint32_t i = 0; i < nfeatures; ++i)
+    {
+        int32_t t1 = static_cast<int32_t>(T1[i]);
+        int32_t t2 = static_cast<int32_t>(T2[i]);
+
+        corr += t1 * t2;
+        norm1 += t1 * t1;
+        norm2 += t2 * t2;
+    }
+}
+
+static match_calc_t BaselineMatchTwoVectors(const feature_t* T1, const feature_t* T2, const uint32_t vec_length)
+{
+    int32_t corr = 0;
+    int32_t min_corr = 0;
+    uint32_t ucorr = 0;
+    uint32_t norm1 = 0;
+    uint32_t norm2 = 0;
+    BaselineNccSums(T1, T2, vec_length, corr, norm1, norm2);
+
+    norm1 = (norm1 == 0) ? 1 : norm1;
+    norm2 = (norm2 == 0) ? 1 : norm2;
+
+    ucorr = static_cast<uint32_t>(std::max(corr, min_corr));
+
+    short norm1_msb = BaselineGetMsb(norm1);
+    short norm2_msb = BaselineGetMsb(norm2);
+    short corr_msb = BaselineGetMsb(ucorr);
+    int32_t min_shift = 0;
+
+    short max_corr_shift = static_cast<short>(32 - corr_msb);
+    short max_shift1 = static_cast<short>(16 - static_cast<short>(std::max(static_cast<int32_t>(corr_msb - norm1_msb), min_shift)));
+    short max_shift2 = static_cast<short>(16 - static_cast<short>(std::max(static_cast<int32_t>(corr_msb - norm2_msb), min_shift)));
+
+    short shift1 = static_cast<short>(std::min(static_cast<int32_t>(max_shift1), static_cast<int32_t>(max_corr_shift)));
+    short shift2 = static_cast<short>(std::min(static_cast<int32_t>(max_shift2), static_cast<int32_t>(max_corr_shift)));
+    short total_shift = static_cast<short>(shift1 + shift2);
+    short shift_back = static_cast<short>(total_shift - 12);
+
+    uint32_t norm_corr1 = (ucorr << shift1) / norm1;
+    uint32_t norm_corr2 = (ucorr << shift2) / norm2;
+    uint32_t similarity = norm_corr1 * norm_corr2;
+
+    uint32_t grade = 0;
+
+    if (shift_back >= 0)
+    {
+        grade = (similarity >> shift_back);
+    }
+    else
+    {
+        grade = (similarity << (-shift_back));
+    }
+
+    return static_cast<match_calc_t>(grade);
+}
+
+// frozen copy of Matcher::BlendAverageVector() and Matcher::LimitAdaptiveVector() as they were before the kernels (the
+// limit loop takes the active identical threshold and iterations limit of the thresholds configuration).
+static void BaselineBlendAverageVector(feature_t* user_adaptive_faceprints, const feature_t* user_probe_faceprints,
+                                       const uint32_t vec_length)
+{
+    int history_weight = RSID_UPDATE_GALLERY_HISTORY_WEIGHT;
+    int round_value = (history_weight + 1);
+    for (uint32_t i = 0; i < vec_length; ++i)
+    {
+        int32_t v = static_cast<int32_t>(user_adaptive_faceprints[i]);
+        v *= 2 * history_weight;
+        v += 2 * (int)(user_probe_faceprints[i]);
+        v = (v >= 0) ? (v + round_value) : (v - round_value);
+        v /= (2 * round_value);
+
+        user_adaptive_faceprints[i] = static_cast<short>(v);
+    }
+}
+
+static bool BaselineLimitAdaptiveVector(feature_t* adaptive_faceprints_vec, const feature_t* anchor_faceprints_vec,
+                                        const short active_identical_threshold, const uint32_t limit_num_iters, const uint32_t vec_length)
+{
+    bool success = true;
+
+    match_calc_t match_score = BaselineMatchTwoVectors(adaptive_faceprints_vec, anchor_faceprints_vec, vec_length);
+
+    uint32_t cnt_iter = 0;
+    while ((match_score < active_identical_threshold))
+    {
+        BaselineBlendAverageVector(adaptive_faceprints_vec, anchor_faceprints_vec, vec_length);
+
+        match_score = BaselineMatchTwoVectors(adaptive_faceprints_vec, anchor_faceprints_vec, vec_length);
+
+        cnt_iter++;
+        if (cnt_iter > limit_num_iters)
+        {
+            success = false;
+            break;
+        }
+    }
+
+    return success;
+}
+
+// every kernel table's ncc_sums and blends, and Matcher::MatchTwoVectors() against the baseline, on in-range vectors
+// (and the range extremes) of up to 512 features. then the whole adaptive update (blend and limit loop) of a match.
+static bool VerifyBaseline()
+{
+    std::mt19937 rng(BENCH_SEED);
+    std::uniform_int_distribution<int> in_range(RSID_MIN_FEATURE_VALUE, RSID_MAX_FEATURE_VALUE);
+    const int num_cases = 20000;
+    bool all_ok = true;
+
+    for (int table = 0; table < 2 * static_cast<int>(MatcherKernels::Isa::NumIsas); ++table)
+    {
+        const uint32_t fixed_length = (table % 2 == 0) ? 0 : VEC_LENGTH;
+        const MatcherKernels::KernelTable* kernels = MatcherKernels::ForIsa(static_cast<MatcherKernels::Isa>(table / 2), fixed_length);
+        if (kernels == nullptr)
+        {
+            continue;
+        }
+
+        int ncc_errors = 0, blend_errors = 0;
+        for (int c = 0; c < num_cases; ++c)
+        {
+            const bool any_length = (c % 4 == 0) && (kernels->fixed_length == 0);
+            const uint32_t length = any_length ? static_cast<uint32_t>(rng() % (VEC_LENGTH + 1)) : VEC_LENGTH;
+            std::vector<feature_t> t1(length), t2(length);
+            for (uint32_t i = 0; i < length; ++i)
+            {
+                t1[i] = static_cast<feature_t>(in_range(rng));
+                t2[i] = static_cast<feature_t>(in_range(rng));
+            }
+            if (c < 4)
+            {
+                std::fill(t1.begin(), t1.end(), static_cast<feature_t>((c & 1) ? RSID_MAX_FEATURE_VALUE : RSID_MIN_FEATURE_VALUE));
+                std::fill(t2.begin(), t2.end(), static_cast<feature_t>((c & 2) ? RSID_MAX_FEATURE_VALUE : RSID_MIN_FEATURE_VALUE));
+            }
+
+            int32_t corr = 0;
+            uint32_t norm1 = 0, norm2 = 0;
+            BaselineNccSums(t1.data(), t2.data(), length, corr, norm1, norm2);
+            MatcherKernels::NccSums actual;
+            kernels->ncc_sums(t1.data(), t2.data(), length, actual);
+            ncc_errors += (corr != actual.corr || norm1 != actual.norm1 || norm2 != actual.norm2) ? 1 : 0;
+
+            std::vector<feature_t> expected_blend(t1), blend(t1), blend_ncc(t1);
+            BaselineBlendAverageVector(expected_blend.data(), t2.data(), length);
+            kernels->blend(blend.data(), t2.data(), length);
+            kernels->blend_ncc_sums(blend_ncc.data(), t2.data(), length, actual);
+            blend_errors += (blend != expected_blend || blend_ncc != expected_blend) ? 1 : 0;
+        }
+
+        const struct
+        {
+            const char* kernel;
+            int errors;
+        } results[] = {{"ncc_sums", ncc_errors}, {"blend", blend_errors}};
+        for (const auto& result : results)
+        {
+            printf("verify %-16s %-12s %-6s %s (%d/%d mismatches against the baseline)\n", result.kernel, kernels->name,
+                   kernels->fixed_length != 0 ? "fixed" : "any", result.errors == 0 ? "ok" : "FAILED", result.errors, num_cases);
+            all_ok &= (result.errors == 0);
+        }
+    }
+
+    // related vectors too, so the grades cover the whole [0, 4096] range and not only the ~0 of random pairs.
+    int score_errors = 0;
+    for (int c = 0; c < num_cases; ++c)
+    {
+        const uint32_t length = (c % 4 == 0) ? static_cast<uint32_t>(rng() % (VEC_LENGTH + 1)) : VEC_LENGTH;
+        std::vector<feature_t> t1(VEC_LENGTH), t2(VEC_LENGTH);
+        RandomVector(rng, t1.data());
+        NoisyVector(rng, t1.data(), t2.data(), (c % 2 == 0) ? 100.0 : 1000.0);
+
+        match_calc_t actual = 0;
+        Matcher::MatchTwoVectors(t1.data(), t2.data(), &actual, length);
+        score_errors += (actual != BaselineMatchTwoVectors(t1.data(), t2.data(), length)) ? 1 : 0;
+    }
+    printf("verify %-16s %-12s %-6s %s (%d/%d mismatches against the baseline)\n", "MatchTwoVectors", MatcherKernels::Active().name,
+           "any", score_errors == 0 ? "ok" : "FAILED", score_errors, num_cases);
+    all_ok &= (score_errors == 0);
+
+    // a single user match that always updates (strong and update thresholds below any score), with a random identical
+    // threshold, so the limit loop converges, reaches its iterations limit or a fixed point. each configuration
+    // picks the adaptive and anchor vectors like Matcher::ApplyMatchDecision().
+    const int num_updates = 3000;
+    Thresholds thresholds = HighConfidenceThresholds();
+    thresholds.strongThreshold_pNMgNM = thresholds.strongThreshold_pMgM = thresholds.strongThreshold_pMgNM = -1;
+    thresholds.strongThreshold_pNMgNM_rgbImgEnroll = -1;
+    thresholds.updateThreshold_pNMgNM = thresholds.updateThreshold_pMgM = thresholds.updateThreshold_pMgNM_First = 0;
+    std::uniform_int_distribution<int> identical_threshold(3000, RSID_MAX_POSSIBLE_SCORE + 1);
+    int update_errors = 0;
+    for (int c = 0; c < num_updates; ++c)
+    {
+        const ThresholdsConfigEnum config = static_cast<ThresholdsConfigEnum>(c % 3);
+        const bool with_mask = (config != ThresholdsConfigEnum::ThresholdConfig_pNM_gNM);
+        // MakeUser() gives every 4th user an adaptive with-mask vector.
+        const size_t user_index = static_cast<size_t>(c) * 4 + (config == ThresholdsConfigEnum::ThresholdConfig_pM_gM ? 0 : 1);
+        std::vector<UserFaceprints_t> users(1, MakeUser(user_index));
+        Faceprints& existing = users[0].faceprints;
+        const MatchElement probe = MakeProbe(rng, existing.data.adaptiveDescriptorWithoutMask, 50.0 + (c % 7) * 50.0, with_mask);
+        const short identical = static_cast<short>(identical_threshold(rng));
+        thresholds.identicalThreshold_gNMgNM = thresholds.identicalThreshold_gMgNM = identical;
+
+        Faceprints expected = existing;
+        feature_t* adaptive = expected.data.adaptiveDescriptorWithoutMask;
+        const feature_t* anchor = expected.data.enrollmentDescriptor;
+        if (with_mask)
+        {
+            adaptive = expected.data.adaptiveDescriptorWithMask;
+            anchor = expected.data.adaptiveDescriptorWithoutMask;
+        }
+        if (config == ThresholdsConfigEnum::ThresholdConfig_pM_gNM)
+        {
+            ::memcpy(adaptive, probe.data.featuresVector, sizeof(probe.data.featuresVector));
+            adaptive[RSID_INDEX_IN_FEATURES_VECTOR_TO_FLAGS] = FaVectorFlagsEnum::VecFlagValidWithMask;
+        }
+        BaselineBlendAverageVector(adaptive, probe.data.featuresVector, VEC_LENGTH);
+        const uint32_t limit_num_iters = with_mask ? RSID_LIMIT_NUM_ITERS_M : RSID_LIMIT_NUM_ITERS_NM;
+        const bool expected_update = BaselineLimitAdaptiveVector(adaptive, anchor, identical, limit_num_iters, VEC_LENGTH);
+
+        Faceprints updated;
+        const ExtendedMatchResult result = Matcher::MatchFaceprintsToArray(probe, users, updated, thresholds);
+        update_errors += (!result.isSame || result.should_update != expected_update ||
+                          ::memcmp(&updated.data, &expected.data, sizeof(expected.data)) != 0)
+                             ? 1
+                             : 0;
+    }
+    printf("verify %-16s %-12s %-6s %s (%d/%d mismatches against the baseline)\n", "adaptive update", MatcherKernels::Active().name,
+           "fixed", update_errors == 0 ? "ok" : "FAILED", update_errors, num_updates);
+    all_ok &= (update_errors == 0);
+
+    return all_ok;
+}
+
+// random vectors over the whole int16 range (the kernels must match the scalar wrap-around arithmetic for any input),
+// in-range vectors, the int16 extremes, and lengths that are not a multiple of any simd width.
+static bool VerifyKernels()
+{
+    std::mt19937 rng(BENCH_SEED);
+    std::uniform_int_distribution<int> any_value(-32768, 32767);
+    std::uniform_int_distribution<int> in_range(RSID_MIN_FEATURE_VALUE, RSID_MAX_FEATURE_VALUE);
+    const MatcherKernels::KernelTable& scalar = *MatcherKernels::ForIsa(MatcherKernels::Isa::Scalar);
+    const int num_cases = 20000;
+    bool all_ok = true;
+
+    // every table against the generic scalar one (table 0), the specialized tables only on their fixed length.
+    for (int table = 1; table < 2 * static_cast<int>(MatcherKernels::Isa::NumIsas); ++table)
+    {
+        const uint32_t fixed_length = (table % 2 == 0) ? 0 : VEC_LENGTH;
+        const MatcherKernels::KernelTable* kernels = MatcherKernels::ForIsa(static_cast<MatcherKernels::Isa>(table / 2), fixed_length);
+        if (kernels == nullptr)
+        {
+            continue;
+        }
+
+        int ncc_errors = 0, dot_errors = 0, dot_i8_errors = 0, blend_errors = 0, blend_ncc_errors = 0;
+        for (int c = 0; c < num_cases; ++c)
+        {
+            const bool any_length = (c % 4 == 0) && (kernels->fixed_length == 0);
+            const uint32_t length = any_length ? static_cast<uint32_t>(rng() % 600) : VEC_LENGTH;
+            std::vector<feature_t> t1(length), t2(length);
+            for (uint32_t i = 0; i < length; ++i)
+            {
+                t1[i] = static_cast<feature_t>((c % 2 == 0) ? any_value(rng) : in_range(rng));
+                t2[i] = static_cast<feature_t>((c % 2 == 0) ? any_value(rng) : in_range(rng));
+            }
+            if (c < 4)
+            {
+                std::fill(t1.begin(), t1.end(), static_cast<feature_t>((c & 1) ? 32767 : -32768));
+                std::fill(t2.begin(), t2.end(), static_cast<feature_t>((c & 2) ? 32767 : -32768));
+            }
+
+            MatcherKernels::NccSums expected, actual;
+            scalar.ncc_sums(t1.data(), t2.data(), length, expected);
+            kernels->ncc_sums(t1.data(), t2.data(), length, actual);
+            ncc_errors += (expected.corr != actual.corr || expected.norm1 != actual.norm1 || expected.norm2 != actual.norm2) ? 1 : 0;
+            dot_errors += (scalar.dot(t1.data(), t2.data(), length) != kernels->dot(t1.data(), t2.data(), length)) ? 1 : 0;
+
+            std::vector<int8_t> q1(length), q2(length);
+            for (uint32_t i = 0; i < length; ++i)
+            {
+                q1[i] = static_cast<int8_t>(t1[i]);
+                q2[i] = static_cast<int8_t>(t2[i]);
+            }
+            dot_i8_errors += (scalar.dot_i8(q1.data(), q2.data(), length) != kernels->dot_i8(q1.data(), q2.data(), length)) ? 1 : 0;
+
+            std::vector<feature_t> expected_blend(t1), actual_blend(t1);
+            bool expected_changed = scalar.blend(expected_blend.data(), t2.data(), length);
+            bool actual_changed = kernels->blend(actual_blend.data(), t2.data(), length);
+            blend_errors += (expected_blend != actual_blend || expected_changed != actual_changed) ? 1 : 0;
+
+            expected_blend = actual_blend = t1;
+            expected_changed = scalar.blend_ncc_sums(expected_blend.data(), t2.data(), length, expected);
+            actual_changed = kernels->blend_ncc_sums(actual_blend.data(), t2.data(), length, actual);
+            blend_ncc_errors += (expected_blend != actual_blend || expected_changed != actual_changed || expected.corr != actual.corr ||
+                             expected.norm1 != actual.norm1 || expected.norm2 != actual.norm2)
+                                ? 1
+                                : 0;
+        }
+
+        const struct
+        {
+            const char* kernel;
+            int errors;
+        } results[] = {{"ncc_sums", ncc_errors}, {"dot", dot_errors}, {"dot_i8", dot_i8_errors}, {"blend", blend_errors},
+                       {"blend_ncc_sums", blend_ncc_errors}};
+        for (const auto& result : results)
+        {
+            printf("verify %-16s %-12s %-6s %s (%d/%d mismatches)\n", result.kernel, kernels->name,
+                   kernels->fixed_length != 0 ? "fixed" : "any", result.errors == 0 ? "ok" : "FAILED", result.errors, num_cases);
+            all_ok &= (result.errors == 0);
+        }
+    }
+
+    return all_ok;
+}
+
+// NccNorm::Divide() against n / norm: every divisor up to 2^20 and random 32 bit ones, with edge and random
+// dividends, then whole grades against the division based grade on random vectors.
+static uint32_t ReferenceNccGrade(int32_t corr, uint32_t norm1, uint32_t norm2)
+{
+    // Matcher::GetMsb() (through MakeNccNorm(), as it's private), 0 for 0.
+    const auto msb = [](uint32_t x) { return static_cast<int32_t>(x == 0 ? 0 : Matcher::MakeNccNorm(x).msb); };
+    norm1 = (norm1 == 0) ? 1 : norm1;
+    norm2 = (norm2 == 0) ? 1 : norm2;
+    const uint32_t ucorr = static_cast<uint32_t>(std::max(corr, 0));
+    const int32_t corr_msb = msb(ucorr);
+    const int32_t shift1 = std::min(16 - std::max(corr_msb - msb(norm1), 0), 32 - corr_msb);
+    const int32_t shift2 = std::min(16 - std::max(corr_msb - msb(norm2), 0), 32 - corr_msb);
+    const int32_t shift_back = shift1 + shift2 - 12;
+    const uint32_t similarity = ((ucorr << shift1) / norm1) * ((ucorr << shift2) / norm2);
+    return (shift_back >= 0) ? (similarity >> shift_back) : (similarity << -shift_back);
+}
+
+static bool VerifyNccGrade()
+{
+    std::mt19937 rng(BENCH_SEED);
+    bool all_ok = true;
+
+    size_t division_cases = 0, division_errors = 0;
+    const auto check_divisor = [&](uint32_t d) {
+        const NccNorm ncc_norm = Matcher::MakeNccNorm(d);
+        const uint32_t dividends[] = {0, 1, d - 1, d, d + 1, 2 * d - 1, 2 * d, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFE, 0xFFFFFFFF,
+                                      static_cast<uint32_t>(rng()), static_cast<uint32_t>(rng()) >> (rng() % 32)};
+        for (uint32_t n : dividends)
+        {
+            division_errors += (ncc_norm.Divide(n) != n / d) ? 1 : 0;
+            division_cases++;
+        }
+    };
+    for (uint32_t d = 1; d <= (1u << 20); ++d)
+    {
+        check_divisor(d);
+    }
+    for (uint32_t bit = 0; bit < 32; ++bit)
+    {
+        check_divisor(1u << bit);
+        check_divisor((1u << bit) + 1);
+        check_divisor(std::max(1u, (1u << bit) - 1));
+    }
+    check_divisor(0xFFFFFFFF);
+    for (int c = 0; c < 1000000; ++c)
+    {
+        const uint32_t d = static_cast<uint32_t>(rng()) >> (rng() % 32);
+        check_divisor(d == 0 ? 1 : d);
+    }
+    printf("verify %-16s %s (%zu/%zu mismatches)\n", "ncc_norm_divide", division_errors == 0 ? "ok" : "FAILED", division_errors,
+           division_cases);
+    all_ok &= (division_errors == 0);
+
+    const int num_cases = 200000;
+    int grade_errors = 0;
+    std::vector<feature_t> t1(VEC_LENGTH), t2(VEC_LENGTH);
+    for (int c = 0; c < num_cases; ++c)
+    {
+        RandomVector(rng, t1.data(), (c % 2 == 0) ? 300.0 : 20.0);
+        if (c % 3 == 0)
+        {
+            NoisyVector(rng, t1.data(), t2.data(), 50.0);
+        }
+        else
+        {
+            RandomVector(rng, t2.data());
+        }
+
+        MatcherKernels::NccSums sums;
+        MatcherKernels::Active(VEC_LENGTH).ncc_sums(t1.data(), t2.data(), VEC_LENGTH, sums);
+        const match_calc_t grade = Matcher::ComputeNccGrade(sums.corr, Matcher::MakeNccNorm(sums.norm1), Matcher::MakeNccNorm(sums.norm2));
+        grade_errors += (static_cast<uint32_t>(grade) != ReferenceNccGrade(sums.corr, sums.norm1, sums.norm2)) ? 1 : 0;
+    }
+    printf("verify %-16s %s (%d/%d mismatches)\n", "ncc_grade", grade_errors == 0 ? "ok" : "FAILED", grade_errors, num_cases);
+    all_ok &= (grade_errors == 0);
+
+    return all_ok;
+}
+
+/* Threshold sweep decisions */
+
+// the sweep's false accepts / rejects of a thresholds set against the matcher decision of every pair (a one user
+// gallery match per pair), on a labelled synthetic set with rgb enrolled users and probes with mask. besides the
+// default thresholds sets, the strong thresholds are set to scores of genuine and impostor pairs, so some pairs score
+// exactly the threshold.
+static bool VerifySweep()
+{
+    const size_t num_users = 64;
+    std::mt19937 rng(BENCH_SEED);
+    FaceprintsGallery gallery;
+    std::vector<FaceprintsGallery> user_galleries(num_users);
+    std::vector<int> gallery_labels(num_users);
+    std::vector<MatchElement> probes;
+    std::vector<int> probe_labels;
+    for (size_t i = 0; i < num_users; ++i)
+    {
+        UserFaceprints_t user = MakeUser(i);
+        user.faceprints.data.featuresType = static_cast<int>((i % 3 == 0) ? FaceprintsTypeEnum::RGB : FaceprintsTypeEnum::W10);
+        gallery.Add(user);
+        user_galleries[i].Add(user);
+        gallery_labels[i] = static_cast<int>(i);
+        for (int p = 0; p < 4; ++p)
+        {
+            probes.push_back(MakeProbe(rng, user.faceprints.data.adaptiveDescriptorWithoutMask, 120.0 + 60.0 * p, p % 2 == 1));
+            probe_labels.push_back(static_cast<int>(i));
+        }
+    }
+
+    ThresholdSweep sweep;
+    bool all_ok = sweep.Accumulate(probes, probe_labels, gallery, gallery_labels, 2);
+
+    std::vector<Thresholds> thresholds_sets(3);
+    Matcher::SetToDefaultThresholds(thresholds_sets[0], ThresholdsConfidenceEnum::ThresholdsConfidenceLevel_Low);
+    Matcher::SetToDefaultThresholds(thresholds_sets[1], ThresholdsConfidenceEnum::ThresholdsConfidenceLevel_Medium);
+    Matcher::SetToDefaultThresholds(thresholds_sets[2], ThresholdsConfidenceEnum::ThresholdsConfidenceLevel_High);
+    for (size_t p = 0; p < probes.size(); p += probes.size() / 8)
+    {
+        // alternately a genuine and an impostor (the next user) pair.
+        const size_t user = (static_cast<size_t>(probe_labels[p]) + (thresholds_sets.size() % 2)) % num_users;
+        Faceprints updated;
+        ExtendedMatchResult result = Matcher::MatchFaceprintsToGallery(probes[p], user_galleries[user], updated, thresholds_sets[2]);
+        Thresholds thresholds = thresholds_sets[2];
+        thresholds.strongThreshold_pNMgNM = result.maxScore;
+        thresholds.strongThreshold_pMgM = result.maxScore;
+        thresholds.strongThreshold_pMgNM = result.maxScore;
+        thresholds.strongThreshold_pNMgNM_rgbImgEnroll = result.maxScore;
+        thresholds_sets.push_back(thresholds);
+    }
+
+    for (const Thresholds& thresholds : thresholds_sets)
+    {
+        OperatingPoint expected;
+        for (size_t p = 0; p < probes.size(); ++p)
+        {
+            for (size_t j = 0; j < num_users; ++j)
+            {
+                Faceprints updated;
+                const bool accepted = Matcher::MatchFaceprintsToGallery(probes[p], user_galleries[j], updated, thresholds).isSame;
+                if (probe_labels[p] == gallery_labels[j])
+                {
+                    expected.genuine++;
+                    expected.falseRejects += accepted ? 0 : 1;
+                }
+                else
+                {
+                    expected.impostor++;
+                    expected.falseAccepts += accepted ? 1 : 0;
+                }
+            }
+        }
+
+        const OperatingPoint actual = sweep.At(thresholds);
+        const bool ok = actual.genuine == expected.genuine && actual.impostor == expected.impostor &&
+                        actual.falseRejects == expected.falseRejects && actual.falseAccepts == expected.falseAccepts;
+        printf("verify %-16s strong %4d %s (frr %llu/%llu, far %llu/%llu, matcher frr %llu, far %llu)\n", "sweep_decision",
+               thresholds.strongThreshold_pNMgNM, ok ? "ok" : "FAILED", static_cast<unsigned long long>(actual.falseRejects),
+               static_cast<unsigned long long>(actual.genuine), static_cast<unsigned long long>(actual.falseAccepts),
+               static_cast<unsigned long long>(actual.impostor), static_cast<unsigned long long>(expected.falseRejects),
+               static_cast<unsigned long long>(expected.falseAccepts));
+        all_ok &= ok;
+    }
+
+    // the curve points are the single threshold points.
+    int curve_errors = 0;
+    for (int config = 0; config < NumThresholdConfigs; ++config)
+    {
+        const std::vector<OperatingPoint> curve = sweep.Curve(static_cast<ThresholdsConfigEnum>(config));
+        for (size_t threshold = 0; threshold < curve.size(); ++threshold)
+        {
+            const OperatingPoint point = sweep.At(static_cast<ThresholdsConfigEnum>(config), static_cast<match_calc_t>(threshold));
+            const bool same = curve[threshold].falseRejects == point.falseRejects && curve[threshold].falseAccepts == point.falseAccepts;
+            curve_errors += same ? 0 : 1;
+        }
+    }
+    printf("verify %-16s %s (%d mismatches)\n", "sweep_curve", curve_errors == 0 ? "ok" : "FAILED", curve_errors);
+    all_ok &= (curve_errors == 0);
+
+    return all_ok;
+}
+
+/* Crc equivalence */
+
+// the packets crc16 (PacketManager::Crc16()) is used by the gallery wal records, and the firmware crc32 kernels
+// (FwUpdateCommon::Crc32Update()) share its table driven design, so their checks live here too.
+
+// byte-wise table loops, as the crcs were computed before the slicing and hardware kernels. the tables are built bit by
+// bit from the polynoms, so they don't share the kernels' tables.
+static uint32_t ReferenceCrc32(uint32_t crc, const unsigned char* bytes, size_t n_words)
+{
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> lut(256);
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t crc_bits = i;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                crc_bits = (crc_bits >> 1) ^ ((crc_bits & 1) ? 0xedb88320u : 0u);
+            }
+            lut[i] = crc_bits;
+        }
+        return lut;
+    }();
+
+    // each word from its least significant byte: the bytes order of a little endian word.
+    for (size_t i = 0; i < n_words; ++i)
+    {
+        uint32_t value;
+        ::memcpy(&value, bytes + i * sizeof(value), sizeof(value));
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            crc = table[(crc ^ (value >> shift)) & 0xff] ^ (crc >> 8);
+        }
+    }
+    return crc;
+}
+
+static uint16_t ReferenceCrc16(uint16_t initial_crc, const unsigned char* bytes, size_t n_bytes)
+{
+    static const std::vector<uint16_t> table = [] {
+        std::vector<uint16_t> lut(256);
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t crc_bits = i << 8;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                crc_bits = ((crc_bits << 1) ^ ((crc_bits & 0x8000) ? 0x1021u : 0u)) & 0xffff;
+            }
+            lut[i] = static_cast<uint16_t>(crc_bits);
+        }
+        return lut;
+    }();
+
+    unsigned int crc = initial_crc;
+    for (size_t i = 0; i < n_bytes; ++i)
+    {
+        crc = (table[((crc >> 8) ^ bytes[i]) & 0xff] ^ (crc << 8)) & 0xffff;
+    }
+    return static_cast<uint16_t>(crc);
+}
+
+// the slicing by 8 crc32 kernel and the one selected for the running cpu (pclmulqdq on x86), and the crc16, against
+// the byte-wise loops: random lengths (below and above the kernels' block sizes), buffer offsets and initial values.
+static bool VerifyCrc()
+{
+    std::mt19937 rng(BENCH_SEED);
+    const size_t max_bytes = 16384;
+    const int num_cases = 20000;
+    std::vector<unsigned char> buffer(max_bytes + 16);
+    for (auto& byte : buffer)
+    {
+        byte = static_cast<unsigned char>(rng());
+    }
+
+    const char* active_name = nullptr;
+    const FwUpdateCommon::Crc32UpdateFn active = FwUpdateCommon::ActiveCrc32Update(&active_name);
+    const struct
+    {
+        const char* name;
+        FwUpdateCommon::Crc32UpdateFn update;
+    } crc32_kernels[] = {{"slicing-by-8", FwUpdateCommon::Crc32UpdateSlicing8}, {active_name, active}};
+
+    bool all_ok = true;
+    for (const auto& kernel : crc32_kernels)
+    {
+        int errors = 0;
+        for (int c = 0; c < num_cases; ++c)
+        {
+            const size_t n_bytes = (c % 2 == 0) ? rng() % 256 : rng() % max_bytes;
+            const size_t offset = rng() % 16;
+            const uint32_t crc = (c < 2) ? (c == 0 ? 0u : ~0u) : static_cast<uint32_t>(rng());
+            const size_t n_words = n_bytes / sizeof(uint32_t);
+            errors += (kernel.update(crc, &buffer[offset], n_words) != ReferenceCrc32(crc, &buffer[offset], n_words)) ? 1 : 0;
+        }
+        printf("verify %-16s %-12s %s (%d/%d mismatches against the byte-wise loop)\n", "crc32", kernel.name,
+               errors == 0 ? "ok" : "FAILED", errors, num_cases);
+        all_ok &= (errors == 0);
+    }
+
+    int crc16_errors = 0;
+    for (int c = 0; c < num_cases; ++c)
+    {
+        const size_t n_bytes = (c % 2 == 0) ? rng() % 64 : rng() % max_bytes;
+        const size_t offset = rng() % 16;
+        const uint16_t crc = static_cast<uint16_t>(rng());
+        const char* bytes = reinterpret_cast<const char*>(&buffer[offset]);
+        crc16_errors += (PacketManager::Crc16(crc, bytes, n_bytes) != ReferenceCrc16(crc, &buffer[offset], n_bytes)) ? 1 : 0;
+    }
+    printf("verify %-16s %-12s %s (%d/%d mismatches against the byte-wise loop)\n", "crc16", "slicing-by-8",
+           crc16_errors == 0 ? "ok" : "FAILED", crc16_errors, num_cases);
+    all_ok &= (crc16_errors == 0);
+
+    return all_ok;
+}
+
+/* Command line */
+
+static void PrintUsage(const char* exe)
+{
+    printf("usage: %s [options]\n"
+           "  --verify            check simd kernels are bit-identical to the scalar ones (and the ncc grade), and exit\n"
+           "  --filter <text>     run only the benchmarks whose name contains text\n"
+           "  --max-users <n>     largest gallery size (of 1, 1000, 100000, 1000000) to benchmark. default 1000000\n"
+           "                      (a 1M users gallery needs about 5GB of memory)\n"
+           "  --threads <n>       threads of the multi-threaded scans, 0 for all hardware threads. default 0\n"
+           "  --min-time <sec>    minimal measuring time of each benchmark. default 0.5\n",
+           exe);
+}
+
+static bool ParseArgs(int argc, char* argv[], BenchOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool has_value = (i + 1 < argc);
+        if (arg == "--verify")
+        {
+            options.verify = true;
+        }
+        else if (arg == "--filter" && has_value)
+        {
+            options.filter = argv[++i];
+        }
+        else if (arg == "--max-users" && has_value)
+        {
+            options.max_users = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--threads" && has_value)
+        {
+            options.threads = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--min-time" && has_value)
+        {
+            options.min_time = std::strtod(argv[++i], nullptr);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    if (!ParseArgs(argc, argv, options))
+    {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (options.threads == 0)
+    {
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    printf("matcher kernels: %s, threads: %u\n", MatcherKernels::Active().name, options.threads);
+
+    if (options.verify)
+    {
+        const bool baseline_ok = VerifyBaseline();
+        const bool kernels_ok = VerifyKernels();
+        const bool grade_ok = VerifyNccGrade();
+        const bool sweep_ok = VerifySweep();
+        const bool crc_ok = VerifyCrc();
+        return (baseline_ok && kernels_ok && grade_ok && sweep_ok && crc_ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    Bench bench(options);
+    BenchKernels(bench);
+    BenchValidation(bench);
+    BenchUpdate(bench);
+
+    for (size_t num_users : {size_t(1), size_t(1000), size_t(100000), size_t(1000000)})
+    {
+        if (num_users > options.max_users)
+        {
+            break;
+        }
+        BenchArray(bench, num_users);
+        BenchGallery(bench, num_users);
+        BenchMaintenance(bench, num_users);
+    }
+
+    for (size_t num_users : {size_t(1000), size_t(10000)})
+    {
+        if (num_users <= options.max_users)
+        {
+            BenchDuplicates(bench, num_users);
+        }
+    }
+
+    if (options.max_users >= 1000)
+    {
+        BenchSweep(bench, 1000);
+    }
+
+    return EXIT_SUCCESS;
+}